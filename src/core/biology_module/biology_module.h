@@ -16,6 +16,7 @@
 #define CORE_BIOLOGY_MODULE_BIOLOGY_MODULE_H_
 
 #include "core/event/event.h"
+#include "core/memory/memory_manager.h"
 #include "core/sim_object/sim_object.h"
 #include "core/util/type.h"
 
@@ -56,6 +57,8 @@ struct BaseBiologyModule {
 
   virtual ~BaseBiologyModule() {}
 
+  BDM_MEMORY_MANAGER_OPERATORS
+
   /// Create a new instance of this object using the default constructor.
   virtual BaseBiologyModule* GetInstance(const Event& event,
                                          BaseBiologyModule* other,
@@ -69,6 +72,13 @@ struct BaseBiologyModule {
 
   virtual void Run(SimObject* so) = 0;
 
+  /// Executes the given visitor for all data members. Biology modules with
+  /// additional state override it and call the version of their base class.
+  /// \see `SoVisitor`, `Checkpoint`
+  virtual void ForEachDataMember(SoVisitor* visitor) const {
+    BDM_SIM_OBJECT_FOREACHDM_BODY(copy_mask_, remove_mask_)
+  }
+
   /// Function returns whether the biology module should be copied for the
   /// given event.
   bool Copy(EventId event) const { return (event & copy_mask_) != 0; }
@@ -60,6 +60,11 @@ struct GrowDivide : public BaseBiologyModule {
     BaseBiologyModule::EventHandler(event, other1, other2);
   }
 
+  void ForEachDataMember(SoVisitor* visitor) const override {
+    BDM_SIM_OBJECT_FOREACHDM_BODY(threshold_, growth_rate_)
+    BaseBiologyModule::ForEachDataMember(visitor);
+  }
+
   void Run(SimObject* so) override {
     if (Cell* cell = dynamic_cast<Cell*>(so)) {
       if (cell->GetDiameter() <= threshold_) {
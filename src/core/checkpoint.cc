@@ -0,0 +1,691 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/checkpoint.h"
+
+#include <fcntl.h>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include "core/biology_module/grow_divide.h"
+#include "core/diffusion_grid.h"
+#include "core/resource_manager.h"
+#include "core/sim_object/cell.h"
+#include "core/simulation.h"
+#include "core/util/log.h"
+#include "core/util/thread_info.h"
+
+namespace bdm {
+
+namespace {
+
+/// "BDMCKPT" followed by a zero byte
+constexpr uint64_t kMagic = 0x0054504b434d4442;
+constexpr uint64_t kVersion = 1;
+
+/// Fixed size part at the beginning of the file. It is followed by the
+/// names of the simulation object and biology module types, one
+/// `BlockHeader` for each block and one `GridHeader` for each diffusion grid.
+struct FileHeader {
+  uint64_t magic_ = kMagic;
+  uint64_t version_ = kVersion;
+  uint64_t completed_simulation_steps_ = 0;
+  /// `SoUidGenerator::GetLastId()` at the time of writing
+  uint64_t last_uid_ = 0;
+  uint64_t num_numa_nodes_ = 0;
+  uint64_t num_so_types_ = 0;
+  uint64_t num_bm_types_ = 0;
+  uint64_t num_blocks_ = 0;
+  uint64_t num_diffusion_grids_ = 0;
+};
+
+/// Simulation objects [`begin_`, `begin_ + num_sim_objects_`) of one NUMA
+/// node, stored in `size_` bytes at file position `offset_`.
+struct BlockHeader {
+  uint64_t numa_node_ = 0;
+  uint64_t begin_ = 0;
+  uint64_t num_sim_objects_ = 0;
+  uint64_t offset_ = 0;
+  uint64_t size_ = 0;
+};
+
+struct GridHeader {
+  uint64_t offset_ = 0;
+  uint64_t size_ = 0;
+};
+
+template <typename T>
+void Append(const T& value, std::vector<char>* buffer) {
+  auto* bytes = reinterpret_cast<const char*>(&value);
+  buffer->insert(buffer->end(), bytes, bytes + sizeof(T));
+}
+
+void AppendString(const std::string& str, std::vector<char>* buffer) {
+  Append<uint64_t>(str.size(), buffer);
+  buffer->insert(buffer->end(), str.begin(), str.end());
+}
+
+void FatalCorrupted() {
+  Log::Fatal("Checkpoint::Restore",
+             "The checkpoint is truncated or corrupted.");
+}
+
+/// Reads consecutive values from the memory range [`begin`, `end`). Aborts
+/// instead of reading beyond `end`.
+class Cursor {
+ public:
+  Cursor(const char* begin, const char* end) : pos_(begin), end_(end) {}
+
+  void Read(void* destination, uint64_t size) {
+    if (size > GetRemaining()) {
+      FatalCorrupted();
+    }
+    std::memcpy(destination, pos_, size);
+    pos_ += size;
+  }
+
+  template <typename T>
+  void Extract(T* value) {
+    Read(value, sizeof(T));
+  }
+
+  std::string ExtractString() {
+    uint64_t size;
+    Extract(&size);
+    if (size > GetRemaining()) {
+      FatalCorrupted();
+    }
+    std::string str(pos_, size);
+    pos_ += size;
+    return str;
+  }
+
+  uint64_t GetRemaining() const { return end_ - pos_; }
+
+ private:
+  const char* pos_;
+  const char* end_;
+};
+
+/// Returns the index of each type name of the checkpoint in `local_names`
+std::vector<uint32_t> MapTypeNames(const std::vector<std::string>& local_names,
+                                   uint64_t num_types, Cursor* cursor) {
+  std::vector<uint32_t> mapping;
+  for (uint64_t i = 0; i < num_types; i++) {
+    auto name = cursor->ExtractString();
+    auto it = std::find(local_names.begin(), local_names.end(), name);
+    if (it == local_names.end()) {
+      Log::Fatal("Checkpoint::Restore", "Type ", name,
+                 " of the checkpoint has not been registered.");
+    }
+    mapping.push_back(it - local_names.begin());
+  }
+  return mapping;
+}
+
+/// Returns the thread that processes block `block_idx` of `numa_node`.
+/// Blocks are distributed round robin among the threads of their NUMA node.
+int GetBlockOwner(const std::vector<std::vector<int>>& numa_threads,
+                  uint64_t numa_node, uint64_t block_idx) {
+  auto& threads = numa_threads[numa_node];
+  if (threads.empty()) {
+    return block_idx % ThreadInfo::GetInstance()->GetMaxThreads();
+  }
+  return threads[block_idx % threads.size()];
+}
+
+/// Returns the ids of the threads of each NUMA node
+std::vector<std::vector<int>> GetNumaThreads(uint64_t num_numa_nodes) {
+  auto* tinfo = ThreadInfo::GetInstance();
+  std::vector<std::vector<int>> numa_threads(num_numa_nodes);
+  for (int tid = 0; tid < tinfo->GetMaxThreads(); tid++) {
+    uint64_t nid = tinfo->GetNumaNode(tid);
+    if (nid < num_numa_nodes) {
+      numa_threads[nid].push_back(tid);
+    }
+  }
+  return numa_threads;
+}
+
+/// Calls `function(i)` for each block `i` on thread `owners[i]`. If the
+/// parallel region does not contain all threads (e.g. `parallel` is false),
+/// blocks are distributed round robin instead.
+template <typename TFunction>
+void ForEachBlock(const std::vector<int>& owners, bool parallel,
+                  const TFunction& function) {
+#pragma omp parallel if (parallel)
+  {
+    int tid = omp_get_thread_num();
+    int nthreads = omp_get_num_threads();
+    bool all_threads =
+        nthreads == ThreadInfo::GetInstance()->GetMaxThreads();
+    for (uint64_t i = 0; i < owners.size(); i++) {
+      int owner = all_threads ? owners[i] : static_cast<int>(i % nthreads);
+      if (owner == tid) {
+        function(i);
+      }
+    }
+  }
+}
+
+void WriteAt(int fd, const void* data, uint64_t size, uint64_t offset,
+             const std::string& file) {
+  auto* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    auto written = pwrite(fd, bytes, size, offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      Log::Fatal("Checkpoint::Write", "Could not write to ", file, ": ",
+                 std::strerror(errno));
+    }
+    bytes += written;
+    size -= written;
+    offset += written;
+  }
+}
+
+/// Maps a whole file read-only into memory
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& file) {
+    int fd = open(file.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1) {
+      Log::Fatal("Checkpoint::Restore", "Could not open ", file, ": ",
+                 std::strerror(errno));
+    }
+    size_ = st.st_size;
+    if (size_ < sizeof(FileHeader)) {
+      Log::Fatal("Checkpoint::Restore", file, " is not a checkpoint.");
+    }
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      Log::Fatal("Checkpoint::Restore", "Could not map ", file, ": ",
+                 std::strerror(errno));
+    }
+    // all pages are read in parallel afterwards
+    madvise(data, size_, MADV_WILLNEED);
+    data_ = static_cast<const char*>(data);
+  }
+
+  ~MappedFile() { munmap(const_cast<char*>(data_), size_); }
+
+  const char* GetData() const { return data_; }
+
+  uint64_t GetSize() const { return size_; }
+
+ private:
+  const char* data_ = nullptr;
+  uint64_t size_ = 0;
+};
+
+bool ReadFileHeader(const std::string& file, FileHeader* header) {
+  std::ifstream ifs(file, std::ios::binary);
+  ifs.read(reinterpret_cast<char*>(header), sizeof(FileHeader));
+  return ifs && header->magic_ == kMagic;
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+/// Serializes simulation objects into a buffer
+class Checkpoint::Writer : public SoVisitor {
+ public:
+  Writer(const Registry* registry, std::vector<char>* buffer)
+      : registry_(registry), buffer_(buffer) {}
+
+  void WriteSimObject(const SimObject* so) {
+    Append(GetTypeIndex(registry_->sim_objects_, so), buffer_);
+    so->ForEachDataMember(this);
+  }
+
+  void Visit(const std::string& name, size_t type_hash_code,
+             const void* data) override {
+    if (type_hash_code == kBiologyModulesHash) {
+      WriteBiologyModules(
+          *static_cast<const std::vector<BaseBiologyModule*>*>(data));
+      return;
+    }
+    auto it = registry_->data_member_sizes_.find(type_hash_code);
+    if (it == registry_->data_member_sizes_.end()) {
+      Log::Fatal("Checkpoint::Write", "The type of data member ", name,
+                 " is not supported. Please register it with "
+                 "Checkpoint::RegisterDataMember or use ROOT backups.");
+    }
+    auto* bytes = static_cast<const char*>(data);
+    buffer_->insert(buffer_->end(), bytes, bytes + it->second);
+  }
+
+ private:
+  const size_t kBiologyModulesHash =
+      typeid(std::vector<BaseBiologyModule*>).hash_code();
+  const Registry* registry_;
+  std::vector<char>* buffer_;
+
+  template <typename TBase>
+  uint32_t GetTypeIndex(const TypeRegistry<TBase>& types,
+                        const TBase* object) const {
+    auto it = types.indices_.find(std::type_index(typeid(*object)));
+    if (it == types.indices_.end()) {
+      Log::Fatal("Checkpoint::Write", "Type ", typeid(*object).name(),
+                 " has not been registered. Please register it (see "
+                 "Checkpoint::RegisterSimObject and "
+                 "Checkpoint::RegisterBiologyModule) or use ROOT backups.");
+    }
+    return it->second;
+  }
+
+  void WriteBiologyModules(const std::vector<BaseBiologyModule*>& bms) {
+    Append<uint64_t>(bms.size(), buffer_);
+    for (auto* bm : bms) {
+      Append(GetTypeIndex(registry_->biology_modules_, bm), buffer_);
+      bm->ForEachDataMember(this);
+    }
+  }
+};
+
+// -----------------------------------------------------------------------------
+/// Reconstructs simulation objects serialized by `Writer`. The visited data
+/// members of a newly created object are overwritten.
+class Checkpoint::Reader : public SoVisitor {
+ public:
+  Reader(const Registry* registry, const std::vector<uint32_t>& so_types,
+         const std::vector<uint32_t>& bm_types, const char* data,
+         uint64_t size)
+      : registry_(registry),
+        so_types_(so_types),
+        bm_types_(bm_types),
+        cursor_(data, data + size) {}
+
+  SimObject* ReadSimObject() {
+    uint32_t type;
+    cursor_.Extract(&type);
+    if (type >= so_types_.size()) {
+      FatalCorrupted();
+    }
+    auto* so = registry_->sim_objects_.factories_[so_types_[type]]();
+    so->ForEachDataMember(this);
+    return so;
+  }
+
+  /// Returns true if all bytes of the block have been read
+  bool IsAtEnd() const { return cursor_.GetRemaining() == 0; }
+
+  void Visit(const std::string& name, size_t type_hash_code,
+             const void* data) override {
+    if (type_hash_code == kBiologyModulesHash) {
+      ReadBiologyModules(const_cast<std::vector<BaseBiologyModule*>*>(
+          static_cast<const std::vector<BaseBiologyModule*>*>(data)));
+      return;
+    }
+    auto it = registry_->data_member_sizes_.find(type_hash_code);
+    if (it == registry_->data_member_sizes_.end()) {
+      Log::Fatal("Checkpoint::Restore", "The type of data member ", name,
+                 " is not supported.");
+    }
+    cursor_.Read(const_cast<void*>(data), it->second);
+  }
+
+ private:
+  const size_t kBiologyModulesHash =
+      typeid(std::vector<BaseBiologyModule*>).hash_code();
+  const Registry* registry_;
+  const std::vector<uint32_t>& so_types_;
+  const std::vector<uint32_t>& bm_types_;
+  Cursor cursor_;
+
+  void ReadBiologyModules(std::vector<BaseBiologyModule*>* bms) {
+    uint64_t size;
+    cursor_.Extract(&size);
+    // each biology module occupies at least the bytes of its type index
+    if (size > cursor_.GetRemaining() / sizeof(uint32_t)) {
+      FatalCorrupted();
+    }
+    bms->reserve(size);
+    for (uint64_t i = 0; i < size; i++) {
+      uint32_t type;
+      cursor_.Extract(&type);
+      if (type >= bm_types_.size()) {
+        FatalCorrupted();
+      }
+      auto* bm = registry_->biology_modules_.factories_[bm_types_[type]]();
+      bm->ForEachDataMember(this);
+      bms->push_back(bm);
+    }
+  }
+};
+
+// -----------------------------------------------------------------------------
+Checkpoint::Registry::Registry() {
+  sim_objects_.Register(typeid(Cell), &NewSimObject<Cell>);
+  biology_modules_.Register(typeid(GrowDivide), &NewBiologyModule<GrowDivide>);
+
+  AddDataMember<bool>();
+  AddDataMember<int>();
+  AddDataMember<uint32_t>();
+  AddDataMember<int64_t>();
+  AddDataMember<uint64_t>();
+  AddDataMember<float>();
+  AddDataMember<double>();
+  AddDataMember<Double3>();
+  AddDataMember<std::array<double, 3>>();
+}
+
+void Checkpoint::Write(const std::string& file,
+                       uint64_t completed_simulation_steps, bool parallel) {
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  auto* registry = GetRegistry();
+  const auto& sim_objects = rm->sim_objects_;
+  auto numa_threads = GetNumaThreads(sim_objects.size());
+
+  // one block for each thread of a NUMA node
+  std::vector<BlockHeader> blocks;
+  std::vector<int> owners;
+  for (uint64_t n = 0; n < sim_objects.size(); n++) {
+    uint64_t num_blocks = std::max<uint64_t>(numa_threads[n].size(), 1);
+    uint64_t num_sos = sim_objects[n].size();
+    for (uint64_t b = 0; b < num_blocks; b++) {
+      BlockHeader block;
+      block.numa_node_ = n;
+      block.begin_ = num_sos * b / num_blocks;
+      block.num_sim_objects_ = num_sos * (b + 1) / num_blocks - block.begin_;
+      blocks.push_back(block);
+      owners.push_back(GetBlockOwner(numa_threads, n, b));
+    }
+  }
+
+  std::vector<std::vector<char>> buffers(blocks.size());
+  ForEachBlock(owners, parallel, [&](uint64_t i) {
+    auto& block = blocks[i];
+    auto& numa_sos = sim_objects[block.numa_node_];
+    // rough estimate to avoid most reallocations
+    buffers[i].reserve(block.num_sim_objects_ * 128);
+    Writer writer(registry, &buffers[i]);
+    for (uint64_t j = 0; j < block.num_sim_objects_; j++) {
+      writer.WriteSimObject(numa_sos[block.begin_ + j]);
+    }
+    block.size_ = buffers[i].size();
+  });
+
+  // diffusion grid arrays are written directly from their vectors
+  std::vector<const DiffusionGrid*> grids;
+  std::vector<std::vector<char>> grid_buffers;
+  std::vector<GridHeader> grid_headers;
+  for (auto& el : rm->diffusion_grids_) {
+    auto* dgrid = el.second;
+    grids.push_back(dgrid);
+    grid_buffers.emplace_back();
+    WriteDiffusionGrid(dgrid, &grid_buffers.back());
+    // parameters, concentrations and gradients (x, y, z)
+    GridHeader header;
+    header.size_ = grid_buffers.back().size() +
+                   4 * dgrid->total_num_boxes_ * sizeof(double);
+    grid_headers.push_back(header);
+  }
+
+  FileHeader file_header;
+  file_header.completed_simulation_steps_ = completed_simulation_steps;
+  file_header.last_uid_ = SoUidGenerator::Get()->GetLastId();
+  file_header.num_numa_nodes_ = sim_objects.size();
+  file_header.num_so_types_ = registry->sim_objects_.names_.size();
+  file_header.num_bm_types_ = registry->biology_modules_.names_.size();
+  file_header.num_blocks_ = blocks.size();
+  file_header.num_diffusion_grids_ = grids.size();
+
+  std::vector<char> header;
+  Append(file_header, &header);
+  for (auto& name : registry->sim_objects_.names_) {
+    AppendString(name, &header);
+  }
+  for (auto& name : registry->biology_modules_.names_) {
+    AppendString(name, &header);
+  }
+  uint64_t offset = header.size() + blocks.size() * sizeof(BlockHeader) +
+                    grids.size() * sizeof(GridHeader);
+  for (auto& block : blocks) {
+    block.offset_ = offset;
+    offset += block.size_;
+    Append(block, &header);
+  }
+  for (auto& grid_header : grid_headers) {
+    grid_header.offset_ = offset;
+    offset += grid_header.size_;
+    Append(grid_header, &header);
+  }
+
+  int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    Log::Fatal("Checkpoint::Write", "Could not open ", file, ": ",
+               std::strerror(errno));
+  }
+  WriteAt(fd, header.data(), header.size(), 0, file);
+  ForEachBlock(owners, parallel, [&](uint64_t i) {
+    WriteAt(fd, buffers[i].data(), blocks[i].size_, blocks[i].offset_, file);
+  });
+  for (uint64_t i = 0; i < grids.size(); i++) {
+    auto* dgrid = grids[i];
+    auto num_boxes = dgrid->total_num_boxes_;
+    auto pos = grid_headers[i].offset_;
+    WriteAt(fd, grid_buffers[i].data(), grid_buffers[i].size(), pos, file);
+    pos += grid_buffers[i].size();
+    WriteAt(fd, dgrid->c1_.data(), num_boxes * sizeof(double), pos, file);
+    pos += num_boxes * sizeof(double);
+    WriteAt(fd, dgrid->gradients_.data(), 3 * num_boxes * sizeof(double), pos,
+            file);
+  }
+  close(fd);
+}
+
+void Checkpoint::Restore(const std::string& file) {
+  MappedFile mapped(file);
+  Cursor cursor(mapped.GetData(), mapped.GetData() + mapped.GetSize());
+  FileHeader file_header;
+  cursor.Extract(&file_header);
+  if (file_header.magic_ != kMagic) {
+    Log::Fatal("Checkpoint::Restore", file, " is not a checkpoint.");
+  } else if (file_header.version_ != kVersion) {
+    Log::Fatal("Checkpoint::Restore", file, " has version ",
+               file_header.version_, ". Only version ", kVersion,
+               " is supported.");
+  }
+
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  auto* registry = GetRegistry();
+  auto& sim_objects = rm->sim_objects_;
+  if (file_header.num_numa_nodes_ != sim_objects.size()) {
+    Log::Fatal("Checkpoint::Restore", file,
+               " was written on a system with a different number of NUMA "
+               "nodes.");
+  }
+
+  auto so_types = MapTypeNames(registry->sim_objects_.names_,
+                               file_header.num_so_types_, &cursor);
+  auto bm_types = MapTypeNames(registry->biology_modules_.names_,
+                               file_header.num_bm_types_, &cursor);
+  if (file_header.num_blocks_ > cursor.GetRemaining() / sizeof(BlockHeader) ||
+      file_header.num_diffusion_grids_ >
+          cursor.GetRemaining() / sizeof(GridHeader)) {
+    FatalCorrupted();
+  }
+  std::vector<BlockHeader> blocks(file_header.num_blocks_);
+  for (auto& block : blocks) {
+    cursor.Extract(&block);
+  }
+  std::vector<GridHeader> grid_headers(file_header.num_diffusion_grids_);
+  for (auto& grid_header : grid_headers) {
+    cursor.Extract(&grid_header);
+  }
+  auto size = mapped.GetSize();
+  for (auto& block : blocks) {
+    // each simulation object occupies at least the bytes of its type index
+    if (block.offset_ > size || block.size_ > size - block.offset_ ||
+        block.numa_node_ >= sim_objects.size() ||
+        block.num_sim_objects_ > block.size_ / sizeof(uint32_t)) {
+      FatalCorrupted();
+    }
+  }
+  for (auto& grid_header : grid_headers) {
+    if (grid_header.offset_ > size ||
+        grid_header.size_ > size - grid_header.offset_) {
+      FatalCorrupted();
+    }
+  }
+  // the blocks of each NUMA node must cover its simulation objects without
+  // gaps or overlaps
+  std::vector<const BlockHeader*> sorted_blocks;
+  for (auto& block : blocks) {
+    sorted_blocks.push_back(&block);
+  }
+  std::sort(sorted_blocks.begin(), sorted_blocks.end(),
+            [](const BlockHeader* lhs, const BlockHeader* rhs) {
+              return lhs->numa_node_ < rhs->numa_node_ ||
+                     (lhs->numa_node_ == rhs->numa_node_ &&
+                      lhs->begin_ < rhs->begin_);
+            });
+  std::vector<uint64_t> numa_sizes(sim_objects.size());
+  for (auto* block : sorted_blocks) {
+    if (block->begin_ != numa_sizes[block->numa_node_]) {
+      FatalCorrupted();
+    }
+    numa_sizes[block->numa_node_] += block->num_sim_objects_;
+  }
+
+  rm->Clear();
+  for (auto& el : rm->diffusion_grids_) {
+    delete el.second;
+  }
+  rm->diffusion_grids_.clear();
+
+  // make room for all simulation objects such that blocks can be
+  // reconstructed in parallel
+  for (uint64_t n = 0; n < sim_objects.size(); n++) {
+    sim_objects[n].resize(numa_sizes[n]);
+  }
+  rm->uid_soh_map_.Reserve(file_header.last_uid_);
+
+  auto numa_threads = GetNumaThreads(sim_objects.size());
+  std::vector<int> owners;
+  std::vector<uint64_t> numa_block_idx(sim_objects.size());
+  for (auto& block : blocks) {
+    auto nid = block.numa_node_;
+    owners.push_back(GetBlockOwner(numa_threads, nid, numa_block_idx[nid]++));
+  }
+
+  ForEachBlock(owners, true, [&](uint64_t i) {
+    auto& block = blocks[i];
+    auto& numa_sos = sim_objects[block.numa_node_];
+    Reader reader(registry, so_types, bm_types,
+                  mapped.GetData() + block.offset_, block.size_);
+    for (uint64_t j = 0; j < block.num_sim_objects_; j++) {
+      auto* so = reader.ReadSimObject();
+      auto idx = block.begin_ + j;
+      numa_sos[idx] = so;
+      // `uid_soh_map_` must not grow concurrently
+      if (so->GetUid() >= file_header.last_uid_) {
+        FatalCorrupted();
+      }
+      rm->uid_soh_map_.Insert(so->GetUid(), SoHandle(block.numa_node_, idx));
+    }
+    if (!reader.IsAtEnd()) {
+      FatalCorrupted();
+    }
+  });
+
+  for (auto& grid_header : grid_headers) {
+    auto* dgrid = ReadDiffusionGrid(mapped.GetData() + grid_header.offset_,
+                                    grid_header.size_);
+    rm->diffusion_grids_[dgrid->GetSubstanceId()] = dgrid;
+  }
+
+  // the constructors used above generated new uids
+  SoUidGenerator::Get()->SetLastId(file_header.last_uid_);
+}
+
+bool Checkpoint::IsCheckpoint(const std::string& file) {
+  FileHeader header;
+  return ReadFileHeader(file, &header);
+}
+
+uint64_t Checkpoint::GetSimulationSteps(const std::string& file) {
+  FileHeader header;
+  if (!ReadFileHeader(file, &header)) {
+    Log::Fatal("Checkpoint::GetSimulationSteps", file,
+               " is not a checkpoint.");
+  }
+  return header.completed_simulation_steps_;
+}
+
+void Checkpoint::WriteDiffusionGrid(const DiffusionGrid* dgrid,
+                                    std::vector<char>* buffer) {
+  Append(dgrid->substance_, buffer);
+  AppendString(dgrid->substance_name_, buffer);
+  Append(dgrid->box_length_, buffer);
+  Append(dgrid->box_volume_, buffer);
+  Append(dgrid->concentration_threshold_, buffer);
+  Append(dgrid->dc_, buffer);
+  Append(dgrid->dt_, buffer);
+  Append(dgrid->mu_, buffer);
+  Append(dgrid->grid_dimensions_, buffer);
+  Append(dgrid->num_boxes_axis_, buffer);
+  Append(dgrid->total_num_boxes_, buffer);
+  Append(dgrid->initialized_, buffer);
+  Append(dgrid->resolution_, buffer);
+  Append(dgrid->parity_, buffer);
+  Append(dgrid->init_gradient_, buffer);
+}
+
+DiffusionGrid* Checkpoint::ReadDiffusionGrid(const char* data,
+                                             uint64_t size) {
+  Cursor cursor(data, data + size);
+  auto* dgrid = new DiffusionGrid(static_cast<TRootIOCtor*>(nullptr));
+  cursor.Extract(&dgrid->substance_);
+  dgrid->substance_name_ = cursor.ExtractString();
+  cursor.Extract(&dgrid->box_length_);
+  cursor.Extract(&dgrid->box_volume_);
+  cursor.Extract(&dgrid->concentration_threshold_);
+  cursor.Extract(&dgrid->dc_);
+  cursor.Extract(&dgrid->dt_);
+  cursor.Extract(&dgrid->mu_);
+  cursor.Extract(&dgrid->grid_dimensions_);
+  cursor.Extract(&dgrid->num_boxes_axis_);
+  cursor.Extract(&dgrid->total_num_boxes_);
+  cursor.Extract(&dgrid->initialized_);
+  cursor.Extract(&dgrid->resolution_);
+  cursor.Extract(&dgrid->parity_);
+  cursor.Extract(&dgrid->init_gradient_);
+
+  // concentrations and gradients (x, y, z)
+  auto num_boxes = dgrid->total_num_boxes_;
+  if (num_boxes > cursor.GetRemaining() / (4 * sizeof(double))) {
+    FatalCorrupted();
+  }
+  dgrid->c1_.resize(num_boxes);
+  dgrid->c2_.resize(num_boxes);
+  dgrid->gradients_.resize(3 * num_boxes);
+  cursor.Read(dgrid->c1_.data(), num_boxes * sizeof(double));
+  cursor.Read(dgrid->gradients_.data(), 3 * num_boxes * sizeof(double));
+  return dgrid;
+}
+
+}  // namespace bdm
@@ -0,0 +1,162 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_CHECKPOINT_H_
+#define CORE_CHECKPOINT_H_
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#include "core/biology_module/biology_module.h"
+#include "core/sim_object/sim_object.h"
+#include "core/util/root.h"
+
+namespace bdm {
+
+class DiffusionGrid;
+
+/// \brief Native binary checkpoint of all simulation objects and diffusion
+/// grids of the active simulation.
+///
+/// In contrast to ROOT backups (see `SimulationBackup`), data members are
+/// streamed with the visitor `SimObject::ForEachDataMember` and copied as
+/// raw bytes. The simulation objects of each thread are written into a
+/// separate block in parallel. Each block belongs to one NUMA node. During
+/// restore, the file is mapped into memory and each block is reconstructed
+/// by a thread of its NUMA node. Diffusion grid arrays are written and
+/// restored without conversion.\n
+/// The file can only be restored on a machine with the same byte order,
+/// the same number of NUMA nodes and by an executable that has registered
+/// the same types. The random number generator state and the parameters are
+/// not part of a checkpoint.\n
+/// Only registered types can be stored. `Cell` and `GrowDivide` are
+/// registered by default.
+class Checkpoint {
+ public:
+  /// Writes all simulation objects and diffusion grids of the active
+  /// simulation to `file`.\n
+  /// If `parallel` is false, no parallel region is opened (e.g. in a forked
+  /// process; see `SimulationBackup::BackupAsync`).
+  static void Write(const std::string& file,
+                    uint64_t completed_simulation_steps, bool parallel = true);
+
+  /// Replaces all simulation objects and diffusion grids of the active
+  /// simulation with the ones stored in `file`.
+  static void Restore(const std::string& file);
+
+  /// Returns true if `file` has been written by `Write`.
+  static bool IsCheckpoint(const std::string& file);
+
+  /// Returns the number of completed simulation steps stored in `file`.
+  static uint64_t GetSimulationSteps(const std::string& file);
+
+  /// Enables checkpoints of simulation objects of type `TSimObject`.
+  /// `ForEachDataMember` must visit its whole state and all visited data
+  /// members must be supported (see `RegisterDataMember`).
+  template <typename TSimObject>
+  static void RegisterSimObject() {
+    GetRegistry()->sim_objects_.Register(typeid(TSimObject),
+                                         &NewSimObject<TSimObject>);
+  }
+
+  /// Enables checkpoints of biology modules of type `TBiologyModule`.
+  /// `BaseBiologyModule::ForEachDataMember` must visit its whole state.
+  template <typename TBiologyModule>
+  static void RegisterBiologyModule() {
+    GetRegistry()->biology_modules_.Register(
+        typeid(TBiologyModule), &NewBiologyModule<TBiologyModule>);
+  }
+
+  /// Enables checkpoints of data members of type `T`. They are copied
+  /// byte by byte. Hence, `T` must not own resources (e.g. heap memory).
+  template <typename T>
+  static void RegisterDataMember() {
+    GetRegistry()->AddDataMember<T>();
+  }
+
+ private:
+  /// Maps types to consecutive indices and to a function that creates a new
+  /// instance of them. Only the type names are stored in a checkpoint.
+  template <typename TBase>
+  struct TypeRegistry {
+    using Factory = TBase* (*)();
+
+    std::vector<std::string> names_;
+    std::vector<Factory> factories_;
+    std::unordered_map<std::type_index, uint32_t> indices_;
+
+    void Register(const std::type_info& type, Factory factory) {
+      if (indices_.find(std::type_index(type)) != indices_.end()) {
+        return;
+      }
+      indices_[std::type_index(type)] = names_.size();
+      names_.push_back(type.name());
+      factories_.push_back(factory);
+    }
+  };
+
+  struct Registry {
+    TypeRegistry<SimObject> sim_objects_;
+    TypeRegistry<BaseBiologyModule> biology_modules_;
+    /// Maps the type hash code of supported data members to their size
+    std::unordered_map<size_t, size_t> data_member_sizes_;
+
+    Registry();
+
+    template <typename T>
+    void AddDataMember() {
+      // `std::is_trivially_copyable` would exclude `MathArray`
+      static_assert(std::is_standard_layout<T>::value &&
+                        std::is_trivially_destructible<T>::value,
+                    "Data members must be copyable byte by byte.");
+      data_member_sizes_[typeid(T).hash_code()] = sizeof(T);
+    }
+  };
+
+  static Registry* GetRegistry() {
+    static Registry kInstance;
+    return &kInstance;
+  }
+
+  /// Creates an object whose data members are overwritten afterwards
+  template <typename TSimObject>
+  static SimObject* NewSimObject() {
+    return new TSimObject(static_cast<TRootIOCtor*>(nullptr));
+  }
+
+  template <typename TBiologyModule>
+  static BaseBiologyModule* NewBiologyModule() {
+    return new TBiologyModule();
+  }
+
+  /// Appends all data members of `dgrid` except the arrays
+  static void WriteDiffusionGrid(const DiffusionGrid* dgrid,
+                                 std::vector<char>* buffer);
+
+  /// Reads a diffusion grid written by `WriteDiffusionGrid` followed by its
+  /// concentration and gradient arrays from `size` bytes at `data`.
+  static DiffusionGrid* ReadDiffusionGrid(const char* data, uint64_t size);
+
+  class Writer;
+  class Reader;
+};
+
+}  // namespace bdm
+
+#endif  // CORE_CHECKPOINT_H_
@@ -50,6 +50,19 @@ class SimObjectVector {
     }
   }
 
+  /// Resizes the containers such that they hold one element for each
+  /// simulation object in the simulation.
+  /// In contrast to `reserve()`, existing elements are preserved.
+  void resize() {  // NOLINT
+    auto* sim = Simulation::GetActive();
+    auto* rm = sim->GetResourceManager();
+    for (int n = 0; n < thread_info_->GetNumaNodes(); n++) {
+      auto num_sos = rm->GetNumSimObjects(n);
+      data_[n].resize(num_sos);
+      size_[n] = num_sos;
+    }
+  }
+
   void clear() {  // NOLINT
     for (auto& el : size_) {
       el = 0;
@@ -60,7 +73,9 @@ class SimObjectVector {
   }
 
   // Returns the number of elements of specified type
-  size_t size(uint16_t numa_node) { return size_[numa_node]; }  // NOLINT
+  size_t size(SoHandle::NumaNode_t numa_node) {  // NOLINT
+    return size_[numa_node];
+  }
 
   const T& operator[](const SoHandle& handle) const {
     return data_[handle.GetNumaNode()][handle.GetElementIdx()];
@@ -0,0 +1,156 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_CONTAINER_SO_UID_MAP_H_
+#define CORE_CONTAINER_SO_UID_MAP_H_
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "core/sim_object/so_uid.h"
+
+namespace bdm {
+
+/// \brief Maps SoUids to values using a paged table.
+///
+/// `SoUidGenerator` hands out consecutive ids. Therefore, a lookup is two
+/// array accesses: the page of `uid` and the entry inside the page. Pages are
+/// allocated when the first value is inserted and released by `ShrinkToFit`
+/// once they are empty. Hence, the memory consumption is proportional to the
+/// number of pages in use, and not to the number of all uids that have ever
+/// been generated. Only the page table grows with the latter (one pointer for
+/// `kPageSize` uids).\n
+/// A default constructed `TValue` marks an empty entry. Hence, it must not
+/// be inserted.\n
+/// `Insert` and `Remove` are thread-safe for distinct uids, if `uid` is
+/// smaller than the limit that has been reserved with `Reserve`.
+template <typename TValue>
+class SoUidMap {
+ public:
+  /// Number of entries per page
+  static constexpr uint64_t kPageSize = 1024;
+
+  SoUidMap() {}
+  SoUidMap(const SoUidMap&) = delete;
+  SoUidMap& operator=(const SoUidMap&) = delete;
+
+  ~SoUidMap() { clear(); }
+
+  bool Contains(SoUid uid) const { return !((*this)[uid] == TValue()); }
+
+  /// Returns the value for `uid`, or `TValue()` if `uid` is not stored in
+  /// this map.
+  TValue operator[](SoUid uid) const {
+    auto* page = GetPage(uid);
+    return page != nullptr ? page[uid % kPageSize] : TValue();
+  }
+
+  void Insert(SoUid uid, const TValue& value) {
+    Reserve(uid + 1);
+    auto& entry = pages_[uid / kPageSize];
+    auto* page = entry.load(std::memory_order_acquire);
+    if (page == nullptr) {
+      // another thread might allocate the same page concurrently
+      auto* new_page = new TValue[kPageSize]();
+      if (entry.compare_exchange_strong(page, new_page,
+                                        std::memory_order_acq_rel)) {
+        page = new_page;
+      } else {
+        delete[] new_page;
+      }
+    }
+    page[uid % kPageSize] = value;
+  }
+
+  void Remove(SoUid uid) {
+    auto* page = GetPage(uid);
+    if (page != nullptr) {
+      page[uid % kPageSize] = TValue();
+    }
+  }
+
+  /// Makes room in the page table for all uids smaller than `end`.
+  /// Pages are only allocated once a value is inserted.
+  /// NB: This method is not thread-safe!
+  void Reserve(SoUid end) {
+    auto num_pages = (end + kPageSize - 1) / kPageSize;
+    if (num_pages <= pages_.size()) {
+      return;
+    }
+    // grow geometrically to amortize the cost of consecutive insertions
+    std::vector<std::atomic<TValue*>> grown(
+        std::max<uint64_t>(num_pages, 2 * pages_.size()));
+    for (uint64_t i = 0; i < pages_.size(); i++) {
+      grown[i].store(pages_[i].load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+    }
+    pages_.swap(grown);
+  }
+
+  /// Releases all pages that do not contain any value.\n
+  /// NB: This method is not thread-safe!
+  void ShrinkToFit() {
+    for (auto& entry : pages_) {
+      auto* page = entry.load(std::memory_order_relaxed);
+      if (page == nullptr) {
+        continue;
+      }
+      uint64_t i = 0;
+      while (i < kPageSize && page[i] == TValue()) {
+        i++;
+      }
+      if (i == kPageSize) {
+        delete[] page;
+        entry.store(nullptr, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void clear() {  // NOLINT
+    for (auto& entry : pages_) {
+      delete[] entry.load(std::memory_order_relaxed);
+    }
+    pages_.clear();
+  }
+
+  /// Returns the number of entries in allocated pages (including empty ones)
+  uint64_t size() const {  // NOLINT
+    uint64_t num_pages = 0;
+    for (auto& entry : pages_) {
+      if (entry.load(std::memory_order_relaxed) != nullptr) {
+        num_pages++;
+      }
+    }
+    return num_pages * kPageSize;
+  }
+
+ private:
+  /// `pages_[i]` stores the values of uids [i * kPageSize, (i + 1) *
+  /// kPageSize), or is `nullptr` if none of them is stored in this map.
+  std::vector<std::atomic<TValue*>> pages_;
+
+  /// Returns the page of `uid`, or `nullptr` if it has not been allocated.
+  TValue* GetPage(SoUid uid) const {
+    auto idx = uid / kPageSize;
+    if (idx >= pages_.size()) {
+      return nullptr;
+    }
+    return pages_[idx].load(std::memory_order_acquire);
+  }
+};
+
+}  // namespace bdm
+
+#endif  // CORE_CONTAINER_SO_UID_MAP_H_
@@ -415,55 +415,7 @@ class DiffusionGrid {
       return;
     }
 
-    const auto nx = num_boxes_axis_[0];
-    const auto ny = num_boxes_axis_[1];
-    const auto nz = num_boxes_axis_[2];
-
-    const double ibl2 = 1 / (box_length_ * box_length_);
-    const double d = 1 - dc_[0];
-
-#define YBF 16
-#pragma omp parallel for collapse(2)
-    for (size_t yy = 0; yy < ny; yy += YBF) {
-      for (size_t z = 0; z < nz; z++) {
-        size_t ymax = yy + YBF;
-        if (ymax >= ny) {
-          ymax = ny;
-        }
-        for (size_t y = yy; y < ymax; y++) {
-          size_t x = 0;
-          int c, n, s, b, t;
-          c = x + y * nx + z * nx * ny;
-#pragma omp simd
-          for (x = 1; x < nx - 1; x++) {
-            ++c;
-            ++n;
-            ++s;
-            ++b;
-            ++t;
-
-            if (y == 0 || y == (ny - 1) || z == 0 || z == (nz - 1)) {
-              continue;
-            }
-
-            n = c - nx;
-            s = c + nx;
-            b = c - nx * ny;
-            t = c + nx * ny;
-            c2_[c] = (c1_[c] +
-                      d * dt_ * (c1_[c - 1] - 2 * c1_[c] + c1_[c + 1]) * ibl2 +
-                      d * dt_ * (c1_[s] - 2 * c1_[c] + c1_[n]) * ibl2 +
-                      d * dt_ * (c1_[b] - 2 * c1_[c] + c1_[t]) * ibl2) *
-                     (1 - mu_);
-          }
-          ++c;
-          ++n;
-          ++s;
-          ++b;
-          ++t;
-        }  // tile ny
-      }    // tile nz
-    }      // block ny
+    DiffuseEulerPlanes(0, num_boxes_axis_[2], true);
     c1_.swap(c2_);
   }
 
@@ -474,89 +426,33 @@ class DiffusionGrid {
       return;
     }
 
-    const auto nx = num_boxes_axis_[0];
-    const auto ny = num_boxes_axis_[1];
-    const auto nz = num_boxes_axis_[2];
-
-    const double ibl2 = 1 / (box_length_ * box_length_);
-    const double d = 1 - dc_[0];
-    std::array<int, 4> l;
-
-#define YBF 16
-#pragma omp parallel for collapse(2)
-    for (size_t yy = 0; yy < ny; yy += YBF) {
-      for (size_t z = 0; z < nz; z++) {
-        size_t ymax = yy + YBF;
-        if (ymax >= ny) {
-          ymax = ny;
-        }
-        for (size_t y = yy; y < ymax; y++) {
-          size_t x = 0;
-          int c, n, s, b, t;
-          c = x + y * nx + z * nx * ny;
-
-          l.fill(1);
-
-          if (y == 0) {
-            n = c;
-            l[0] = 0;
-          } else {
-            n = c - nx;
-          }
-
-          if (y == ny - 1) {
-            s = c;
-            l[1] = 0;
-          } else {
-            s = c + nx;
-          }
+    DiffuseEulerLeakingEdgePlanes(0, num_boxes_axis_[2], true);
+    c1_.swap(c2_);
+  }
 
-          if (z == 0) {
-            b = c;
-            l[2] = 0;
-          } else {
-            b = c - nx * ny;
-          }
+  /// Calculates `DiffuseEuler` for the xy planes with z index in
+  /// [z_begin, z_end) on the calling thread. Disjoint ranges can be
+  /// processed in parallel (e.g. as tasks of different threads). Once all
+  /// planes have been processed, `FinishDiffusion` must be called.
+  void DiffuseEulerSlab(size_t z_begin, size_t z_end) {
+    if (!IsFixedSubstance()) {
+      DiffuseEulerPlanes(z_begin, z_end, false);
+    }
+  }
 
-          if (z == nz - 1) {
-            t = c;
-            l[3] = 0;
-          } else {
-            t = c + nx * ny;
-          }
+  /// Same as `DiffuseEulerSlab` for `DiffuseEulerLeakingEdge`
+  void DiffuseEulerLeakingEdgeSlab(size_t z_begin, size_t z_end) {
+    if (!IsFixedSubstance()) {
+      DiffuseEulerLeakingEdgePlanes(z_begin, z_end, false);
+    }
+  }
 
-          c2_[c] = (c1_[c] + d * dt_ * (0 - 2 * c1_[c] + c1_[c + 1]) * ibl2 +
-                    d * dt_ * (c1_[s] - 2 * c1_[c] + c1_[n]) * ibl2 +
-                    d * dt_ * (c1_[b] - 2 * c1_[c] + c1_[t]) * ibl2) *
-                   (1 - mu_);
-#pragma omp simd
-          for (x = 1; x < nx - 1; x++) {
-            ++c;
-            ++n;
-            ++s;
-            ++b;
-            ++t;
-            c2_[c] =
-                (c1_[c] +
-                 d * dt_ * (c1_[c - 1] - 2 * c1_[c] + c1_[c + 1]) * ibl2 +
-                 d * dt_ * (l[0] * c1_[s] - 2 * c1_[c] + l[1] * c1_[n]) * ibl2 +
-                 d * dt_ * (l[2] * c1_[b] - 2 * c1_[c] + l[3] * c1_[t]) *
-                     ibl2) *
-                (1 - mu_);
-          }
-          ++c;
-          ++n;
-          ++s;
-          ++b;
-          ++t;
-          c2_[c] = (c1_[c] + d * dt_ * (c1_[c - 1] - 2 * c1_[c] + 0) * ibl2 +
-                    d * dt_ * (c1_[s] - 2 * c1_[c] + c1_[n]) * ibl2 +
-                    d * dt_ * (c1_[b] - 2 * c1_[c] + c1_[t]) * ibl2) *
-                   (1 - mu_);
-        }  // tile ny
-      }    // tile nz
-    }      // block ny
-    c1_.swap(c2_);
+  /// Replaces the concentrations with the ones calculated by
+  /// `DiffuseEulerSlab` or `DiffuseEulerLeakingEdgeSlab`
+  void FinishDiffusion() {
+    if (!IsFixedSubstance()) {
+      c1_.swap(c2_);
+    }
   }
 
   /// Calculates the gradient for each box in the diffusion grid.
@@ -782,6 +678,150 @@ class DiffusionGrid {
   // turn to true after gradient initialization
   bool init_gradient_ = false;
 
+  /// Implementation of `DiffuseEuler` for the xy planes with z index in
+  /// [z_begin, z_end). Opens a parallel region if `parallel` is true.
+  void DiffuseEulerPlanes(size_t z_begin, size_t z_end, bool parallel) {
+    const auto nx = num_boxes_axis_[0];
+    const auto ny = num_boxes_axis_[1];
+    const auto nz = num_boxes_axis_[2];
+
+    const double ibl2 = 1 / (box_length_ * box_length_);
+    const double d = 1 - dc_[0];
+
+#define YBF 16
+#pragma omp parallel for collapse(2) if (parallel)
+    for (size_t yy = 0; yy < ny; yy += YBF) {
+      for (size_t z = z_begin; z < z_end; z++) {
+        size_t ymax = yy + YBF;
+        if (ymax >= ny) {
+          ymax = ny;
+        }
+        for (size_t y = yy; y < ymax; y++) {
+          size_t x = 0;
+          int c, n, s, b, t;
+          c = x + y * nx + z * nx * ny;
+#pragma omp simd
+          for (x = 1; x < nx - 1; x++) {
+            ++c;
+            ++n;
+            ++s;
+            ++b;
+            ++t;
+
+            if (y == 0 || y == (ny - 1) || z == 0 || z == (nz - 1)) {
+              continue;
+            }
+
+            n = c - nx;
+            s = c + nx;
+            b = c - nx * ny;
+            t = c + nx * ny;
+            c2_[c] = (c1_[c] +
+                      d * dt_ * (c1_[c - 1] - 2 * c1_[c] + c1_[c + 1]) * ibl2 +
+                      d * dt_ * (c1_[s] - 2 * c1_[c] + c1_[n]) * ibl2 +
+                      d * dt_ * (c1_[b] - 2 * c1_[c] + c1_[t]) * ibl2) *
+                     (1 - mu_);
+          }
+          ++c;
+          ++n;
+          ++s;
+          ++b;
+          ++t;
+        }  // tile ny
+      }    // tile nz
+    }      // block ny
+  }
+
+  /// Implementation of `DiffuseEulerLeakingEdge` for the xy planes with z
+  /// index in [z_begin, z_end). Opens a parallel region if `parallel` is
+  /// true.
+  void DiffuseEulerLeakingEdgePlanes(size_t z_begin, size_t z_end,
+                                     bool parallel) {
+    const auto nx = num_boxes_axis_[0];
+    const auto ny = num_boxes_axis_[1];
+    const auto nz = num_boxes_axis_[2];
+
+    const double ibl2 = 1 / (box_length_ * box_length_);
+    const double d = 1 - dc_[0];
+
+#define YBF 16
+#pragma omp parallel for collapse(2) if (parallel)
+    for (size_t yy = 0; yy < ny; yy += YBF) {
+      for (size_t z = z_begin; z < z_end; z++) {
+        size_t ymax = yy + YBF;
+        if (ymax >= ny) {
+          ymax = ny;
+        }
+        for (size_t y = yy; y < ymax; y++) {
+          size_t x = 0;
+          int c, n, s, b, t;
+          c = x + y * nx + z * nx * ny;
+
+          std::array<int, 4> l;
+          l.fill(1);
+
+          if (y == 0) {
+            n = c;
+            l[0] = 0;
+          } else {
+            n = c - nx;
+          }
+
+          if (y == ny - 1) {
+            s = c;
+            l[1] = 0;
+          } else {
+            s = c + nx;
+          }
+
+          if (z == 0) {
+            b = c;
+            l[2] = 0;
+          } else {
+            b = c - nx * ny;
+          }
+
+          if (z == nz - 1) {
+            t = c;
+            l[3] = 0;
+          } else {
+            t = c + nx * ny;
+          }
+
+          c2_[c] = (c1_[c] + d * dt_ * (0 - 2 * c1_[c] + c1_[c + 1]) * ibl2 +
+                    d * dt_ * (c1_[s] - 2 * c1_[c] + c1_[n]) * ibl2 +
+                    d * dt_ * (c1_[b] - 2 * c1_[c] + c1_[t]) * ibl2) *
+                   (1 - mu_);
+#pragma omp simd
+          for (x = 1; x < nx - 1; x++) {
+            ++c;
+            ++n;
+            ++s;
+            ++b;
+            ++t;
+            c2_[c] =
+                (c1_[c] +
+                 d * dt_ * (c1_[c - 1] - 2 * c1_[c] + c1_[c + 1]) * ibl2 +
+                 d * dt_ * (l[0] * c1_[s] - 2 * c1_[c] + l[1] * c1_[n]) * ibl2 +
+                 d * dt_ * (l[2] * c1_[b] - 2 * c1_[c] + l[3] * c1_[t]) *
+                     ibl2) *
+                (1 - mu_);
+          }
+          ++c;
+          ++n;
+          ++s;
+          ++b;
+          ++t;
+          c2_[c] = (c1_[c] + d * dt_ * (c1_[c - 1] - 2 * c1_[c] + 0) * ibl2 +
+                    d * dt_ * (c1_[s] - 2 * c1_[c] + c1_[n]) * ibl2 +
+                    d * dt_ * (c1_[b] - 2 * c1_[c] + c1_[t]) * ibl2) *
+                   (1 - mu_);
+        }  // tile ny
+      }    // tile nz
+    }      // block ny
+  }
+
+  friend class Checkpoint;
   BDM_CLASS_DEF_NV(DiffusionGrid, 1);
 };
 
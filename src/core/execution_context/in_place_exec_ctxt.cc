@@ -48,9 +48,15 @@ void InPlaceExecutionContext::TearDownIterationAll(
     new_so_per_numa[nid] += ctxt->new_sim_objects_.size();
   }
 
+  // simulation objects that might have been modified by a neighbor
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  for (auto* ctxt : all_exec_ctxts) {
+    rm->AddOutdatedSoAEntries(ctxt->modified_);
+    ctxt->modified_.clear();
+  }
+
   // reserve enough memory in ResourceManager
   std::vector<uint64_t> numa_offsets(tinfo_->GetNumaNodes());
-  auto* rm = Simulation::GetActive()->GetResourceManager();
   for (unsigned n = 0; n < new_so_per_numa.size(); n++) {
     numa_offsets[n] = rm->GrowSoContainer(new_so_per_numa[n], n);
   }
@@ -66,37 +72,63 @@ void InPlaceExecutionContext::TearDownIterationAll(
   }
 
   // remove
+  // remove them after adding new ones (maybe one has been removed
+  // that was in new_sim_objects_)
+  std::vector<SoUid> remove;
   for (int i = 0; i < tinfo_->GetMaxThreads(); i++) {
     auto* ctxt = all_exec_ctxts[i];
-    // removed sim objects
-    // remove them after adding new ones (maybe one has been removed
-    // that was in new_sim_objects_)
-    for (auto& uid : ctxt->remove_) {
-      rm->Remove(uid);
-    }
+    remove.insert(remove.end(), ctxt->remove_.begin(), ctxt->remove_.end());
     ctxt->remove_.clear();
   }
+  if (remove.size() != 0) {
+    rm->RemoveSimObjects(remove);
+  }
 }
 
 void InPlaceExecutionContext::Execute(
     SimObject* so, const std::vector<Operation>& operations) {
-  auto* grid = Simulation::GetActive()->GetGrid();
-  auto nb_mutex_builder = grid->GetNeighborMutexBuilder();
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  Execute(so, rm->GetSoHandle(so->GetUid()), operations);
+}
+
+void InPlaceExecutionContext::Execute(
+    SimObject* so, SoHandle soh, const std::vector<Operation>& operations) {
+  auto* spatial_index = Simulation::GetActive()->GetSpatialIndex();
+  auto nb_mutex_builder = spatial_index->GetNeighborMutexBuilder();
   if (nb_mutex_builder != nullptr) {
     auto mutex = nb_mutex_builder->GetMutex(so->GetBoxIdx());
     std::lock_guard<decltype(mutex)> guard(mutex);
-    neighbor_cache_.clear();
-    for (auto& op : operations) {
-      op(so);
-    }
+    RunOperations(so, soh, operations);
   } else {
-    neighbor_cache_.clear();
-    for (auto& op : operations) {
-      op(so);
-    }
+    RunOperations(so, soh, operations);
   }
 }
 
+void InPlaceExecutionContext::ExecuteWithoutNeighborMutex(
+    SimObject* so, SoHandle soh, const std::vector<Operation>& operations) {
+  RunOperations(so, soh, operations);
+}
+
+void InPlaceExecutionContext::RunOperations(
+    SimObject* so, SoHandle soh, const std::vector<Operation>& operations) {
+  neighbor_cache_.clear();
+  current_so_ = so;
+  current_soh_ = &soh;
+  for (auto& op : operations) {
+    op(so);
+  }
+  current_so_ = nullptr;
+  // simulation objects that have been created in this iteration are not yet
+  // stored in the ResourceManager
+  if (soh != SoHandle()) {
+    Simulation::GetActive()->GetResourceManager()->UpdateSoAStore(so, soh);
+  }
+}
+
+SoHandle InPlaceExecutionContext::GetSoHandle(const SimObject& query) const {
+  return &query == current_so_ ? *current_soh_ : SoHandle();
+}
+
 void InPlaceExecutionContext::push_back(SimObject* new_so) {  // NOLINT
   new_sim_objects_[new_so->GetUid()] = new_so;
 }
@@ -104,77 +136,56 @@ void InPlaceExecutionContext::push_back(SimObject* new_so) {  // NOLINT
 void InPlaceExecutionContext::ForEachNeighbor(
     const std::function<void(const SimObject*)>& lambda,
     const SimObject& query) {
-  // use values in cache
-  if (neighbor_cache_.size() != 0) {
-    for (auto& pair : neighbor_cache_) {
-      lambda(pair.first);
-    }
-    return;
-  }
-
-  auto* grid = Simulation::GetActive()->GetGrid();
-  grid->ForEachNeighbor(lambda, query);
+  ForEachNeighbor<std::function<void(const SimObject*)>>(lambda, query);
 }
 
 void InPlaceExecutionContext::ForEachNeighbor(
     const std::function<void(const SimObject*, double)>& lambda,
     const SimObject& query) {
-  // use values in cache
-  if (neighbor_cache_.size() != 0) {
-    for (auto& pair : neighbor_cache_) {
-      lambda(pair.first, pair.second);
-    }
-    return;
-  }
-
-  // forward call to grid and populate cache
-  auto* grid = Simulation::GetActive()->GetGrid();
-  auto* param = Simulation::GetActive()->GetParam();
-  auto for_each = [&, this](const SimObject* so, double squared_distance) {
-    if (param->cache_neighbors_) {
-      this->neighbor_cache_.push_back(make_pair(so, squared_distance));
-    }
-    lambda(so, squared_distance);
-  };
-  grid->ForEachNeighbor(for_each, query);
+  ForEachNeighbor<std::function<void(const SimObject*, double)>>(lambda,
+                                                                  query);
 }
 
 void InPlaceExecutionContext::ForEachNeighborWithinRadius(
     const std::function<void(const SimObject*)>& lambda, const SimObject& query,
     double squared_radius) {
-  // use values in cache
-  if (neighbor_cache_.size() != 0) {
-    for (auto& pair : neighbor_cache_) {
-      if (pair.second < squared_radius) {
-        lambda(pair.first);
-      }
-    }
-    return;
-  }
+  ForEachNeighborWithinRadius<std::function<void(const SimObject*)>>(
+      lambda, query, squared_radius);
+}
 
-  // forward call to grid and populate cache
-  auto* grid = Simulation::GetActive()->GetGrid();
-  auto* param = Simulation::GetActive()->GetParam();
-  auto for_each = [&, this](const SimObject* so, double squared_distance) {
-    if (param->cache_neighbors_) {
-      this->neighbor_cache_.push_back(make_pair(so, squared_distance));
-    }
-    if (squared_distance < squared_radius) {
-      lambda(so);
-    }
-  };
-  grid->ForEachNeighbor(for_each, query);
+std::vector<const SimObject*> InPlaceExecutionContext::GetKNearestNeighbors(
+    const SimObject& query, uint64_t k) {
+  auto* spatial_index = Simulation::GetActive()->GetSpatialIndex();
+  return spatial_index->GetKNearestNeighbors(query, k);
 }
 
 SimObject* InPlaceExecutionContext::GetSimObject(SoUid uid) {
-  auto* so = GetCachedSimObject(uid);
+  // Most simulation objects are stored in the ResourceManager. A lookup
+  // there is a single array access. Hence, try it before the hash map of
+  // new simulation objects.
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  auto soh = rm->GetSoHandle(uid);
+  if (soh != SoHandle()) {
+    // the caller might modify it (e.g. through `SoPointer`)
+    if (rm->MarkSoAEntryOutdated(soh)) {
+      modified_.push_back(soh);
+    }
+    return rm->GetSimObjectWithSoHandle(soh);
+  }
+  return GetNewSimObject(uid);
+}
+
+const SimObject* InPlaceExecutionContext::GetConstSimObject(SoUid uid) {
+  auto* so = Simulation::GetActive()->GetResourceManager()->GetSimObject(uid);
   if (so != nullptr) {
     return so;
   }
+  return GetNewSimObject(uid);
+}
 
+SimObject* InPlaceExecutionContext::GetNewSimObject(SoUid uid) {
   auto* sim = Simulation::GetActive();
-  auto* rm = sim->GetResourceManager();
-  so = rm->GetSimObject(uid);
+  auto* so = GetCachedSimObject(uid);
   if (so != nullptr) {
     return so;
   }
@@ -189,16 +200,12 @@ SimObject* InPlaceExecutionContext::GetSimObject(SoUid uid) {
   return nullptr;
 }
 
-const SimObject* InPlaceExecutionContext::GetConstSimObject(SoUid uid) {
-  return GetSimObject(uid);
-}
-
 void InPlaceExecutionContext::RemoveFromSimulation(SoUid uid) {
   remove_.push_back(uid);
 }
 
 void InPlaceExecutionContext::DisableNeighborGuard() {
-  Simulation::GetActive()->GetGrid()->DisableNeighborMutexes();
+  Simulation::GetActive()->GetSpatialIndex()->DisableNeighborMutexes();
 }
 
 SimObject* InPlaceExecutionContext::GetCachedSimObject(SoUid uid) {
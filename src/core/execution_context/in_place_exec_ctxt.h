@@ -27,6 +27,8 @@
 namespace bdm {
 
 class SimObject;
+class Simulation;
+class SoHandle;
 
 /// This execution context updates simulation objects in place. \n
 /// Let's assume we have two sim objects `A, B` in our simulation that we want
@@ -64,9 +66,24 @@ class InPlaceExecutionContext {
       const std::vector<InPlaceExecutionContext*>& all_exec_ctxts) const;
 
   /// Execute a series of operations on a simulation object in the order given
-  /// in the argument
+  /// in the argument. Afterwards, the attributes of `so` are copied into the
+  /// structure of arrays of the ResourceManager (see
+  /// `ResourceManager::UpdateSoAStore`) while the neighbor mutex is still
+  /// held.
   void Execute(SimObject* so, const std::vector<Operation>& operations);
 
+  /// Same as `Execute(so, operations)`, but avoids the lookup of the
+  /// SoHandle. `soh` must be the SoHandle of `so`.
+  void Execute(SimObject* so, SoHandle soh,
+               const std::vector<Operation>& operations);
+
+  /// Same as `Execute(so, soh, operations)`, but without acquiring the
+  /// neighbor mutex. The caller must guarantee that no other thread accesses
+  /// the neighborhood of `so` at the same time
+  /// (see `Grid::ApplyOnAllElementsColored`).
+  void ExecuteWithoutNeighborMutex(SimObject* so, SoHandle soh,
+                                   const std::vector<Operation>& operations);
+
   void push_back(SimObject* new_so);  // NOLINT
 
   void ForEachNeighbor(const std::function<void(const SimObject*)>& lambda,
@@ -76,11 +93,136 @@ class InPlaceExecutionContext {
       const std::function<void(const SimObject*, double)>& lambda,
       const SimObject& query);
 
-  /// Forwards the call to `Grid::ForEachNeighborWithinRadius`
+  /// Forwards the call to `SpatialIndex::ForEachNeighborWithinRadius`.\n
+  /// NB: If `squared_radius` exceeds the squared neighbor search radius (see
+  /// `SpatialIndex::GetNeighborSearchRadius`), `lambda` also receives
+  /// simulation objects outside the neighborhood protected by the neighbor
+  /// mutex. Other threads might update them concurrently. `lambda` must
+  /// therefore neither modify them nor read attributes that change during
+  /// an iteration (e.g. the position).
   void ForEachNeighborWithinRadius(
       const std::function<void(const SimObject*)>& lambda,
       const SimObject& query, double squared_radius);
 
+  /// Forwards the call to `SpatialIndex::GetKNearestNeighbors`.\n
+  /// NB: The same restrictions as for large radii in
+  /// `ForEachNeighborWithinRadius` apply to the returned simulation objects.
+  std::vector<const SimObject*> GetKNearestNeighbors(const SimObject& query,
+                                                     uint64_t k);
+
+  // The following template versions avoid the overhead of `std::function` and
+  // enable the compiler to inline `lambda` along the whole call chain, if the
+  // uniform grid is used as spatial index (see `Param::spatial_index_`).
+  // `TSimulation` defers the lookup of `Simulation` and `Grid` until
+  // instantiation. Therefore, translation units that call these functions
+  // must include `core/grid.h`.
+
+  /// Template version of `ForEachNeighbor` for lambdas with signature
+  /// `void(const SimObject*)`
+  template <typename TLambda, typename TSimulation = Simulation>
+  auto ForEachNeighbor(const TLambda& lambda, const SimObject& query)
+      -> decltype(lambda(std::declval<const SimObject*>()), void()) {
+    // use values in cache
+    if (neighbor_cache_.size() != 0) {
+      for (auto& pair : neighbor_cache_) {
+        lambda(pair.first);
+      }
+      return;
+    }
+
+    auto* sim = TSimulation::GetActive();
+    auto* grid = sim->GetGrid();
+    auto* spatial_index = sim->GetSpatialIndex();
+    if (spatial_index == grid) {
+      grid->ForEachNeighbor(lambda, query, GetSoHandle(query));
+    } else {
+      spatial_index->ForEachNeighbor(
+          std::function<void(const SimObject*)>(lambda), query);
+    }
+  }
+
+  /// Template version of `ForEachNeighbor` for lambdas with signature
+  /// `void(const SimObject*, double squared_distance)`
+  template <typename TLambda, typename TSimulation = Simulation>
+  auto ForEachNeighbor(const TLambda& lambda, const SimObject& query)
+      -> decltype(lambda(std::declval<const SimObject*>(), 0.0), void()) {
+    // use values in cache
+    if (neighbor_cache_.size() != 0) {
+      for (auto& pair : neighbor_cache_) {
+        lambda(pair.first, pair.second);
+      }
+      return;
+    }
+
+    // forward call to grid and populate cache
+    auto* sim = TSimulation::GetActive();
+    bool cache_neighbors = sim->GetParam()->cache_neighbors_;
+    auto for_each = [&, this](const SimObject* so, double squared_distance) {
+      if (cache_neighbors) {
+        this->neighbor_cache_.push_back(std::make_pair(so, squared_distance));
+      }
+      lambda(so, squared_distance);
+    };
+    auto* grid = sim->GetGrid();
+    auto* spatial_index = sim->GetSpatialIndex();
+    if (spatial_index == grid) {
+      grid->ForEachNeighbor(for_each, query, GetSoHandle(query));
+    } else {
+      spatial_index->ForEachNeighbor(
+          std::function<void(const SimObject*, double)>(for_each), query);
+    }
+  }
+
+  /// Template version of `ForEachNeighborWithinRadius`
+  template <typename TLambda, typename TSimulation = Simulation>
+  void ForEachNeighborWithinRadius(const TLambda& lambda,
+                                   const SimObject& query,
+                                   double squared_radius) {
+    auto* sim = TSimulation::GetActive();
+    auto* grid = sim->GetGrid();
+    auto* spatial_index = sim->GetSpatialIndex();
+    auto search_radius = spatial_index->GetNeighborSearchRadius();
+    if (squared_radius > search_radius * search_radius) {
+      // Neither the cache nor `ForEachNeighbor` contain all simulation
+      // objects within this radius
+      if (spatial_index == grid) {
+        grid->ForEachNeighborWithinRadius(lambda, query, squared_radius);
+      } else {
+        spatial_index->ForEachNeighborWithinRadius(
+            std::function<void(const SimObject*)>(lambda), query,
+            squared_radius);
+      }
+      return;
+    }
+
+    // use values in cache
+    if (neighbor_cache_.size() != 0) {
+      for (auto& pair : neighbor_cache_) {
+        if (pair.second < squared_radius) {
+          lambda(pair.first);
+        }
+      }
+      return;
+    }
+
+    // forward call to grid and populate cache
+    bool cache_neighbors = sim->GetParam()->cache_neighbors_;
+    auto for_each = [&, this](const SimObject* so, double squared_distance) {
+      if (cache_neighbors) {
+        this->neighbor_cache_.push_back(std::make_pair(so, squared_distance));
+      }
+      if (squared_distance < squared_radius) {
+        lambda(so);
+      }
+    };
+    if (spatial_index == grid) {
+      grid->ForEachNeighbor(for_each, query, GetSoHandle(query));
+    } else {
+      spatial_index->ForEachNeighbor(
+          std::function<void(const SimObject*, double)>(for_each), query);
+    }
+  }
+
   SimObject* GetSimObject(SoUid uid);
 
   const SimObject* GetConstSimObject(SoUid uid);
@@ -108,7 +250,30 @@ class InPlaceExecutionContext {
 
   std::vector<std::pair<const SimObject*, double>> neighbor_cache_;
 
+  /// SoHandles of simulation objects that have been returned by
+  /// `GetSimObject` during this iteration. Their entries in the structure of
+  /// arrays might be outdated (see `ResourceManager::MarkSoAEntryOutdated`).
+  std::vector<SoHandle> modified_;
+
+  /// Simulation object that is currently updated by `RunOperations` and its
+  /// SoHandle. Saves the lookup of the SoHandle in neighbor queries.
+  const SimObject* current_so_ = nullptr;
+  const SoHandle* current_soh_ = nullptr;
+
   SimObject* GetCachedSimObject(SoUid uid);
+
+  /// Returns the SoHandle of `query` if it is the simulation object that is
+  /// currently updated, or an invalid SoHandle otherwise.
+  SoHandle GetSoHandle(const SimObject& query) const;
+
+  /// Executes `operations` on `so` and copies its attributes into the
+  /// structure of arrays if `soh` is valid
+  void RunOperations(SimObject* so, SoHandle soh,
+                     const std::vector<Operation>& operations);
+
+  /// Returns the simulation object with the given uid if it has been created
+  /// during this iteration and is not yet stored in the ResourceManager.
+  SimObject* GetNewSimObject(SoUid uid);
 };
 
 }  // namespace bdm
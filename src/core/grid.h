@@ -22,18 +22,14 @@
 #include <array>
 #include <atomic>
 #include <cmath>
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <memory>
 #include <mutex>
-#ifdef LINUX
-#include <parallel/algorithm>
-#endif  // LINUX
 #include <utility>
 #include <vector>
 
-#include <morton/morton.h>
-
 #include "core/container/fixed_size_vector.h"
 #include "core/container/inline_vector.h"
 #include "core/container/math_array.h"
@@ -41,6 +37,7 @@
 #include "core/container/sim_object_vector.h"
 #include "core/param/param.h"
 #include "core/resource_manager.h"
+#include "core/spatial_index.h"
 #include "core/util/log.h"
 
 namespace bdm {
@@ -89,7 +86,7 @@ class CircularBuffer {
 };
 
 /// A class that represents Cartesian 3D grid
-class Grid {
+class Grid : public SpatialIndex {
  public:
   /// A single unit cube of the grid
   struct Box {
@@ -131,14 +128,25 @@ class Grid {
       Iterator(Grid* grid, const Box* box)
           : grid_(grid),
             current_value_(box->start_),
-            countdown_(box->length_) {}
+            countdown_(box->length_) {
+        if (grid_->compact_layout_) {
+          compact_idx_ = grid_->compact_box_start_[box - grid_->boxes_.data()];
+          if (countdown_ > 0) {
+            current_value_ = grid_->compact_handles_[compact_idx_];
+          }
+        }
+      }
 
       bool IsAtEnd() { return countdown_ <= 0; }
 
       Iterator& operator++() {
         countdown_--;
         if (countdown_ > 0) {
-          current_value_ = grid_->successors_[current_value_];
+          if (grid_->compact_layout_) {
+            current_value_ = grid_->compact_handles_[++compact_idx_];
+          } else {
+            current_value_ = grid_->successors_[current_value_];
+          }
         }
         return *this;
       }
@@ -151,6 +159,9 @@ class Grid {
       SoHandle current_value_;
       /// The remain number of simulation objects to consider
       int countdown_ = 0;
+      /// Position of `current_value_` in `Grid::compact_handles_`.
+      /// Only used if the grid has a compact layout.
+      uint64_t compact_idx_ = 0;
     };
 
     Iterator begin() const {  // NOLINT
@@ -161,7 +172,7 @@ class Grid {
   /// An iterator that iterates over the boxes in this grid
   struct NeighborIterator {
     explicit NeighborIterator(
-        const FixedSizeVector<const Box*, 27>& neighbor_boxes)
+        const InlineVector<const Box*, 27>& neighbor_boxes)
         : neighbor_boxes_(neighbor_boxes),
           // start iterator from box 0
           box_iterator_(neighbor_boxes_[0]->begin()) {
@@ -186,13 +197,13 @@ class Grid {
     }
 
    private:
-    /// The 27 neighbor boxes that will be searched for simulation objects
-    const FixedSizeVector<const Box*, 27>& neighbor_boxes_;
+    /// The neighbor boxes that will be searched for simulation objects
+    const InlineVector<const Box*, 27>& neighbor_boxes_;
     /// The box that shall be considered to iterate over for finding simulation
     /// objects
     typename Box::Iterator box_iterator_;
-    /// The id of the box to be considered (i.e. value between 0 - 26)
-    uint16_t box_idx_ = 0;
+    /// The id of the box to be considered (i.e. index in `neighbor_boxes_`)
+    uint32_t box_idx_ = 0;
     /// Flag to indicate that all the neighbor boxes have been searched through
     bool is_end_ = false;
 
@@ -215,13 +226,14 @@ class Grid {
     }
   };
 
-  /// Enum that determines the degree of adjacency in search neighbor boxes
-  //  todo(ahmad): currently only kHigh is supported (hardcoded 26 several
-  //  places)
+  /// Enum that determines the degree of adjacency in search neighbor boxes.
+  /// The given number of boxes applies if the box length is equal to the
+  /// search radius. For smaller boxes the same rule is applied to each layer
+  /// of boxes around the query box.
   enum Adjacency {
-    kLow,    /**< The closest 8  neighboring boxes */
-    kMedium, /**< The closest 18  neighboring boxes */
-    kHigh    /**< The closest 26  neighboring boxes */
+    kLow,    /**< The closest 6 neighboring boxes (shared face) */
+    kMedium, /**< The closest 18 neighboring boxes (shared face or edge) */
+    kHigh    /**< The closest 26 neighboring boxes */
   };
 
   Grid() {}
@@ -233,6 +245,7 @@ class Grid {
   /// @param[in]  adjacency    The adjacency (see #Adjacency)
   void Initialize(Adjacency adjacency = kHigh) {
     adjacency_ = adjacency;
+    verlet_valid_ = false;
 
     UpdateGrid();
     initialized_ = true;
@@ -240,6 +253,8 @@ class Grid {
 
   virtual ~Grid() {}
 
+  void Update() override { UpdateGrid(); }
+
   /// Clears the grid
   void ClearGrid() {
     boxes_.clear();
@@ -251,7 +266,9 @@ class Grid {
     grid_dimensions_ = {inf, -inf, inf, -inf, inf, -inf};
     threshold_dimensions_ = {inf, -inf};
     successors_.clear();
+    linked_box_idx_.clear();
     has_grown_ = false;
+    verlet_valid_ = false;
   }
 
   /// Updates the grid, as simulation objects may have moved, added or deleted
@@ -259,6 +276,23 @@ class Grid {
     auto* rm = Simulation::GetActive()->GetResourceManager();
 
     if (rm->GetNumSimObjects() != 0) {
+      auto* param = Simulation::GetActive()->GetParam();
+      rm->UpdateSoAStore();
+      UpdatePositionSnapshot();
+      if (param->verlet_lists_ && VerletListsAreValid()) {
+        // Simulation objects did not move far enough to invalidate the
+        // neighbor lists. Grid and lists are kept as they are.
+        has_grown_ = false;
+        return;
+      }
+      if (param->incremental_grid_update_ && !param->compact_grid_layout_ &&
+          boxes_.size() != 0 && UpdateGridIncrementally()) {
+        if (param->verlet_lists_) {
+          BuildVerletLists();
+        }
+        return;
+      }
+
       ClearGrid();
 
       auto inf = Math::kInfinity;
@@ -266,11 +300,11 @@ class Grid {
       CalculateGridDimensions(&tmp_dim);
       RoundOffGridDimensions(tmp_dim);
 
-      auto los = ceil(largest_object_size_);
-      assert(los > 0 &&
+      assert(largest_object_size_ > 0 &&
              "The largest object size was found to be 0. Please check if your "
              "cells are correctly initialized.");
-      box_length_ = los;
+      box_length_ = CalculateBoxLength();
+      stencil_radius_ = CalculateStencilRadius(GetSearchRadius());
 
       for (int i = 0; i < 3; i++) {
         int dimension_length =
@@ -289,9 +323,10 @@ class Grid {
       }
 
       // Pad the grid to avoid out of bounds check when search neighbors
+      int32_t padding = stencil_radius_ * box_length_;
       for (int i = 0; i < 3; i++) {
-        grid_dimensions_[2 * i] -= box_length_;
-        grid_dimensions_[2 * i + 1] += box_length_;
+        grid_dimensions_[2 * i] -= padding;
+        grid_dimensions_[2 * i + 1] += padding;
       }
 
       // Calculate how many boxes fit along each dimension
@@ -311,19 +346,35 @@ class Grid {
       if (boxes_.size() != total_num_boxes) {
         boxes_.resize(total_num_boxes, Box());
       }
+      UpdateStencil();
 
-      successors_.reserve();
+      compact_layout_ = param->compact_grid_layout_;
+      if (compact_layout_) {
+        BuildCompactLayout();
+      } else {
+        bool incremental = param->incremental_grid_update_;
+        if (incremental) {
+          // The linked lists must survive a later growth of the containers.
+          // Therefore, elements must be initialized.
+          successors_.resize();
+          linked_box_idx_.resize();
+        } else {
+          successors_.reserve();
+        }
 
-      // Assign simulation objects to boxes
-      rm->ApplyOnAllElementsParallelDynamic(
-          1000, [this](SimObject* sim_object, SoHandle soh) {
-            const auto& position = sim_object->GetPosition();
-            auto idx = this->GetBoxIndex(position);
-            auto box = this->GetBoxPointer(idx);
-            box->AddObject(soh, &successors_);
-            sim_object->SetBoxIdx(idx);
-          });
-      auto* param = Simulation::GetActive()->GetParam();
+        // Assign simulation objects to boxes
+        rm->ApplyOnAllElementsParallelDynamic(
+            1000, [&, this](SimObject* sim_object, SoHandle soh) {
+              auto idx = this->GetBoxIndex(rm->GetSoAPosition(soh));
+              auto box = this->GetBoxPointer(idx);
+              box->AddObject(soh, &successors_);
+              sim_object->SetBoxIdx(idx);
+              rm->SetSoABoxIdx(soh, idx);
+              if (incremental) {
+                linked_box_idx_[soh] = idx;
+              }
+            });
+      }
       if (param->bound_space_) {
         int min = param->min_bound_;
         int max = param->max_bound_;
@@ -333,9 +384,13 @@ class Grid {
       if (nb_mutex_builder_ != nullptr) {
         nb_mutex_builder_->Update();
       }
+      if (param->verlet_lists_) {
+        BuildVerletLists();
+      }
     } else {
       // There are no sim objects in this simulation
       auto* param = Simulation::GetActive()->GetParam();
+      verlet_valid_ = false;
 
       bool uninitialized = boxes_.size() == 0;
       if (uninitialized && param->bound_space_) {
@@ -400,40 +455,65 @@ class Grid {
     return distance < squared_radius;
   }
 
+  /// Computes the indices of all boxes in Z-order / morton order. The result
+  /// only depends on the number of boxes along each axis and is therefore
+  /// reused until the grid dimensions change.
   void UpdateBoxZOrder() {
-    // iterate boxes in Z-order / morton order
-    // TODO(lukas) this is a very quick attempt to test an idea
-    // improve performance of this brute force solution
-    zorder_sorted_boxes_.resize(boxes_.size());
-#pragma omp parallel for collapse(3)
-    for (uint32_t x = 0; x < num_boxes_axis_[0]; x++) {
-      for (uint32_t y = 0; y < num_boxes_axis_[1]; y++) {
-        for (uint32_t z = 0; z < num_boxes_axis_[2]; z++) {
-          auto box_idx = GetBoxIndex(std::array<uint32_t, 3>{x, y, z});
-          auto morton = libmorton::morton3D_64_encode(x, y, z);
-          zorder_sorted_boxes_[box_idx] =
-              std::pair<uint32_t, const Box*>{morton, &boxes_[box_idx]};
-        }
-      }
+    if (zorder_num_boxes_axis_ == num_boxes_axis_ &&
+        zorder_box_indices_.size() == boxes_.size()) {
+      return;
+    }
+    zorder_num_boxes_axis_ = num_boxes_axis_;
+    zorder_box_indices_.clear();
+    zorder_box_indices_.reserve(boxes_.size());
+    uint32_t max_num_boxes = *std::max_element(num_boxes_axis_.begin(),
+                                               num_boxes_axis_.end());
+    uint32_t length = 1;
+    while (length < max_num_boxes) {
+      length <<= 1;
+    }
+    AppendBoxesInZOrder({0, 0, 0}, length);
+  }
+
+  /// Appends the indices of all boxes inside the cube with the given origin
+  /// and edge length (a power of two) to `zorder_box_indices_`. The octants
+  /// are visited in the same order as their morton codes (x is the least
+  /// significant dimension). Octants outside the grid are skipped.
+  void AppendBoxesInZOrder(const std::array<uint32_t, 3>& origin,
+                           uint32_t length) {
+    if (origin[0] >= num_boxes_axis_[0] || origin[1] >= num_boxes_axis_[1] ||
+        origin[2] >= num_boxes_axis_[2]) {
+      return;
+    }
+    if (length == 1) {
+      zorder_box_indices_.push_back(GetBoxIndex(origin));
+      return;
+    }
+    uint32_t half = length / 2;
+    for (uint32_t octant = 0; octant < 8; octant++) {
+      AppendBoxesInZOrder({origin[0] + (octant & 1) * half,
+                           origin[1] + ((octant >> 1) & 1) * half,
+                           origin[2] + ((octant >> 2) & 1) * half},
+                          half);
     }
-#ifdef LINUX
-    __gnu_parallel::sort(
-        zorder_sorted_boxes_.begin(), zorder_sorted_boxes_.end(),
-        [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
-#else
-    std::sort(
-        zorder_sorted_boxes_.begin(), zorder_sorted_boxes_.end(),
-        [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
-#endif  // LINUX
   }
 
   /// This method iterates over all elements. Iteration is performed in
   /// Z-order of boxes. There is no particular order for elements inside a box.
+  void IterateZOrder(
+      const std::function<void(const SoHandle&)>& lambda) override {
+    IterateZOrder<std::function<void(const SoHandle&)>>(lambda);
+  }
+
   template <typename Lambda>
   void IterateZOrder(const Lambda& lambda) {
     UpdateBoxZOrder();
-    for (uint64_t i = 0; i < zorder_sorted_boxes_.size(); i++) {
-      auto it = zorder_sorted_boxes_[i].second->begin();
+    for (auto box_idx : zorder_box_indices_) {
+      const auto& box = boxes_[box_idx];
+      if (box.IsEmpty()) {
+        continue;
+      }
+      auto it = box.begin();
       while (!it.IsAtEnd()) {
         lambda(*it);
         ++it;
@@ -441,15 +521,72 @@ class Grid {
     }
   }
 
+  /// Applies `function` to all simulation objects in parallel. In contrast
+  /// to `ResourceManager::ApplyOnAllElementsParallel`, two simulation objects
+  /// are never processed at the same time if one of them is within the
+  /// stencil radius of the other. Therefore, `function` may modify the
+  /// neighbors of the given simulation object without locks.\n
+  /// The boxes are grouped into super-boxes of `2 * stencil_radius_` boxes
+  /// along each axis. Super-boxes are colored like a 3D checkerboard with
+  /// eight colors. Super-boxes of the same color are separated by at least
+  /// `2 * stencil_radius_` boxes and are processed in parallel. The
+  /// simulation objects inside one super-box are processed by one thread.
+  /// Colors are processed one after the other.
+  template <typename TFunction>
+  void ApplyOnAllElementsColored(const TFunction& function) {
+    auto* rm = Simulation::GetActive()->GetResourceManager();
+    ForEachBoxColored([&](uint64_t box_idx) {
+      const auto& box = boxes_[box_idx];
+      if (box.IsEmpty()) {
+        return;
+      }
+      auto it = box.begin();
+      while (!it.IsAtEnd()) {
+        auto soh = *it;
+        function(rm->GetSimObjectWithSoHandle(soh), soh);
+        ++it;
+      }
+    });
+  }
+
   /// @brief      Applies the given lambda to each neighbor
   ///
   /// @param[in]  lambda  The operation as a lambda
   /// @param      query   The query object
   void ForEachNeighbor(const std::function<void(const SimObject*)>& lambda,
-                       const SimObject& query) const {
+                       const SimObject& query) override {
+    ForEachNeighbor<std::function<void(const SimObject*)>>(lambda, query);
+  }
+
+  /// @brief      Applies the given lambda to each neighbor
+  ///
+  /// Template version of the function above. Avoids the overhead of
+  /// `std::function` and enables the compiler to inline `lambda`.
+  ///
+  /// @param[in]  lambda  The operation as a lambda with signature
+  ///             `void(const SimObject*)`
+  /// @param      query   The query object
+  /// @param      query_soh  The SoHandle of `query`, if known to the caller
+  template <typename TLambda>
+  auto ForEachNeighbor(const TLambda& lambda, const SimObject& query,
+                       SoHandle query_soh = SoHandle()) const
+      -> decltype(lambda(std::declval<const SimObject*>()), void()) {
+    if (verlet_valid_ && ForEachVerletNeighbor(query, query_soh, lambda)) {
+      return;
+    }
+
     auto idx = query.GetBoxIdx();
 
-    FixedSizeVector<const Box*, 27> neighbor_boxes;
+    if (compact_layout_) {
+      ForEachCompactNeighbor(idx, [&](const SimObject* sim_object, SoHandle) {
+        if (sim_object != &query) {
+          lambda(sim_object);
+        }
+      });
+      return;
+    }
+
+    InlineVector<const Box*, 27> neighbor_boxes;
     GetMooreBoxes(&neighbor_boxes, idx);
 
     auto* rm = Simulation::GetActive()->GetResourceManager();
@@ -475,23 +612,63 @@ class Grid {
   ///
   void ForEachNeighbor(
       const std::function<void(const SimObject*, double)>& lambda,
-      const SimObject& query) {
+      const SimObject& query) override {
+    ForEachNeighbor<std::function<void(const SimObject*, double)>>(lambda,
+                                                                    query);
+  }
+
+  /// @brief      Applies the given lambda to each neighbor or the specified
+  ///             simulation object.
+  ///
+  /// Template version of the function above. Avoids the overhead of
+  /// `std::function` and enables the compiler to inline `lambda`.
+  ///
+  /// @param[in]  lambda  The operation as a lambda with signature
+  ///             `void(const SimObject*, double squared_distance)`
+  /// @param      query   The query object
+  /// @param      query_soh  The SoHandle of `query`, if known to the caller
+  ///
+  template <typename TLambda>
+  auto ForEachNeighbor(const TLambda& lambda, const SimObject& query,
+                       SoHandle query_soh = SoHandle())
+      -> decltype(lambda(std::declval<const SimObject*>(), 0.0), void()) {
     const auto& position = query.GetPosition();
-    auto idx = query.GetBoxIdx();
 
-    FixedSizeVector<const Box*, 27> neighbor_boxes;
-    GetMooreBoxes(&neighbor_boxes, idx);
+    if (verlet_valid_ &&
+        ForEachVerletNeighbor(
+            query, query_soh, [&](const SimObject* sim_object) {
+              lambda(sim_object, SquaredEuclideanDistance(
+                                     position, sim_object->GetPosition()));
+            })) {
+      return;
+    }
+
+    auto idx = query.GetBoxIdx();
 
     auto* rm = Simulation::GetActive()->GetResourceManager();
 
+    if (compact_layout_) {
+      ForEachCompactNeighbor(
+          idx, [&](const SimObject* sim_object, SoHandle soh) {
+            if (sim_object != &query) {
+              lambda(sim_object, SquaredEuclideanDistance(
+                                     position, rm->GetSoAPosition(soh)));
+            }
+          });
+      return;
+    }
+
+    InlineVector<const Box*, 27> neighbor_boxes;
+    GetMooreBoxes(&neighbor_boxes, idx);
+
     NeighborIterator ni(neighbor_boxes);
     while (!ni.IsAtEnd()) {
       // Do something with neighbor object
-      auto* sim_object = rm->GetSimObjectWithSoHandle(*ni);
+      auto soh = *ni;
+      auto* sim_object = rm->GetSimObjectWithSoHandle(soh);
       if (sim_object != &query) {
-        const auto& neighbor_position = sim_object->GetPosition();
         double squared_distance =
-            SquaredEuclideanDistance(position, neighbor_position);
+            SquaredEuclideanDistance(position, rm->GetSoAPosition(soh));
         lambda(sim_object, squared_distance);
       }
       ++ni;
@@ -504,29 +681,91 @@ class Grid {
   /// In simulation code do not use this function directly. Use the same
   /// function from the exeuction context (e.g. `InPlaceExecutionContext`)
   ///
+  /// If the radius exceeds `GetNeighborSearchRadius()`, distances are based
+  /// on the positions at the time of the last update (see
+  /// `GetKNearestNeighbors`).
+  ///
   /// @param[in]  lambda  The operation as a lambda
   /// @param      query   The query object
   /// @param[in]  squared_radius  The search radius squared
   ///
   void ForEachNeighborWithinRadius(
       const std::function<void(const SimObject*)>& lambda,
-      const SimObject& query, double squared_radius) {
-    const auto& position = query.GetPosition();
-    auto idx = query.GetBoxIdx();
-
-    FixedSizeVector<const Box*, 27> neighbor_boxes;
-    GetMooreBoxes(&neighbor_boxes, idx);
+      const SimObject& query, double squared_radius) override {
+    ForEachNeighborWithinRadius<std::function<void(const SimObject*)>>(
+        lambda, query, squared_radius);
+  }
 
+  /// @brief      Applies the given lambda to each neighbor or the specified
+  ///             simulation object.
+  ///
+  /// Template version of the function above. Avoids the overhead of
+  /// `std::function` and enables the compiler to inline `lambda`.
+  ///
+  /// @param[in]  lambda  The operation as a lambda with signature
+  ///             `void(const SimObject*)`
+  /// @param      query   The query object
+  /// @param[in]  squared_radius  The search radius squared
+  /// @param      query_soh  The SoHandle of `query`, if known to the caller
+  ///
+  template <typename TLambda>
+  void ForEachNeighborWithinRadius(const TLambda& lambda,
+                                   const SimObject& query,
+                                   double squared_radius,
+                                   SoHandle query_soh = SoHandle()) {
     auto* rm = Simulation::GetActive()->GetResourceManager();
+    const auto& position = query.GetPosition();
+    auto idx = query.GetBoxIdx();
+    InlineVector<const Box*, 27> neighbor_boxes;
+
+    auto search_radius = GetNeighborSearchRadius();
+    bool large_radius = squared_radius > search_radius * search_radius;
+    if (large_radius) {
+      // The stencil does not cover the whole search radius. Search all boxes
+      // that can contain simulation objects within this radius instead.
+      // These boxes are not protected by the neighbor mutex of `query`.
+      // Therefore, positions are taken from the snapshot.
+      double radius = std::sqrt(squared_radius);
+      if (verlet_valid_) {
+        // boxes have not been updated since the Verlet lists were built
+        radius += verlet_skin_;
+      }
+      GetMooreBoxes(&neighbor_boxes, idx, radius);
+    } else if (verlet_valid_ &&
+               ForEachVerletNeighbor(
+                   query, query_soh, [&](const SimObject* sim_object) {
+                     if (this->WithinSquaredEuclideanDistance(
+                             squared_radius, position,
+                             sim_object->GetPosition())) {
+                       lambda(sim_object);
+                     }
+                   })) {
+      return;
+    } else if (compact_layout_) {
+      ForEachCompactNeighbor(
+          idx, [&](const SimObject* sim_object, SoHandle soh) {
+            if (sim_object != &query &&
+                this->WithinSquaredEuclideanDistance(
+                    squared_radius, position, rm->GetSoAPosition(soh))) {
+              lambda(sim_object);
+            }
+          });
+      return;
+    } else {
+      GetMooreBoxes(&neighbor_boxes, idx);
+    }
 
     NeighborIterator ni(neighbor_boxes);
     while (!ni.IsAtEnd()) {
       // Do something with neighbor object
-      auto* sim_object = rm->GetSimObjectWithSoHandle(*ni);
-      if (sim_object != &query) {
-        const auto& neighbor_position = sim_object->GetPosition();
-        if (this->WithinSquaredEuclideanDistance(squared_radius, position,
-                                                 neighbor_position)) {
+      auto soh = *ni;
+      const auto& neighbor_position = large_radius
+                                          ? snapshot_positions_[soh]
+                                          : rm->GetSoAPosition(soh);
+      if (this->WithinSquaredEuclideanDistance(squared_radius, position,
+                                               neighbor_position)) {
+        auto* sim_object = rm->GetSimObjectWithSoHandle(soh);
+        if (sim_object != &query) {
           lambda(sim_object);
         }
       }
@@ -534,6 +773,148 @@ class Grid {
     }
   }
 
+  /// @brief      Applies the given lambda to each pair of simulation objects
+  ///             whose distance is smaller than the search radius.
+  ///
+  /// Each pair is visited exactly once: for every box, only pairs inside this
+  /// box and pairs with the boxes of its half shell (see `half_stencil_`) are
+  /// considered. This allows callers to exploit symmetric interactions
+  /// (e.g. Newton's third law).
+  /// Boxes are processed in the order of `ApplyOnAllElementsColored`. The
+  /// half shell of a box lies within its stencil. Hence, two pairs that
+  /// share a simulation object are never processed at the same time, and
+  /// `lambda` may modify data of both simulation objects without
+  /// synchronization (e.g. accumulate forces indexed by SoHandle). For a
+  /// given grid, the pairs of each simulation object are visited in the same
+  /// order, independent of the number of threads.
+  ///
+  /// @param[in]  lambda  The operation as a lambda with signature
+  ///             `void(SimObject* lhs, SoHandle lhs_soh, SimObject* rhs,
+  ///             SoHandle rhs_soh)`
+  /// @param[in]  squared_radius  The search radius squared. Must not be larger
+  ///             than the squared size of the largest object.
+  ///
+  template <typename TLambda>
+  void ForEachNeighborPair(const TLambda& lambda, double squared_radius) {
+    auto* rm = Simulation::GetActive()->GetResourceManager();
+
+    ForEachBoxColored([&](uint64_t box_idx) {
+      const auto* box = GetBoxPointer(box_idx);
+      if (box->IsEmpty()) {
+        return;
+      }
+      for (auto it = box->begin(); !it.IsAtEnd(); ++it) {
+        auto lhs_soh = *it;
+        auto* lhs = rm->GetSimObjectWithSoHandle(lhs_soh);
+        const auto& lhs_position = rm->GetSoAPosition(lhs_soh);
+        auto process_pair = [&](SoHandle rhs_soh) {
+          if (this->WithinSquaredEuclideanDistance(
+                  squared_radius, lhs_position, rm->GetSoAPosition(rhs_soh))) {
+            lambda(lhs, lhs_soh, rm->GetSimObjectWithSoHandle(rhs_soh),
+                   rhs_soh);
+          }
+        };
+
+        // remaining simulation objects in the same box
+        auto rhs_it = it;
+        for (++rhs_it; !rhs_it.IsAtEnd(); ++rhs_it) {
+          process_pair(*rhs_it);
+        }
+        // simulation objects in the half shell
+        for (auto offset : half_stencil_) {
+          const auto* neighbor_box = GetBoxPointer(box_idx + offset);
+          for (auto nb_it = neighbor_box->begin(); !nb_it.IsAtEnd(); ++nb_it) {
+            process_pair(*nb_it);
+          }
+        }
+      }
+    });
+  }
+
+  /// @brief      Returns the `k` simulation objects that are closest to the
+  ///             query object sorted by increasing distance. Simulation
+  ///             objects with the same distance are sorted by uid. Returns
+  ///             fewer simulation objects if the simulation does not contain
+  ///             enough of them.
+  ///
+  /// Searches shells of boxes around the query box until no simulation
+  /// object outside the searched boxes can be closer than the k-th closest
+  /// one found so far. This function does not modify the grid and can
+  /// therefore be called from multiple threads in parallel. Distances are
+  /// based on the positions at the time of the last update, because other
+  /// threads might modify simulation objects outside the neighborhood of
+  /// `query` concurrently.
+  ///
+  /// @param      query   The query object
+  /// @param[in]  k       The number of neighbors
+  ///
+  std::vector<const SimObject*> GetKNearestNeighbors(
+      const SimObject& query, uint64_t k) const override {
+    std::vector<const SimObject*> neighbors;
+    if (k == 0 || boxes_.size() == 0) {
+      return neighbors;
+    }
+    auto* rm = Simulation::GetActive()->GetResourceManager();
+    const auto& position = query.GetPosition();
+    auto center = GetBoxCoordinates(query.GetBoxIdx());
+    // boxes have not been updated since the Verlet lists were built
+    double slack = verlet_valid_ ? verlet_skin_ : 0;
+
+    int64_t max_shell = 0;
+    for (int i = 0; i < 3; i++) {
+      int64_t lower = center[i];
+      int64_t upper = static_cast<int64_t>(num_boxes_axis_[i]) - 1 - lower;
+      max_shell = std::max(max_shell, std::max(lower, upper));
+    }
+
+    using Candidate = std::pair<double, const SimObject*>;
+    auto closer = [](const Candidate& lhs, const Candidate& rhs) {
+      return lhs.first < rhs.first ||
+             (lhs.first == rhs.first &&
+              lhs.second->GetUid() < rhs.second->GetUid());
+    };
+    std::vector<Candidate> candidates;
+    for (int64_t shell = 0; shell <= max_shell; shell++) {
+      ForEachBoxInShell(center, shell, [&](uint64_t box_idx) {
+        const auto* box = GetBoxPointer(box_idx);
+        for (auto it = box->begin(); !it.IsAtEnd(); ++it) {
+          auto* sim_object = rm->GetSimObjectWithSoHandle(*it);
+          if (sim_object != &query) {
+            candidates.emplace_back(
+                SquaredEuclideanDistance(position, snapshot_positions_[*it]),
+                sim_object);
+          }
+        }
+      });
+      if (candidates.size() >= k) {
+        std::nth_element(candidates.begin(), candidates.begin() + k - 1,
+                         candidates.end(), closer);
+        candidates.resize(k);
+        // all simulation objects outside the searched boxes are at least
+        // `min_distance` away from the query object
+        double min_distance = shell * box_length_ - slack;
+        if (min_distance > 0 &&
+            candidates[k - 1].first < min_distance * min_distance) {
+          break;
+        }
+      }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), closer);
+    neighbors.reserve(candidates.size());
+    for (auto& candidate : candidates) {
+      neighbors.push_back(candidate.second);
+    }
+    return neighbors;
+  }
+
+  /// Returns the radius within which `ForEachNeighbor` is guaranteed to find
+  /// all neighbors of a simulation object. `ForEachNeighborWithinRadius`
+  /// searches additional boxes for larger radii.
+  double GetNeighborSearchRadius() const override {
+    return verlet_valid_ ? verlet_radius_ : stencil_search_radius_;
+  }
+
   /// @brief      Return the box index in the one dimensional array of the box
   ///             that contains the position
   ///
@@ -541,7 +922,7 @@ class Grid {
   ///
   /// @return     The box index.
   ///
-  size_t GetBoxIndex(const Double3& position) const {
+  size_t GetBoxIndex(const Double3& position) const override {
     std::array<uint32_t, 3> box_coord;
     box_coord[0] = (floor(position[0]) - grid_dimensions_[0]) / box_length_;
     box_coord[1] = (floor(position[1]) - grid_dimensions_[2]) / box_length_;
@@ -551,21 +932,33 @@ class Grid {
   }
 
   /// Gets the size of the largest object in the grid
-  double GetLargestObjectSize() const { return largest_object_size_; }
+  double GetLargestObjectSize() const override { return largest_object_size_; }
 
-  const std::array<int32_t, 6>& GetDimensions() const {
+  const std::array<int32_t, 6>& GetDimensions() const override {
     return grid_dimensions_;
   }
 
-  const std::array<int32_t, 2>& GetDimensionThresholds() const {
+  const std::array<int32_t, 2>& GetDimensionThresholds() const override {
     return threshold_dimensions_;
   }
 
   uint64_t GetNumBoxes() const { return boxes_.size(); }
 
+  const std::array<uint32_t, 3>& GetNumBoxesAxis() const {
+    return num_boxes_axis_;
+  }
+
   uint32_t GetBoxLength() { return box_length_; }
 
-  bool HasGrown() { return has_grown_; }
+  /// Returns the number of box layers around the query box that are searched
+  /// by `ForEachNeighbor`.
+  uint32_t GetStencilRadius() const { return stencil_radius_; }
+
+  bool HasGrown() override { return has_grown_; }
+
+  /// Returns how often the Verlet neighbor lists have been built
+  /// (see `Param::verlet_lists_`).
+  uint64_t GetNumVerletListBuilds() const { return num_verlet_list_builds_; }
 
   std::array<uint32_t, 3> GetBoxCoordinates(size_t box_idx) const {
     std::array<uint32_t, 3> box_coord;
@@ -601,79 +994,55 @@ class Grid {
 
   // NeighborMutex ---------------------------------------------------------
 
-  /// This class ensures thread-safety for the InPlaceExecutionContext for the
-  /// case
-  /// that a simulation object modifies its neighbors.
-  class NeighborMutexBuilder {
+  /// Protects the neighbor boxes of a simulation object (see
+  /// `SpatialIndex::NeighborMutexBuilder`). There is one mutex for each cell
+  /// of `stencil_radius_`^3 boxes. Therefore, the 27 surrounding cells always
+  /// cover all boxes of the neighbor search.
+  class NeighborMutexBuilder : public SpatialIndex::NeighborMutexBuilder {
    public:
-    /// The NeighborMutex class is a synchronization primitive that can be
-    /// used to protect sim_objects data from being simultaneously accessed by
-    /// multiple threads.
-    class NeighborMutex {
-     public:
-      NeighborMutex(const FixedSizeVector<uint64_t, 27>& mutex_indices,
-                    NeighborMutexBuilder* mutex_builder)
-          : mutex_indices_(mutex_indices), mutex_builder_(mutex_builder) {
-        // Deadlocks occur if mutliple threads try to acquire the same locks,
-        // but in different order.
-        // -> sort to avoid deadlocks - see lock ordering
-        std::sort(mutex_indices_.begin(), mutex_indices_.end());
+    void Update() override {
+      auto* grid = Simulation::GetActive()->GetGrid();
+      auto sr = grid->stencil_radius_;
+      for (int i = 0; i < 3; i++) {
+        num_cells_axis_[i] = (grid->num_boxes_axis_[i] + sr - 1) / sr;
       }
+      mutexes_.resize(num_cells_axis_[0] * num_cells_axis_[1] *
+                      num_cells_axis_[2]);
+    }
 
-      void lock() {  // NOLINT
-        for (auto idx : mutex_indices_) {
-          auto& mutex = mutex_builder_->mutexes_[idx].mutex_;
-          // acquire lock (and spin if another thread is holding it)
-          while (mutex.test_and_set(std::memory_order_acquire)) {
+    NeighborMutex GetMutex(uint64_t box_idx) override {
+      auto* grid = Simulation::GetActive()->GetGrid();
+      auto sr = grid->stencil_radius_;
+      auto box_coord = grid->GetBoxCoordinates(box_idx);
+      uint64_t num_cells_xy = num_cells_axis_[0] * num_cells_axis_[1];
+      uint64_t center = (box_coord[2] / sr) * num_cells_xy +
+                        (box_coord[1] / sr) * num_cells_axis_[0] +
+                        box_coord[0] / sr;
+      FixedSizeVector<uint64_t, 27> mutex_indices;
+      for (int64_t z = -1; z <= 1; z++) {
+        for (int64_t y = -1; y <= 1; y++) {
+          for (int64_t x = -1; x <= 1; x++) {
+            mutex_indices.push_back(center + z * num_cells_xy +
+                                    y * num_cells_axis_[0] + x);
           }
         }
       }
-
-      void unlock() {  // NOLINT
-        for (auto idx : mutex_indices_) {
-          auto& mutex = mutex_builder_->mutexes_[idx].mutex_;
-          mutex.clear(std::memory_order_release);
-        }
-      }
-
-     private:
-      FixedSizeVector<uint64_t, 27> mutex_indices_;
-      NeighborMutexBuilder* mutex_builder_;
-    };
-
-    /// Used to store mutexes in a vector.
-    /// Always creates a new mutex (even for the copy constructor)
-    struct MutexWrapper {
-      MutexWrapper() {}
-      MutexWrapper(const MutexWrapper&) {}
-      std::atomic_flag mutex_ = ATOMIC_FLAG_INIT;
-    };
-
-    void Update() {
-      auto* grid = Simulation::GetActive()->GetGrid();
-      mutexes_.resize(grid->GetNumBoxes());
-    }
-
-    NeighborMutex GetMutex(uint64_t box_idx) {
-      auto* grid = Simulation::GetActive()->GetGrid();
-      FixedSizeVector<uint64_t, 27> box_indices;
-      grid->GetMooreBoxIndices(&box_indices, box_idx);
-      return NeighborMutex(box_indices, this);
+      return NeighborMutex(mutex_indices, this);
     }
 
    private:
-    /// one mutex for each box in `Grid::boxes_`
-    std::vector<MutexWrapper> mutexes_;
+    /// Number of mutex cells along each axis
+    std::array<uint64_t, 3> num_cells_axis_ = {{0}};
   };
 
   /// Disable neighbor mutexes management. `GetNeighborMutexBuilder()` will
   /// return a nullptr.
-  void DisableNeighborMutexes() { nb_mutex_builder_ = nullptr; }
+  void DisableNeighborMutexes() override { nb_mutex_builder_ = nullptr; }
 
   /// Returns the `NeighborMutexBuilder`. The client use it to create a
   /// `NeighborMutex`. If neighbor mutexes has been disabled by calling
   /// `DisableNeighborMutexes`, this function will return a nullptr.
-  NeighborMutexBuilder* GetNeighborMutexBuilder() {
+  NeighborMutexBuilder* GetNeighborMutexBuilder() override {
     return nb_mutex_builder_.get();
   }
 
@@ -684,6 +1053,21 @@ class Grid {
   ParallelResizeVector<Box> boxes_;
   /// Length of a Box
   uint32_t box_length_ = 1;
+  /// Number of box layers around the query box that can contain neighbors
+  /// (see `Param::grid_box_length_factor_`). Also determines the number of
+  /// padding boxes at each side of the grid.
+  uint32_t stencil_radius_ = 1;
+  /// Offsets of all box indices that are searched by `ForEachNeighbor`
+  /// relative to the query box. The first element is always the query box.
+  std::vector<int64_t> stencil_;
+  /// All simulation objects within this radius of a point inside the query
+  /// box are located in the boxes of `stencil_`.
+  double stencil_search_radius_ = 0;
+  /// Positive offsets of `stencil_` (excluding the query box). Since the
+  /// stencil is centro-symmetric, these boxes contain each neighbor pair of
+  /// two different boxes exactly once. For a stencil radius of one, these are
+  /// the boxes of `GetHalfMooreBoxIndices` without the query box.
+  std::vector<int64_t> half_stencil_;
   /// Stores the number of boxes for each axis
   std::array<uint32_t, 3> num_boxes_axis_ = {{0}};
   /// Number of boxes in the xy plane (=num_boxes_axis_[0] * num_boxes_axis_[1])
@@ -694,8 +1078,60 @@ class Grid {
   ///     SoHandle current_element = ...;
   ///     SoHandle next_element = successors_[current_element];
   SimObjectVector<SoHandle> successors_;
+  /// True if the grid has been built with a compact layout
+  /// (see `Param::compact_grid_layout_`).
+  bool compact_layout_ = false;
+  /// Compact layout: `compact_box_start_[i]` is the index of the first
+  /// element of box `i` in `compact_handles_` and `compact_sim_objects_`.
+  /// Contains one additional element at the end that stores the total number
+  /// of simulation objects.
+  ParallelResizeVector<uint64_t> compact_box_start_;
+  /// Compact layout: SoHandles of all simulation objects sorted by box index.
+  ParallelResizeVector<SoHandle> compact_handles_;
+  /// Compact layout: simulation object pointers in the same order as
+  /// `compact_handles_`. Avoids the indirection through the ResourceManager
+  /// during the neighbor search.
+  ParallelResizeVector<SimObject*> compact_sim_objects_;
+  /// Compact layout: position of each simulation object within its box.
+  SimObjectVector<uint32_t> compact_rank_;
+  /// Position of each simulation object at the time of the last update.
+  /// In contrast to `ResourceManager::GetSoAPosition`, these positions are
+  /// not modified while simulation objects are updated. Queries that visit
+  /// simulation objects outside the neighborhood protected by the
+  /// `NeighborMutex` read them to avoid data races.
+  SimObjectVector<Double3> snapshot_positions_;
+  /// Index of the box in which each SoHandle is currently linked.
+  /// Only used if `Param::incremental_grid_update_` is turned on.
+  /// This information cannot be obtained from `SimObject::GetBoxIdx`, because
+  /// the ResourceManager might have moved a simulation object to a different
+  /// SoHandle (e.g. after removing a simulation object).
+  SimObjectVector<uint32_t> linked_box_idx_;
+  /// True if the Verlet neighbor lists are up to date and used for the
+  /// neighbor search (see `Param::verlet_lists_`).
+  bool verlet_valid_ = false;
+  /// Size of the largest object at the time the Verlet lists were built
+  double verlet_radius_ = 0;
+  /// Skin distance at the time the Verlet lists were built
+  double verlet_skin_ = 0;
+  /// Position of each simulation object at the time the Verlet lists were
+  /// built. Used to determine the displacement since then.
+  SimObjectVector<Double3> verlet_positions_;
+  /// Simulation object of each SoHandle at the time the Verlet lists were
+  /// built. Detects simulation objects that have been moved to a different
+  /// SoHandle by the ResourceManager.
+  SimObjectVector<const SimObject*> verlet_sim_objects_;
+  /// Uid of each simulation object at the time the Verlet lists were built
+  SimObjectVector<SoUid> verlet_uids_;
+  /// Index of the first neighbor of each SoHandle in `verlet_neighbors_`
+  SimObjectVector<uint64_t> verlet_start_;
+  /// Number of neighbors of each SoHandle
+  SimObjectVector<uint32_t> verlet_count_;
+  /// Neighbor lists of all simulation objects (compressed sparse row layout)
+  ParallelResizeVector<const SimObject*> verlet_neighbors_;
+  /// Number of times the Verlet lists have been built
+  uint64_t num_verlet_list_builds_ = 0;
   /// Determines which boxes to search neighbors in (see enum Adjacency)
-  Adjacency adjacency_;
+  Adjacency adjacency_ = kHigh;
   /// The size of the largest object in the simulation
   double largest_object_size_ = 0;
   /// Cube which contains all simulation objects
@@ -708,14 +1144,253 @@ class Grid {
   bool has_grown_ = false;
   /// Flag to indicate if the grid has been initialized or not
   bool initialized_ = false;
-  /// stores pairs of <box morton code,  box pointer> sorted by morton code.
-  ParallelResizeVector<std::pair<uint32_t, const Box*>> zorder_sorted_boxes_;
+  /// Box indices sorted by morton code of their box coordinates.
+  std::vector<uint32_t> zorder_box_indices_;
+  /// Number of boxes along each axis when `zorder_box_indices_` was computed
+  std::array<uint32_t, 3> zorder_num_boxes_axis_ = {{0, 0, 0}};
 
   /// Holds instance of NeighborMutexBuilder if it is enabled.
   /// If `DisableNeighborMutexes` has been called this member set to nullptr.
   std::unique_ptr<NeighborMutexBuilder> nb_mutex_builder_ =
       std::make_unique<NeighborMutexBuilder>();
 
+  /// Relinks only those SoHandles whose simulation object is no longer
+  /// located in the box it has been linked to during the last update.
+  /// Handles simulation objects that moved, as well as SoHandles that have
+  /// been added or removed since the last update.
+  /// @returns false if the grid must be rebuilt from scratch, because
+  ///          simulation objects left the current grid dimensions, or the
+  ///          box length changed. In this case the grid remains unmodified.
+  bool UpdateGridIncrementally() {
+    auto* rm = Simulation::GetActive()->GetResourceManager();
+    auto* tinfo = ThreadInfo::GetInstance();
+
+    auto inf = Math::kInfinity;
+    std::array<double, 6> tmp_dim = {{inf, -inf, inf, -inf, inf, -inf}};
+    largest_object_size_ = 0;
+    CalculateGridDimensions(&tmp_dim);
+    if (CalculateBoxLength() != box_length_ ||
+        CalculateStencilRadius(GetSearchRadius()) != stencil_radius_) {
+      return false;
+    }
+    // All simulation objects must remain inside the non-padding boxes.
+    // Otherwise, the neighbor search would access boxes out of bounds.
+    int32_t padding = stencil_radius_ * box_length_;
+    for (int i = 0; i < 3; i++) {
+      if (floor(tmp_dim[2 * i]) < grid_dimensions_[2 * i] + padding ||
+          floor(tmp_dim[2 * i + 1]) >= grid_dimensions_[2 * i + 1] - padding) {
+        return false;
+      }
+    }
+    has_grown_ = false;
+    // the largest object size might have changed within the same stencil
+    // radius
+    UpdateStencil();
+
+    // Determine SoHandles that must be relinked and the boxes they must be
+    // unlinked from.
+    auto max_threads = omp_get_max_threads();
+    std::vector<std::vector<SoHandle>> relink(max_threads);
+    std::vector<std::vector<uint64_t>> dirty_boxes(max_threads);
+    rm->ApplyOnAllElementsParallelDynamic(
+        1000, [&, this](SimObject* so, SoHandle soh) {
+          auto tid = omp_get_thread_num();
+          auto idx = this->GetBoxIndex(rm->GetSoAPosition(soh));
+          so->SetBoxIdx(idx);
+          rm->SetSoABoxIdx(soh, idx);
+          if (soh.GetElementIdx() >=
+              linked_box_idx_.size(soh.GetNumaNode())) {
+            // SoHandle has been added since the last update
+            relink[tid].push_back(soh);
+          } else if (linked_box_idx_[soh] != idx) {
+            relink[tid].push_back(soh);
+            dirty_boxes[tid].push_back(linked_box_idx_[soh]);
+          }
+        });
+
+    // SoHandles that have been removed since the last update
+    for (int n = 0; n < tinfo->GetNumaNodes(); n++) {
+      auto old_size = linked_box_idx_.size(n);
+      for (uint64_t i = rm->GetNumSimObjects(n); i < old_size; i++) {
+        dirty_boxes[0].push_back(linked_box_idx_[SoHandle(n, i)]);
+      }
+    }
+
+    std::vector<uint64_t> unlink_from;
+    for (auto& boxes : dirty_boxes) {
+      unlink_from.insert(unlink_from.end(), boxes.begin(), boxes.end());
+    }
+    std::sort(unlink_from.begin(), unlink_from.end());
+    unlink_from.erase(std::unique(unlink_from.begin(), unlink_from.end()),
+                      unlink_from.end());
+
+    // Each box is only modified by one thread
+#pragma omp parallel for schedule(dynamic, 64)
+    for (uint64_t i = 0; i < unlink_from.size(); i++) {
+      UnlinkMovedObjects(unlink_from[i]);
+    }
+
+    successors_.resize();
+    linked_box_idx_.resize();
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int t = 0; t < max_threads; t++) {
+      for (auto& soh : relink[t]) {
+        auto idx = rm->GetSoABoxIdx(soh);
+        GetBoxPointer(idx)->AddObject(soh, &successors_);
+        linked_box_idx_[soh] = idx;
+      }
+    }
+    return true;
+  }
+
+  /// Removes all SoHandles from the given box whose simulation object does
+  /// not belong to this box anymore, or that are not valid anymore.
+  /// SoHandles that remain in the box keep their order.
+  void UnlinkMovedObjects(uint64_t box_idx) {
+    auto* rm = Simulation::GetActive()->GetResourceManager();
+    auto* box = GetBoxPointer(box_idx);
+    SoHandle start;
+    SoHandle last;
+    uint64_t length = 0;
+    for (auto it = box->begin(); !it.IsAtEnd(); ++it) {
+      auto soh = *it;
+      if (soh.GetElementIdx() >= rm->GetNumSimObjects(soh.GetNumaNode()) ||
+          rm->GetSoABoxIdx(soh) != box_idx) {
+        continue;
+      }
+      if (length == 0) {
+        start = soh;
+      } else {
+        successors_[last] = soh;
+      }
+      last = soh;
+      length++;
+    }
+    box->start_ = start;
+    box->length_ = length;
+  }
+
+  /// Assigns all simulation objects to boxes using a parallel counting sort.
+  /// 1) count the number of simulation objects per box and determine the
+  ///    position of each simulation object within its box
+  /// 2) exclusive prefix sum over the box lengths
+  /// 3) scatter SoHandles into their final position
+  void BuildCompactLayout() {
+    auto* rm = Simulation::GetActive()->GetResourceManager();
+
+    compact_rank_.reserve();
+    rm->ApplyOnAllElementsParallelDynamic(
+        1000, [this, rm](SimObject* sim_object, SoHandle soh) {
+          auto idx = this->GetBoxIndex(rm->GetSoAPosition(soh));
+          sim_object->SetBoxIdx(idx);
+          rm->SetSoABoxIdx(soh, idx);
+          compact_rank_[soh] = this->GetBoxPointer(idx)->length_++;
+        });
+
+    auto num_boxes = boxes_.size();
+    compact_box_start_.resize(num_boxes + 1);
+    std::vector<uint64_t> thread_offsets(omp_get_max_threads() + 1, 0);
+#pragma omp parallel
+    {
+      uint64_t tid = omp_get_thread_num();
+      uint64_t num_threads = omp_get_num_threads();
+      uint64_t chunk = (num_boxes + num_threads - 1) / num_threads;
+      uint64_t start = std::min(num_boxes, tid * chunk);
+      uint64_t end = std::min(num_boxes, start + chunk);
+
+      uint64_t sum = 0;
+      for (uint64_t i = start; i < end; i++) {
+        compact_box_start_[i] = sum;
+        sum += boxes_[i].length_;
+      }
+      thread_offsets[tid + 1] = sum;
+#pragma omp barrier
+#pragma omp single
+      {
+        for (uint64_t t = 1; t <= num_threads; t++) {
+          thread_offsets[t] += thread_offsets[t - 1];
+        }
+        compact_box_start_[num_boxes] = thread_offsets[num_threads];
+      }
+      for (uint64_t i = start; i < end; i++) {
+        compact_box_start_[i] += thread_offsets[tid];
+      }
+    }
+
+    auto num_sos = rm->GetNumSimObjects();
+    compact_handles_.resize(num_sos);
+    compact_sim_objects_.resize(num_sos);
+    rm->ApplyOnAllElementsParallelDynamic(
+        1000, [this, rm](SimObject* sim_object, SoHandle soh) {
+          auto pos = compact_box_start_[rm->GetSoABoxIdx(soh)] +
+                     compact_rank_[soh];
+          compact_handles_[pos] = soh;
+          compact_sim_objects_[pos] = sim_object;
+        });
+  }
+
+  /// Calls `function(box_idx)` for all boxes in the order described in
+  /// `ApplyOnAllElementsColored`. The boxes of one super-box are processed by
+  /// one thread in a fixed order.
+  template <typename TFunction>
+  void ForEachBoxColored(const TFunction& function) {
+    uint32_t length = 2 * stencil_radius_;
+    std::array<uint32_t, 3> num_super_boxes;
+    for (int i = 0; i < 3; i++) {
+      num_super_boxes[i] = (num_boxes_axis_[i] + length - 1) / length;
+    }
+
+    for (uint32_t color = 0; color < 8; color++) {
+      std::array<uint32_t, 3> first = {color & 1, (color >> 1) & 1,
+                                       (color >> 2) & 1};
+      std::array<uint64_t, 3> num_colored;
+      for (int i = 0; i < 3; i++) {
+        num_colored[i] = num_super_boxes[i] > first[i]
+                             ? (num_super_boxes[i] - first[i] + 1) / 2
+                             : 0;
+      }
+      int64_t num_colored_xy = num_colored[0] * num_colored[1];
+      int64_t num_colored_total = num_colored_xy * num_colored[2];
+
+#pragma omp parallel for schedule(dynamic, 1)
+      for (int64_t i = 0; i < num_colored_total; i++) {
+        // coordinates of the super-box
+        std::array<uint64_t, 3> sb = {
+            first[0] + 2 * (i % num_colored[0]),
+            first[1] + 2 * ((i / num_colored[0]) % num_colored[1]),
+            first[2] + 2 * (i / num_colored_xy)};
+        std::array<uint32_t, 3> begin;
+        std::array<uint32_t, 3> end;
+        for (int d = 0; d < 3; d++) {
+          begin[d] = sb[d] * length;
+          end[d] = std::min(begin[d] + length, num_boxes_axis_[d]);
+        }
+        for (uint32_t z = begin[2]; z < end[2]; z++) {
+          for (uint32_t y = begin[1]; y < end[1]; y++) {
+            for (uint32_t x = begin[0]; x < end[0]; x++) {
+              function(GetBoxIndex(std::array<uint32_t, 3>{x, y, z}));
+            }
+          }
+        }
+      }
+    }
+  }
+
+  /// Compact layout: calls `lambda` for each simulation object in the Moore
+  /// boxes of `box_idx` (including the query box itself). `lambda` has the
+  /// signature `void(const SimObject*, SoHandle)`.
+  template <typename TLambda>
+  void ForEachCompactNeighbor(size_t box_idx, const TLambda& lambda) const {
+    for (auto offset : stencil_) {
+      auto idx = box_idx + offset;
+      auto end = compact_box_start_[idx + 1];
+      for (auto i = compact_box_start_[idx]; i < end; i++) {
+        lambda(compact_sim_objects_[i], compact_handles_[i]);
+      }
+    }
+  }
+
   void CheckGridGrowth() {
     // Determine if the grid dimensions have changed (changed in the sense that
     // the grid has grown outwards)
@@ -739,87 +1414,51 @@ class Grid {
 
   /// Calculates what the grid dimensions need to be in order to contain all the
   /// simulation objects
-  void CalculateGridDimensions(std::array<double, 6>* ret_grid_dimensions) {
+  /// Copies the positions of the structure of arrays into
+  /// `snapshot_positions_`.
+  void UpdatePositionSnapshot() {
     auto* rm = Simulation::GetActive()->GetResourceManager();
-
-    const auto max_threads = omp_get_max_threads();
-    // allocate version for each thread - avoid false sharing by padding them
-    // assumes 64 byte cache lines (8 * sizeof(double))
-    std::vector<std::array<double, 8>> xmin(max_threads, {{Math::kInfinity}});
-    std::vector<std::array<double, 8>> ymin(max_threads, {{Math::kInfinity}});
-    std::vector<std::array<double, 8>> zmin(max_threads, {{Math::kInfinity}});
-
-    std::vector<std::array<double, 8>> xmax(max_threads, {{-Math::kInfinity}});
-    std::vector<std::array<double, 8>> ymax(max_threads, {{-Math::kInfinity}});
-    std::vector<std::array<double, 8>> zmax(max_threads, {{-Math::kInfinity}});
-
-    std::vector<std::array<double, 8>> largest(max_threads, {{0}});
-
-    rm->ApplyOnAllElementsParallelDynamic(1000, [&](SimObject* so, SoHandle) {
-      auto tid = omp_get_thread_num();
-      const auto& position = so->GetPosition();
-      // x
-      if (position[0] < xmin[tid][0]) {
-        xmin[tid][0] = position[0];
-      }
-      if (position[0] > xmax[tid][0]) {
-        xmax[tid][0] = position[0];
-      }
-      // y
-      if (position[1] < ymin[tid][0]) {
-        ymin[tid][0] = position[1];
-      }
-      if (position[1] > ymax[tid][0]) {
-        ymax[tid][0] = position[1];
-      }
-      // z
-      if (position[2] < zmin[tid][0]) {
-        zmin[tid][0] = position[2];
+    auto* tinfo = ThreadInfo::GetInstance();
+    snapshot_positions_.resize();
+    for (int n = 0; n < tinfo->GetNumaNodes(); n++) {
+      const auto* positions = rm->GetSoAPositions(n);
+      int64_t num_sos = rm->GetNumSimObjects(n);
+#pragma omp parallel for
+      for (int64_t i = 0; i < num_sos; i++) {
+        snapshot_positions_[SoHandle(n, i)] = positions[i];
       }
-      if (position[2] > zmax[tid][0]) {
-        zmax[tid][0] = position[2];
-      }
-      // larget object
-      auto diameter = so->GetDiameter();
-      if (diameter > largest[tid][0]) {
-        largest[tid][0] = diameter;
-      }
-    });
+    }
+  }
 
-    // reduce partial results into global one
-    double& gxmin = (*ret_grid_dimensions)[0];
-    double& gxmax = (*ret_grid_dimensions)[1];
-    double& gymin = (*ret_grid_dimensions)[2];
-    double& gymax = (*ret_grid_dimensions)[3];
-    double& gzmin = (*ret_grid_dimensions)[4];
-    double& gzmax = (*ret_grid_dimensions)[5];
-    for (int tid = 0; tid < max_threads; tid++) {
-      // x
-      if (xmin[tid][0] < gxmin) {
-        gxmin = xmin[tid][0];
-      }
-      if (xmax[tid][0] > gxmax) {
-        gxmax = xmax[tid][0];
-      }
-      // y
-      if (ymin[tid][0] < gymin) {
-        gymin = ymin[tid][0];
-      }
-      if (ymax[tid][0] > gymax) {
-        gymax = ymax[tid][0];
-      }
-      // z
-      if (zmin[tid][0] < gzmin) {
-        gzmin = zmin[tid][0];
-      }
-      if (zmax[tid][0] > gzmax) {
-        gzmax = zmax[tid][0];
-      }
-      // larget object
-      if (largest[tid][0] > largest_object_size_) {
-        largest_object_size_ = largest[tid][0];
+  void CalculateGridDimensions(std::array<double, 6>* ret_grid_dimensions) {
+    auto* rm = Simulation::GetActive()->GetResourceManager();
+    auto* tinfo = ThreadInfo::GetInstance();
+
+    auto& dim = *ret_grid_dimensions;
+    double xmin = dim[0], xmax = dim[1];
+    double ymin = dim[2], ymax = dim[3];
+    double zmin = dim[4], zmax = dim[5];
+    double largest = largest_object_size_;
+    // iterate over the structure of arrays in the ResourceManager to avoid
+    // dereferencing each simulation object
+    for (int n = 0; n < tinfo->GetNumaNodes(); n++) {
+      const auto* positions = rm->GetSoAPositions(n);
+      const auto* diameters = rm->GetSoADiameters(n);
+      int64_t num_sos = rm->GetNumSimObjects(n);
+#pragma omp parallel for simd reduction(min : xmin, ymin, zmin) \
+    reduction(max : xmax, ymax, zmax, largest)
+      for (int64_t i = 0; i < num_sos; i++) {
+        xmin = std::min(xmin, positions[i][0]);
+        xmax = std::max(xmax, positions[i][0]);
+        ymin = std::min(ymin, positions[i][1]);
+        ymax = std::max(ymax, positions[i][1]);
+        zmin = std::min(zmin, positions[i][2]);
+        zmax = std::max(zmax, positions[i][2]);
+        largest = std::max(largest, diameters[i]);
       }
     }
+    dim = {xmin, xmax, ymin, ymax, zmin, zmax};
+    largest_object_size_ = largest;
   }
 
   void RoundOffGridDimensions(const std::array<double, 6>& grid_dimensions) {
@@ -837,118 +1476,348 @@ class Grid {
     grid_dimensions_[5] = ceil(grid_dimensions[5]);
   }
 
-  /// @brief      Gets the Moore (i.e adjacent) boxes of the query boxAlso adds
-  /// the
-  ///             query box.
+  /// Returns the radius around a simulation object that the box stencil must
+  /// cover. If Verlet lists are used, the grid must find all simulation
+  /// objects within the list radius (largest object size plus skin).
+  double GetSearchRadius() const {
+    auto* param = Simulation::GetActive()->GetParam();
+    if (param->verlet_lists_) {
+      return largest_object_size_ + param->verlet_skin_;
+    }
+    return largest_object_size_;
+  }
+
+  /// Returns true if the Verlet neighbor lists still contain all neighbors
+  /// within the largest object size. This is the case if
+  ///   * no simulation object has been added, removed, or moved to a
+  ///     different SoHandle,
+  ///   * no simulation object is larger than the largest object at the time
+  ///     the lists were built, and
+  ///   * no simulation object can move further than half of the skin
+  ///     distance since the lists were built, taking into account the
+  ///     maximum displacement during the next iteration.
+  bool VerletListsAreValid() {
+    if (!verlet_valid_) {
+      return false;
+    }
+    auto* sim = Simulation::GetActive();
+    auto* rm = sim->GetResourceManager();
+    auto* param = sim->GetParam();
+    auto* tinfo = ThreadInfo::GetInstance();
+
+    if (param->verlet_skin_ != verlet_skin_) {
+      return false;
+    }
+    for (int n = 0; n < tinfo->GetNumaNodes(); n++) {
+      if (verlet_uids_.size(n) != rm->GetNumSimObjects(n)) {
+        return false;
+      }
+    }
+
+    const auto max_threads = omp_get_max_threads();
+    // allocate version for each thread - avoid false sharing by padding them
+    // assumes 64 byte cache lines (8 * sizeof(double))
+    std::vector<std::array<double, 8>> displacement(max_threads, {{0}});
+    std::vector<std::array<double, 8>> largest(max_threads, {{0}});
+    std::atomic<bool> modified(false);
+    rm->ApplyOnAllElementsParallelDynamic(
+        1000, [&, this](SimObject* so, SoHandle soh) {
+          auto tid = omp_get_thread_num();
+          if (verlet_sim_objects_[soh] != so ||
+              verlet_uids_[soh] != so->GetUid()) {
+            modified = true;
+            return;
+          }
+          auto squared_displacement = this->SquaredEuclideanDistance(
+              verlet_positions_[soh], rm->GetSoAPosition(soh));
+          if (squared_displacement > displacement[tid][0]) {
+            displacement[tid][0] = squared_displacement;
+          }
+          auto diameter = rm->GetSoADiameter(soh);
+          if (diameter > largest[tid][0]) {
+            largest[tid][0] = diameter;
+          }
+        });
+    if (modified) {
+      return false;
+    }
+
+    double max_squared_displacement = 0;
+    double largest_object_size = 0;
+    for (int tid = 0; tid < max_threads; tid++) {
+      max_squared_displacement =
+          std::max(max_squared_displacement, displacement[tid][0]);
+      largest_object_size = std::max(largest_object_size, largest[tid][0]);
+    }
+    if (largest_object_size > verlet_radius_) {
+      return false;
+    }
+    double threshold = 0.5 * verlet_skin_ - param->simulation_max_displacement_;
+    return threshold > 0 && max_squared_displacement <= threshold * threshold;
+  }
+
+  /// Builds the Verlet neighbor lists (see `Param::verlet_lists_`) using the
+  /// current state of the grid.
+  /// 1) count the number of neighbors within the list radius for each
+  ///    simulation object
+  /// 2) exclusive prefix sum over the neighbor counts
+  /// 3) store the neighbors at their final position
+  void BuildVerletLists() {
+    auto* sim = Simulation::GetActive();
+    auto* rm = sim->GetResourceManager();
+    auto* param = sim->GetParam();
+    auto* tinfo = ThreadInfo::GetInstance();
+
+    // the neighbor search below must use the grid boxes
+    verlet_valid_ = false;
+    verlet_radius_ = largest_object_size_;
+    verlet_skin_ = param->verlet_skin_;
+    double list_radius = verlet_radius_ + verlet_skin_;
+    double squared_list_radius = list_radius * list_radius;
+
+    verlet_positions_.resize();
+    verlet_sim_objects_.resize();
+    verlet_uids_.resize();
+    verlet_start_.resize();
+    verlet_count_.resize();
+    rm->ApplyOnAllElementsParallelDynamic(
+        1000, [&, this](SimObject* so, SoHandle soh) {
+          verlet_positions_[soh] = so->GetPosition();
+          verlet_sim_objects_[soh] = so;
+          verlet_uids_[soh] = so->GetUid();
+          uint32_t count = 0;
+          this->ForEachNeighbor(
+              [&](const SimObject*, double squared_distance) {
+                if (squared_distance < squared_list_radius) {
+                  count++;
+                }
+              },
+              *so);
+          verlet_count_[soh] = count;
+        });
+
+    uint64_t total = 0;
+    for (int n = 0; n < tinfo->GetNumaNodes(); n++) {
+      auto num_sos = rm->GetNumSimObjects(n);
+      for (uint64_t i = 0; i < num_sos; i++) {
+        SoHandle soh(n, i);
+        verlet_start_[soh] = total;
+        total += verlet_count_[soh];
+      }
+    }
+
+    verlet_neighbors_.resize(total);
+    rm->ApplyOnAllElementsParallelDynamic(
+        1000, [&, this](SimObject* so, SoHandle soh) {
+          auto pos = verlet_start_[soh];
+          this->ForEachNeighbor(
+              [&](const SimObject* neighbor, double squared_distance) {
+                if (squared_distance < squared_list_radius) {
+                  verlet_neighbors_[pos++] = neighbor;
+                }
+              },
+              *so);
+        });
+
+    verlet_valid_ = true;
+    num_verlet_list_builds_++;
+  }
+
+  /// Calls `lambda` for each simulation object in the Verlet list of `query`.
+  /// `soh` is looked up, if it is invalid. Returns false, without calling
+  /// `lambda`, if `query` is not stored in the ResourceManager (e.g. a
+  /// daughter cell created during this iteration). Its neighbors must then
+  /// be searched in the grid.
+  template <typename TLambda>
+  bool ForEachVerletNeighbor(const SimObject& query, SoHandle soh,
+                             const TLambda& lambda) const {
+    if (soh == SoHandle()) {
+      auto* rm = Simulation::GetActive()->GetResourceManager();
+      soh = rm->GetSoHandle(query.GetUid());
+      if (soh == SoHandle()) {
+        return false;
+      }
+    }
+    auto start = verlet_start_[soh];
+    auto end = start + verlet_count_[soh];
+    for (auto i = start; i < end; i++) {
+      lambda(verlet_neighbors_[i]);
+    }
+    return true;
+  }
+
+  /// Returns the box length for the current largest object size
+  /// (see `Param::grid_box_length_factor_`).
+  uint32_t CalculateBoxLength() const {
+    auto* param = Simulation::GetActive()->GetParam();
+    auto factor = std::min(1.0, param->grid_box_length_factor_);
+    return std::max(1.0, ceil(factor * largest_object_size_));
+  }
+
+  /// Returns the number of box layers around the query box that must be
+  /// searched to find all simulation objects within `radius`.
+  uint32_t CalculateStencilRadius(double radius) const {
+    return std::max(1.0, ceil(radius / box_length_));
+  }
+
+  /// Returns true if the box with the given offset (in number of boxes) to
+  /// the query box must be searched to find all simulation objects within
+  /// `radius` of a point inside the query box. Takes `adjacency_` into
+  /// account.
+  bool IsInStencil(int64_t dx, int64_t dy, int64_t dz, double radius) const {
+    int num_non_zero = (dx != 0) + (dy != 0) + (dz != 0);
+    if ((adjacency_ == kLow && num_non_zero > 1) ||
+        (adjacency_ == kMedium && num_non_zero > 2)) {
+      return false;
+    }
+    // minimum distance between the query box and the offset box
+    double gap_x = std::max<int64_t>(std::abs(dx) - 1, 0);
+    double gap_y = std::max<int64_t>(std::abs(dy) - 1, 0);
+    double gap_z = std::max<int64_t>(std::abs(dz) - 1, 0);
+    double squared_gap = (gap_x * gap_x + gap_y * gap_y + gap_z * gap_z) *
+                         box_length_ * box_length_;
+    return squared_gap <= radius * radius;
+  }
+
+  /// Calculates the box index offsets of `stencil_` for the size of the
+  /// largest object. Must be called after the number of boxes along each axis
+  /// has been determined.
+  void UpdateStencil() {
+    stencil_search_radius_ = GetSearchRadius();
+    stencil_.clear();
+    stencil_.push_back(0);
+    int64_t sr = stencil_radius_;
+    for (int64_t z = -sr; z <= sr; z++) {
+      for (int64_t y = -sr; y <= sr; y++) {
+        for (int64_t x = -sr; x <= sr; x++) {
+          if ((x != 0 || y != 0 || z != 0) &&
+              IsInStencil(x, y, z, stencil_search_radius_)) {
+            stencil_.push_back(z * static_cast<int64_t>(num_boxes_xy_) +
+                               y * num_boxes_axis_[0] + x);
+          }
+        }
+      }
+    }
+    half_stencil_.clear();
+    for (auto offset : stencil_) {
+      if (offset > 0) {
+        half_stencil_.push_back(offset);
+      }
+    }
+  }
+
+  /// @brief      Gets the Moore (i.e adjacent) boxes of the query box. Also
+  ///             adds the query box. Searches as many box layers as needed to
+  ///             find all neighbors within the size of the largest object.
   ///
   /// @param[out] neighbor_boxes  The neighbor boxes
   /// @param[in]  box_idx         The query box
   ///
-  void GetMooreBoxes(FixedSizeVector<const Box*, 27>* neighbor_boxes,
+  void GetMooreBoxes(InlineVector<const Box*, 27>* neighbor_boxes,
                      size_t box_idx) const {
-    neighbor_boxes->push_back(GetBoxPointer(box_idx));
-
-    // Adjacent 6 (top, down, left, right, front and back)
-    if (adjacency_ >= kLow) {
-      neighbor_boxes->push_back(GetBoxPointer(box_idx - num_boxes_xy_));
-      neighbor_boxes->push_back(GetBoxPointer(box_idx + num_boxes_xy_));
-      neighbor_boxes->push_back(GetBoxPointer(box_idx - num_boxes_axis_[0]));
-      neighbor_boxes->push_back(GetBoxPointer(box_idx + num_boxes_axis_[0]));
-      neighbor_boxes->push_back(GetBoxPointer(box_idx - 1));
-      neighbor_boxes->push_back(GetBoxPointer(box_idx + 1));
-    }
-
-    // Adjacent 12
-    if (adjacency_ >= kMedium) {
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx - num_boxes_xy_ - num_boxes_axis_[0]));
-      neighbor_boxes->push_back(GetBoxPointer(box_idx - num_boxes_xy_ - 1));
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx - num_boxes_axis_[0] - 1));
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx + num_boxes_xy_ - num_boxes_axis_[0]));
-      neighbor_boxes->push_back(GetBoxPointer(box_idx + num_boxes_xy_ - 1));
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx + num_boxes_axis_[0] - 1));
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx - num_boxes_xy_ + num_boxes_axis_[0]));
-      neighbor_boxes->push_back(GetBoxPointer(box_idx - num_boxes_xy_ + 1));
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx - num_boxes_axis_[0] + 1));
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx + num_boxes_xy_ + num_boxes_axis_[0]));
-      neighbor_boxes->push_back(GetBoxPointer(box_idx + num_boxes_xy_ + 1));
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx + num_boxes_axis_[0] + 1));
-    }
-
-    // Adjacent 8
-    if (adjacency_ >= kHigh) {
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx - num_boxes_xy_ - num_boxes_axis_[0] - 1));
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx - num_boxes_xy_ - num_boxes_axis_[0] + 1));
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx - num_boxes_xy_ + num_boxes_axis_[0] - 1));
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx - num_boxes_xy_ + num_boxes_axis_[0] + 1));
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx + num_boxes_xy_ - num_boxes_axis_[0] - 1));
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx + num_boxes_xy_ - num_boxes_axis_[0] + 1));
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx + num_boxes_xy_ + num_boxes_axis_[0] - 1));
-      neighbor_boxes->push_back(
-          GetBoxPointer(box_idx + num_boxes_xy_ + num_boxes_axis_[0] + 1));
+    for (auto offset : stencil_) {
+      neighbor_boxes->push_back(GetBoxPointer(box_idx + offset));
+    }
+  }
+
+  /// @brief      Gets all boxes that can contain simulation objects within
+  ///             `radius` of a point inside the query box. Also adds the query
+  ///             box. Boxes outside the grid are skipped. Therefore, `radius`
+  ///             can exceed the grid padding.
+  ///
+  /// @param[out] neighbor_boxes  The neighbor boxes
+  /// @param[in]  box_idx         The query box
+  /// @param[in]  radius          The search radius
+  ///
+  void GetMooreBoxes(InlineVector<const Box*, 27>* neighbor_boxes,
+                     size_t box_idx, double radius) const {
+    InlineVector<uint64_t, 27> box_indices;
+    GetMooreBoxIndices(&box_indices, box_idx, radius);
+    for (size_t i = 0; i < box_indices.size(); i++) {
+      neighbor_boxes->push_back(GetBoxPointer(box_indices[i]));
+    }
+  }
+
+  /// Calls `lambda` with the index of each box whose Chebyshev distance to
+  /// the box at `center` is equal to `shell`. Boxes outside the grid are
+  /// skipped.
+  template <typename TLambda>
+  void ForEachBoxInShell(const std::array<uint32_t, 3>& center, int64_t shell,
+                         const TLambda& lambda) const {
+    std::array<int64_t, 3> c = {{center[0], center[1], center[2]}};
+    for (int64_t z = c[2] - shell; z <= c[2] + shell; z++) {
+      if (z < 0 || z >= num_boxes_axis_[2]) {
+        continue;
+      }
+      for (int64_t y = c[1] - shell; y <= c[1] + shell; y++) {
+        if (y < 0 || y >= num_boxes_axis_[1]) {
+          continue;
+        }
+        // Inside the faces of the shell, only the first and the last box
+        // along the x-axis belong to the shell.
+        bool face = std::abs(z - c[2]) == shell || std::abs(y - c[1]) == shell;
+        int64_t step = face ? 1 : 2 * shell;
+        for (int64_t x = c[0] - shell; x <= c[0] + shell; x += step) {
+          if (x < 0 || x >= num_boxes_axis_[0]) {
+            continue;
+          }
+          lambda(GetBoxIndex(std::array<uint32_t, 3>{
+              static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+              static_cast<uint32_t>(z)}));
+        }
+      }
     }
   }
 
   /// @brief      Gets the box indices of all adjacent boxes. Also adds the
-  ///             query box index.
+  ///             query box index. Searches as many box layers as needed to
+  ///             find all neighbors within the size of the largest object.
   ///
   /// @param[out] box_indices     Result containing all box indices
   /// @param[in]  box_idx         The query box
   ///
-  void GetMooreBoxIndices(FixedSizeVector<uint64_t, 27>* box_indices,
+  void GetMooreBoxIndices(InlineVector<uint64_t, 27>* box_indices,
                           size_t box_idx) const {
-    box_indices->push_back(box_idx);
+    for (auto offset : stencil_) {
+      box_indices->push_back(box_idx + offset);
+    }
+  }
 
-    // Adjacent 6 (top, down, left, right, front and back)
-    if (adjacency_ >= kLow) {
-      box_indices->push_back(box_idx - num_boxes_xy_);
-      box_indices->push_back(box_idx + num_boxes_xy_);
-      box_indices->push_back(box_idx - num_boxes_axis_[0]);
-      box_indices->push_back(box_idx + num_boxes_axis_[0]);
-      box_indices->push_back(box_idx - 1);
-      box_indices->push_back(box_idx + 1);
-    }
-
-    // Adjacent 12
-    if (adjacency_ >= kMedium) {
-      box_indices->push_back(box_idx - num_boxes_xy_ - num_boxes_axis_[0]);
-      box_indices->push_back(box_idx - num_boxes_xy_ - 1);
-      box_indices->push_back(box_idx - num_boxes_axis_[0] - 1);
-      box_indices->push_back(box_idx + num_boxes_xy_ - num_boxes_axis_[0]);
-      box_indices->push_back(box_idx + num_boxes_xy_ - 1);
-      box_indices->push_back(box_idx + num_boxes_axis_[0] - 1);
-      box_indices->push_back(box_idx - num_boxes_xy_ + num_boxes_axis_[0]);
-      box_indices->push_back(box_idx - num_boxes_xy_ + 1);
-      box_indices->push_back(box_idx - num_boxes_axis_[0] + 1);
-      box_indices->push_back(box_idx + num_boxes_xy_ + num_boxes_axis_[0]);
-      box_indices->push_back(box_idx + num_boxes_xy_ + 1);
-      box_indices->push_back(box_idx + num_boxes_axis_[0] + 1);
-    }
-
-    // Adjacent 8
-    if (adjacency_ >= kHigh) {
-      box_indices->push_back(box_idx - num_boxes_xy_ - num_boxes_axis_[0] - 1);
-      box_indices->push_back(box_idx - num_boxes_xy_ - num_boxes_axis_[0] + 1);
-      box_indices->push_back(box_idx - num_boxes_xy_ + num_boxes_axis_[0] - 1);
-      box_indices->push_back(box_idx - num_boxes_xy_ + num_boxes_axis_[0] + 1);
-      box_indices->push_back(box_idx + num_boxes_xy_ - num_boxes_axis_[0] - 1);
-      box_indices->push_back(box_idx + num_boxes_xy_ - num_boxes_axis_[0] + 1);
-      box_indices->push_back(box_idx + num_boxes_xy_ + num_boxes_axis_[0] - 1);
-      box_indices->push_back(box_idx + num_boxes_xy_ + num_boxes_axis_[0] + 1);
+  /// @brief      Gets the indices of all boxes that can contain simulation
+  ///             objects within `radius` of a point inside the query box.
+  ///             Also adds the query box index. Boxes outside the grid are
+  ///             skipped. Therefore, `radius` can exceed the grid padding.
+  ///
+  /// @param[out] box_indices     Result containing all box indices
+  /// @param[in]  box_idx         The query box
+  /// @param[in]  radius          The search radius
+  ///
+  void GetMooreBoxIndices(InlineVector<uint64_t, 27>* box_indices,
+                          size_t box_idx, double radius) const {
+    box_indices->push_back(box_idx);
+    int64_t sr = CalculateStencilRadius(radius);
+    auto box_coord = GetBoxCoordinates(box_idx);
+    std::array<int64_t, 3> min;
+    std::array<int64_t, 3> max;
+    for (int i = 0; i < 3; i++) {
+      min[i] = std::max<int64_t>(0, static_cast<int64_t>(box_coord[i]) - sr);
+      max[i] = std::min<int64_t>(num_boxes_axis_[i] - 1,
+                                 static_cast<int64_t>(box_coord[i]) + sr);
+    }
+    for (int64_t z = min[2]; z <= max[2]; z++) {
+      for (int64_t y = min[1]; y <= max[1]; y++) {
+        for (int64_t x = min[0]; x <= max[0]; x++) {
+          int64_t dx = x - box_coord[0];
+          int64_t dy = y - box_coord[1];
+          int64_t dz = z - box_coord[2];
+          if ((dx != 0 || dy != 0 || dz != 0) &&
+              IsInStencil(dx, dy, dz, radius)) {
+            box_indices->push_back(GetBoxIndex(std::array<uint32_t, 3>{
+                static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+                static_cast<uint32_t>(z)}));
+          }
+        }
+      }
     }
   }
 
@@ -960,6 +1829,8 @@ class Grid {
   /// e.g. E-W: E, or BNW-FSE: BNW
   /// NB: for the update mechanism using a CircularBuffer the order is
   /// important.
+  /// NB: only considers one layer of boxes around the query box and
+  /// therefore assumes that `stencil_radius_` is equal to one.
   ///
   ///        (x-axis to the right \ y-axis up)
   ///        z=1
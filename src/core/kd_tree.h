@@ -0,0 +1,607 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_KD_TREE_H_
+#define CORE_KD_TREE_H_
+
+#include <assert.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+#ifdef LINUX
+#include <parallel/algorithm>
+#endif  // LINUX
+
+#include <morton/morton.h>
+
+#include "core/container/fixed_size_vector.h"
+#include "core/container/math_array.h"
+#include "core/param/param.h"
+#include "core/resource_manager.h"
+#include "core/simulation.h"
+#include "core/spatial_index.h"
+#include "core/util/log.h"
+#include "core/util/math.h"
+#include "core/util/thread_info.h"
+
+namespace bdm {
+
+/// Balanced kd-tree over the positions of all simulation objects.
+/// In contrast to `Grid`, the memory consumption only depends on the number
+/// of simulation objects and not on the volume of the simulation space.
+/// Therefore, it is well suited for sparse and highly clustered
+/// populations.\n
+/// The tree is rebuilt from scratch during each update. Each level of the
+/// tree is split in parallel at the median along the axis with the largest
+/// extent. Nodes are stored implicitly (children of node `i` are `2i + 1`
+/// and `2i + 2`); all leaves are at the same depth.\n
+/// Neighbor mutexes are assigned to the occupied cells of a sparse uniform
+/// grid with a cell length equal to the largest object size. The index of
+/// a simulation object's cell is stored in `SimObject::box_idx_`.
+class KdTree : public SpatialIndex {
+ public:
+  /// Protects all occupied cells around a simulation object.
+  class NeighborMutexBuilder : public SpatialIndex::NeighborMutexBuilder {
+   public:
+    explicit NeighborMutexBuilder(KdTree* tree) : tree_(tree) {}
+
+    void Update() override { mutexes_.resize(tree_->cell_keys_.size()); }
+
+    NeighborMutex GetMutex(uint64_t box_idx) override {
+      FixedSizeVector<uint64_t, 27> mutex_indices;
+      tree_->GetNeighborCells(box_idx, &mutex_indices);
+      return NeighborMutex(mutex_indices, this);
+    }
+
+   private:
+    KdTree* tree_;
+  };
+
+  KdTree() {}
+
+  KdTree(KdTree const&) = delete;
+  void operator=(KdTree const&) = delete;
+
+  virtual ~KdTree() {}
+
+  void Update() override {
+    auto* sim = Simulation::GetActive();
+    auto* rm = sim->GetResourceManager();
+    auto* param = sim->GetParam();
+
+    if (rm->GetNumSimObjects() == 0) {
+      UpdateEmpty();
+      return;
+    }
+
+    rm->UpdateSoAStore();
+    CollectSimObjects();
+    UpdateDimensions();
+    initialized_ = true;
+    if (param->bound_space_) {
+      int min = param->min_bound_;
+      int max = param->max_bound_;
+      threshold_dimensions_ = {min, max};
+    }
+    BuildTree();
+    UpdateCells();
+
+    if (nb_mutex_builder_ != nullptr) {
+      nb_mutex_builder_->Update();
+    }
+  }
+
+  void ForEachNeighbor(const std::function<void(const SimObject*)>& lambda,
+                       const SimObject& query) override {
+    ForEachNeighborWithinRadius(
+        lambda, query, largest_object_size_ * largest_object_size_);
+  }
+
+  void ForEachNeighbor(
+      const std::function<void(const SimObject*, double)>& lambda,
+      const SimObject& query) override {
+    const auto& position = query.GetPosition();
+    double squared_radius = largest_object_size_ * largest_object_size_;
+    ForEachCandidate(position, squared_radius,
+                     [&](const SimObject* so, const Double3&) {
+      if (so == &query) {
+        return;
+      }
+      auto squared_distance = SquaredDistance(position, so->GetPosition());
+      if (squared_distance < squared_radius) {
+        lambda(so, squared_distance);
+      }
+    });
+  }
+
+  /// If the radius exceeds `GetNeighborSearchRadius()`, distances are based
+  /// on the positions at the time of the last update, because other threads
+  /// might modify simulation objects outside the neighborhood of `query`
+  /// concurrently.
+  void ForEachNeighborWithinRadius(
+      const std::function<void(const SimObject*)>& lambda,
+      const SimObject& query, double squared_radius) override {
+    const auto& position = query.GetPosition();
+    bool large_radius =
+        squared_radius > largest_object_size_ * largest_object_size_;
+    ForEachCandidate(position, squared_radius,
+                     [&](const SimObject* so, const Double3& snapshot) {
+      const auto& so_position = large_radius ? snapshot : so->GetPosition();
+      if (so != &query &&
+          SquaredDistance(position, so_position) < squared_radius) {
+        lambda(so);
+      }
+    });
+  }
+
+  /// Searches the kd-tree depth-first and only visits subtrees that can
+  /// contain simulation objects closer than the k-th closest one found so
+  /// far. Distances are based on the positions at the time of the last
+  /// update.
+  std::vector<const SimObject*> GetKNearestNeighbors(
+      const SimObject& query, uint64_t k) const override {
+    std::vector<const SimObject*> neighbors;
+    if (k == 0 || nodes_.size() == 0) {
+      return neighbors;
+    }
+    const auto& position = query.GetPosition();
+
+    using Candidate = std::pair<double, const SimObject*>;
+    auto closer = [](const Candidate& lhs, const Candidate& rhs) {
+      return lhs.first < rhs.first ||
+             (lhs.first == rhs.first &&
+              lhs.second->GetUid() < rhs.second->GetUid());
+    };
+    // max heap of the k closest candidates
+    std::vector<Candidate> heap;
+    heap.reserve(k);
+    // pairs of node index and squared distance to the half-space of the node
+    std::array<std::pair<uint64_t, double>, kMaxStackSize> stack;
+    uint64_t stack_size = 0;
+    stack[stack_size++] = {0, 0};
+    while (stack_size != 0) {
+      auto node_idx = stack[--stack_size].first;
+      auto min_squared_distance = stack[stack_size].second;
+      if (heap.size() == k && min_squared_distance > heap.front().first) {
+        continue;
+      }
+      const auto& node = nodes_[node_idx];
+      if (node_idx < first_leaf_) {
+        // visit the half-space that contains the query position first
+        double diff = position[node.axis_] - node.split_;
+        auto near = diff < 0 ? 2 * node_idx + 1 : 2 * node_idx + 2;
+        auto far = diff < 0 ? 2 * node_idx + 2 : 2 * node_idx + 1;
+        stack[stack_size++] = {far, diff * diff};
+        stack[stack_size++] = {near, 0};
+        continue;
+      }
+      for (auto i = node.begin_; i < node.end_; i++) {
+        auto* so = sim_objects_[i];
+        if (so == &query) {
+          continue;
+        }
+        Candidate candidate(SquaredDistance(position, positions_[i]), so);
+        if (heap.size() < k) {
+          heap.push_back(candidate);
+          std::push_heap(heap.begin(), heap.end(), closer);
+        } else if (closer(candidate, heap.front())) {
+          std::pop_heap(heap.begin(), heap.end(), closer);
+          heap.back() = candidate;
+          std::push_heap(heap.begin(), heap.end(), closer);
+        }
+      }
+    }
+
+    std::sort_heap(heap.begin(), heap.end(), closer);
+    neighbors.reserve(heap.size());
+    for (auto& candidate : heap) {
+      neighbors.push_back(candidate.second);
+    }
+    return neighbors;
+  }
+
+  double GetNeighborSearchRadius() const override {
+    return largest_object_size_;
+  }
+
+  /// Returns the index of the occupied mutex cell that contains `position`.
+  /// If no simulation object is located in this cell, the number of occupied
+  /// cells is returned.
+  size_t GetBoxIndex(const Double3& position) const override {
+    auto key = GetCellKey(position);
+    auto it = std::lower_bound(cell_keys_.begin(), cell_keys_.end(), key);
+    if (it == cell_keys_.end() || *it != key) {
+      return cell_keys_.size();
+    }
+    return std::distance(cell_keys_.begin(), it);
+  }
+
+  /// Iterates over all simulation objects in the order of the leaves of the
+  /// kd-tree.
+  void IterateZOrder(
+      const std::function<void(const SoHandle&)>& lambda) override {
+    for (auto& soh : handles_) {
+      lambda(soh);
+    }
+  }
+
+  double GetLargestObjectSize() const override { return largest_object_size_; }
+
+  const std::array<int32_t, 6>& GetDimensions() const override {
+    return grid_dimensions_;
+  }
+
+  const std::array<int32_t, 2>& GetDimensionThresholds() const override {
+    return threshold_dimensions_;
+  }
+
+  bool HasGrown() override { return has_grown_; }
+
+  NeighborMutexBuilder* GetNeighborMutexBuilder() override {
+    return nb_mutex_builder_.get();
+  }
+
+  void DisableNeighborMutexes() override { nb_mutex_builder_ = nullptr; }
+
+  /// Returns the number of nodes of the kd-tree
+  uint64_t GetNumNodes() const { return nodes_.size(); }
+
+ private:
+  /// Maximum number of simulation objects in a leaf
+  static constexpr uint64_t kLeafSize = 16;
+  /// Maximum number of pending nodes during a depth-first traversal.
+  /// Each level adds at most one pending node.
+  static constexpr uint64_t kMaxStackSize = 66;
+
+  struct Node {
+    /// Range of the simulation objects of this node in `sim_objects_`
+    uint64_t begin_ = 0;
+    uint64_t end_ = 0;
+    /// Split position along `axis_`. Simulation objects in the left child
+    /// are located at or below, in the right child at or above this value.
+    double split_ = 0;
+    uint32_t axis_ = 0;
+  };
+
+  /// Nodes of the complete binary tree
+  std::vector<Node> nodes_;
+  /// Index of the first leaf in `nodes_`
+  uint64_t first_leaf_ = 0;
+  /// Simulation objects sorted by leaves
+  std::vector<const SimObject*> sim_objects_;
+  /// SoHandles in the same order as `sim_objects_`
+  std::vector<SoHandle> handles_;
+  /// Positions at the time of the last update in the same order as
+  /// `sim_objects_`
+  std::vector<Double3> positions_;
+  /// Sorted morton codes of all cells that contain at least one simulation
+  /// object. The position of a cell in this vector is its box index.
+  std::vector<uint64_t> cell_keys_;
+  /// Length of a mutex cell
+  double cell_length_ = 1;
+  /// The size of the largest object in the simulation
+  double largest_object_size_ = 0;
+  /// Cube which contains all simulation objects
+  /// {x_min, x_max, y_min, y_max, z_min, z_max}
+  std::array<int32_t, 6> grid_dimensions_ = {{0, 0, 0, 0, 0, 0}};
+  /// Stores the min / max dimension value that need to be surpassed in order
+  /// to trigger a diffusion grid change
+  std::array<int32_t, 2> threshold_dimensions_ = {
+      {std::numeric_limits<int32_t>::max(),
+       -std::numeric_limits<int32_t>::max()}};
+  /// Flag to indicate that the dimensions have increased
+  bool has_grown_ = false;
+  /// Flag to indicate that the dimensions have been initialized
+  bool initialized_ = false;
+
+  /// Holds instance of NeighborMutexBuilder if it is enabled.
+  /// If `DisableNeighborMutexes` has been called this member set to nullptr.
+  std::unique_ptr<NeighborMutexBuilder> nb_mutex_builder_ =
+      std::make_unique<NeighborMutexBuilder>(this);
+
+  static double SquaredDistance(const Double3& pos1, const Double3& pos2) {
+    const double dx = pos2[0] - pos1[0];
+    const double dy = pos2[1] - pos1[1];
+    const double dz = pos2[2] - pos1[2];
+    return (dx * dx + dy * dy + dz * dz);
+  }
+
+  /// Calls `lambda` for each simulation object in all leaves that can
+  /// contain simulation objects within `squared_radius` of `position`
+  /// together with its position at the time of the last update.
+  template <typename TLambda>
+  void ForEachCandidate(const Double3& position, double squared_radius,
+                        const TLambda& lambda) const {
+    if (nodes_.size() == 0) {
+      return;
+    }
+    std::array<uint64_t, kMaxStackSize> stack;
+    uint64_t stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size != 0) {
+      auto node_idx = stack[--stack_size];
+      const auto& node = nodes_[node_idx];
+      if (node_idx >= first_leaf_) {
+        for (auto i = node.begin_; i < node.end_; i++) {
+          lambda(sim_objects_[i], positions_[i]);
+        }
+        continue;
+      }
+      double diff = position[node.axis_] - node.split_;
+      if (diff * diff <= squared_radius) {
+        stack[stack_size++] = 2 * node_idx + 1;
+        stack[stack_size++] = 2 * node_idx + 2;
+      } else if (diff < 0) {
+        stack[stack_size++] = 2 * node_idx + 1;
+      } else {
+        stack[stack_size++] = 2 * node_idx + 2;
+      }
+    }
+  }
+
+  /// There are no simulation objects in this simulation
+  void UpdateEmpty() {
+    auto* param = Simulation::GetActive()->GetParam();
+    bool uninitialized = !initialized_;
+    nodes_.clear();
+    sim_objects_.clear();
+    handles_.clear();
+    positions_.clear();
+    cell_keys_.clear();
+    if (uninitialized && param->bound_space_) {
+      // Initialize dimensions with `Param::min_bound_` and
+      // `Param::max_bound_`. This is required for the DiffusionGrid
+      int min = param->min_bound_;
+      int max = param->max_bound_;
+      grid_dimensions_ = {min, max, min, max, min, max};
+      threshold_dimensions_ = {min, max};
+      has_grown_ = true;
+      initialized_ = true;
+    } else if (!uninitialized) {
+      // all simulation objects have been removed in the last iteration
+      has_grown_ = false;
+    } else {
+      Log::Fatal(
+          "KdTree",
+          "You tried to initialize an empty simulation without bound space. "
+          "Therefore we cannot determine the size of the simulation space. "
+          "Please add simulation objects, or set Param::bound_space_, "
+          "Param::min_bound_, and Param::max_bound_.");
+    }
+  }
+
+  /// Copies pointers, SoHandles and positions of all simulation objects into
+  /// contiguous arrays.
+  void CollectSimObjects() {
+    auto* rm = Simulation::GetActive()->GetResourceManager();
+    auto* tinfo = ThreadInfo::GetInstance();
+
+    std::vector<uint64_t> numa_offsets(tinfo->GetNumaNodes(), 0);
+    for (int n = 1; n < tinfo->GetNumaNodes(); n++) {
+      numa_offsets[n] = numa_offsets[n - 1] + rm->GetNumSimObjects(n - 1);
+    }
+    auto num_sos = rm->GetNumSimObjects();
+    sim_objects_.resize(num_sos);
+    handles_.resize(num_sos);
+    positions_.resize(num_sos);
+    rm->ApplyOnAllElementsParallelDynamic(
+        1000, [&, this](SimObject* so, SoHandle soh) {
+          auto i = numa_offsets[soh.GetNumaNode()] + soh.GetElementIdx();
+          sim_objects_[i] = so;
+          handles_[i] = soh;
+          positions_[i] = rm->GetSoAPosition(soh);
+        });
+  }
+
+  /// Determines the dimensions of the simulation space and the size of the
+  /// largest object.
+  void UpdateDimensions() {
+    auto* rm = Simulation::GetActive()->GetResourceManager();
+    auto inf = Math::kInfinity;
+    double xmin = inf, ymin = inf, zmin = inf;
+    double xmax = -inf, ymax = -inf, zmax = -inf;
+    double largest = 0;
+    int64_t num_sos = positions_.size();
+#pragma omp parallel for reduction(min : xmin, ymin, zmin) \
+    reduction(max : xmax, ymax, zmax, largest)
+    for (int64_t i = 0; i < num_sos; i++) {
+      const auto& pos = positions_[i];
+      xmin = std::min(xmin, pos[0]);
+      ymin = std::min(ymin, pos[1]);
+      zmin = std::min(zmin, pos[2]);
+      xmax = std::max(xmax, pos[0]);
+      ymax = std::max(ymax, pos[1]);
+      zmax = std::max(zmax, pos[2]);
+      largest = std::max(largest, rm->GetSoADiameter(handles_[i]));
+    }
+    assert(largest > 0 &&
+           "The largest object size was found to be 0. Please check if your "
+           "cells are correctly initialized.");
+    largest_object_size_ = largest;
+    cell_length_ = std::max(1.0, ceil(largest));
+
+    // one layer of padding like the `Grid`
+    int32_t padding = cell_length_;
+    grid_dimensions_ = {static_cast<int32_t>(floor(xmin)) - padding,
+                        static_cast<int32_t>(ceil(xmax)) + padding,
+                        static_cast<int32_t>(floor(ymin)) - padding,
+                        static_cast<int32_t>(ceil(ymax)) + padding,
+                        static_cast<int32_t>(floor(zmin)) - padding,
+                        static_cast<int32_t>(ceil(zmax)) + padding};
+
+    // Determine if the dimensions have grown outwards
+    has_grown_ = false;
+    auto min_gd =
+        *std::min_element(grid_dimensions_.begin(), grid_dimensions_.end());
+    auto max_gd =
+        *std::max_element(grid_dimensions_.begin(), grid_dimensions_.end());
+    if (min_gd < threshold_dimensions_[0]) {
+      threshold_dimensions_[0] = min_gd;
+      has_grown_ = true;
+    }
+    if (max_gd > threshold_dimensions_[1]) {
+      threshold_dimensions_[1] = max_gd;
+      has_grown_ = true;
+    }
+  }
+
+  /// Splits the nodes of each level at the median of the axis with the
+  /// largest extent. Nodes of the same level are processed in parallel.
+  void BuildTree() {
+    uint64_t num_sos = positions_.size();
+    uint64_t depth = 0;
+    while ((num_sos + (1ull << depth) - 1) >> depth > kLeafSize) {
+      depth++;
+    }
+    first_leaf_ = (1ull << depth) - 1;
+    nodes_.resize((1ull << (depth + 1)) - 1);
+    nodes_[0].begin_ = 0;
+    nodes_[0].end_ = num_sos;
+
+    std::vector<uint64_t> order(num_sos);
+#pragma omp parallel for
+    for (uint64_t i = 0; i < num_sos; i++) {
+      order[i] = i;
+    }
+
+    for (uint64_t d = 0; d < depth; d++) {
+      uint64_t first = (1ull << d) - 1;
+      uint64_t num_nodes = 1ull << d;
+#pragma omp parallel for schedule(dynamic, 1)
+      for (uint64_t j = 0; j < num_nodes; j++) {
+        auto& node = nodes_[first + j];
+        // axis with the largest extent
+        Double3 min = {Math::kInfinity, Math::kInfinity, Math::kInfinity};
+        Double3 max = {-Math::kInfinity, -Math::kInfinity, -Math::kInfinity};
+        for (auto i = node.begin_; i < node.end_; i++) {
+          const auto& pos = positions_[order[i]];
+          for (int a = 0; a < 3; a++) {
+            min[a] = std::min(min[a], pos[a]);
+            max[a] = std::max(max[a], pos[a]);
+          }
+        }
+        uint32_t axis = 0;
+        for (uint32_t a = 1; a < 3; a++) {
+          if (max[a] - min[a] > max[axis] - min[axis]) {
+            axis = a;
+          }
+        }
+
+        auto mid = node.begin_ + (node.end_ - node.begin_) / 2;
+        std::nth_element(order.begin() + node.begin_, order.begin() + mid,
+                         order.begin() + node.end_,
+                         [&, this](uint64_t lhs, uint64_t rhs) {
+                           return positions_[lhs][axis] <
+                                  positions_[rhs][axis];
+                         });
+        node.axis_ = axis;
+        node.split_ = positions_[order[mid]][axis];
+        auto& left = nodes_[2 * (first + j) + 1];
+        auto& right = nodes_[2 * (first + j) + 2];
+        left.begin_ = node.begin_;
+        left.end_ = mid;
+        right.begin_ = mid;
+        right.end_ = node.end_;
+      }
+    }
+
+    // store simulation objects in the order of the leaves
+    std::vector<const SimObject*> sim_objects(num_sos);
+    std::vector<SoHandle> handles(num_sos);
+    std::vector<Double3> positions(num_sos);
+#pragma omp parallel for
+    for (uint64_t i = 0; i < num_sos; i++) {
+      sim_objects[i] = sim_objects_[order[i]];
+      handles[i] = handles_[order[i]];
+      positions[i] = positions_[order[i]];
+    }
+    sim_objects_.swap(sim_objects);
+    handles_.swap(handles);
+    positions_.swap(positions);
+  }
+
+  /// Returns the morton code of the mutex cell that contains `position`
+  uint64_t GetCellKey(const Double3& position) const {
+    std::array<uint32_t, 3> coord;
+    for (int i = 0; i < 3; i++) {
+      coord[i] = (floor(position[i]) - grid_dimensions_[2 * i]) / cell_length_;
+    }
+    return libmorton::morton3D_64_encode(coord[0], coord[1], coord[2]);
+  }
+
+  /// Determines all occupied mutex cells and assigns the index of its cell
+  /// to each simulation object.
+  void UpdateCells() {
+    auto* rm = Simulation::GetActive()->GetResourceManager();
+    int64_t num_sos = positions_.size();
+    cell_keys_.resize(num_sos);
+#pragma omp parallel for
+    for (int64_t i = 0; i < num_sos; i++) {
+      cell_keys_[i] = GetCellKey(positions_[i]);
+    }
+#ifdef LINUX
+    __gnu_parallel::sort(cell_keys_.begin(), cell_keys_.end());
+#else
+    std::sort(cell_keys_.begin(), cell_keys_.end());
+#endif  // LINUX
+    cell_keys_.erase(std::unique(cell_keys_.begin(), cell_keys_.end()),
+                     cell_keys_.end());
+
+#pragma omp parallel for
+    for (int64_t i = 0; i < num_sos; i++) {
+      auto key = GetCellKey(positions_[i]);
+      auto it = std::lower_bound(cell_keys_.begin(), cell_keys_.end(), key);
+      uint32_t cell_idx = std::distance(cell_keys_.begin(), it);
+      const_cast<SimObject*>(sim_objects_[i])->SetBoxIdx(cell_idx);
+      rm->SetSoABoxIdx(handles_[i], cell_idx);
+    }
+  }
+
+  /// Adds the indices of all occupied cells around the given cell (including
+  /// the cell itself).
+  void GetNeighborCells(uint64_t cell_idx,
+                        FixedSizeVector<uint64_t, 27>* cells) const {
+    uint_fast32_t x, y, z;
+    libmorton::morton3D_64_decode(cell_keys_[cell_idx], x, y, z);
+    for (int64_t dz = -1; dz <= 1; dz++) {
+      for (int64_t dy = -1; dy <= 1; dy++) {
+        for (int64_t dx = -1; dx <= 1; dx++) {
+          int64_t nx = x + dx;
+          int64_t ny = y + dy;
+          int64_t nz = z + dz;
+          if (nx < 0 || ny < 0 || nz < 0) {
+            continue;
+          }
+          auto key = libmorton::morton3D_64_encode(nx, ny, nz);
+          auto it =
+              std::lower_bound(cell_keys_.begin(), cell_keys_.end(), key);
+          if (it != cell_keys_.end() && *it == key) {
+            cells->push_back(std::distance(cell_keys_.begin(), it));
+          }
+        }
+      }
+    }
+  }
+};
+
+}  // namespace bdm
+
+#endif  // CORE_KD_TREE_H_
@@ -0,0 +1,359 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_MEMORY_MEMORY_MANAGER_H_
+#define CORE_MEMORY_MEMORY_MANAGER_H_
+
+#include <omp.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "core/util/numa.h"
+#include "core/util/thread_info.h"
+
+namespace bdm {
+
+/// Singly linked list of free memory elements. The pointer to the next
+/// element is stored inside the free element itself.\n
+/// This class is not thread-safe.
+class FreeList {
+ public:
+  bool Empty() const { return head_ == nullptr; }
+
+  uint64_t Size() const { return size_; }
+
+  void Push(void* element) {
+    *static_cast<void**>(element) = head_;
+    head_ = element;
+    size_++;
+  }
+
+  /// NB: The list must not be empty.
+  void* Pop() {
+    void* element = head_;
+    head_ = *static_cast<void**>(element);
+    size_--;
+    return element;
+  }
+
+  /// Moves up to `n` elements to `other`.
+  void MoveTo(FreeList* other, uint64_t n) {
+    for (uint64_t i = 0; i < n && head_ != nullptr; i++) {
+      other->Push(Pop());
+    }
+  }
+
+ private:
+  void* head_ = nullptr;
+  uint64_t size_ = 0;
+};
+
+/// Assigns a unique index to each thread that allocates memory. The index
+/// selects the thread cache of a `NumaPoolAllocator`. In contrast to
+/// `omp_get_thread_num()`, it is unique inside nested or serialized parallel
+/// regions and for threads that have not been created by OpenMP.\n
+/// Indices are assigned on first use. The index of a terminated thread is
+/// handed out again; the smallest free index is used first.
+class ThreadCacheIndex {
+ public:
+  /// Returned after the thread local storage of the calling thread has been
+  /// destroyed. It is larger than any valid index.
+  static constexpr uint64_t kNone = std::numeric_limits<uint64_t>::max();
+
+  static uint64_t Get() {
+    // trivially destructible; therefore still accessible during the
+    // destruction of other thread local or static objects
+    static thread_local uint64_t idx = kUnassigned;
+    if (idx == kUnassigned) {
+      idx = Acquire();
+      static thread_local Releaser releaser(&idx);
+    }
+    return idx;
+  }
+
+ private:
+  static constexpr uint64_t kUnassigned = kNone - 1;
+
+  /// Returns the index of the calling thread once the thread terminates
+  struct Releaser {
+    explicit Releaser(uint64_t* idx) : idx_(idx) {}
+    ~Releaser() {
+      Release(*idx_);
+      *idx_ = kNone;
+    }
+    uint64_t* idx_;
+  };
+
+  struct FreeIndices {
+    std::mutex mutex_;
+    std::vector<uint64_t> free_;
+    uint64_t next_ = 0;
+  };
+
+  /// Never destroyed, because threads might terminate during the
+  /// destruction of static objects.
+  static FreeIndices* GetFreeIndices() {
+    static FreeIndices* kInstance = new FreeIndices();
+    return kInstance;
+  }
+
+  static uint64_t Acquire() {
+    auto* indices = GetFreeIndices();
+    std::lock_guard<std::mutex> guard(indices->mutex_);
+    if (indices->free_.empty()) {
+      return indices->next_++;
+    }
+    auto it = std::min_element(indices->free_.begin(), indices->free_.end());
+    auto idx = *it;
+    indices->free_.erase(it);
+    return idx;
+  }
+
+  static void Release(uint64_t idx) {
+    auto* indices = GetFreeIndices();
+    std::lock_guard<std::mutex> guard(indices->mutex_);
+    indices->free_.push_back(idx);
+  }
+};
+
+/// Allocates memory elements of one size from memory of one NUMA node.\n
+/// Memory is requested in slabs of `kSlabSize` bytes that are aligned to
+/// `kSlabSize`. The header of each slab stores a pointer to the allocator
+/// that owns it. Therefore, the owner of an element can be determined from
+/// its address (see `GetOwner`).\n
+/// Each thread has its own list of free elements (see `ThreadCacheIndex`).
+/// Allocations and deallocations only acquire the mutex of the allocator if
+/// the list of the calling thread is empty, or has grown too large. In this
+/// case, elements are exchanged in batches of `kBatchSize`. Threads whose
+/// index exceeds the number of thread caches always acquire the mutex.
+class NumaPoolAllocator {
+ public:
+  static constexpr uint64_t kSlabSize = 1 << 21;
+  static constexpr uint64_t kSlabHeaderSize = 64;
+  static constexpr uint64_t kBatchSize = 64;
+
+  NumaPoolAllocator(uint64_t element_size, int numa_node)
+      : element_size_(element_size),
+        numa_node_(numa_node),
+        thread_caches_(ThreadInfo::GetInstance()->GetMaxThreads()) {}
+
+  NumaPoolAllocator(const NumaPoolAllocator&) = delete;
+  NumaPoolAllocator& operator=(const NumaPoolAllocator&) = delete;
+
+  ~NumaPoolAllocator() {
+    for (auto* slab : slabs_) {
+      free(slab);
+    }
+  }
+
+  /// Returns the allocator that owns the given element
+  static NumaPoolAllocator* GetOwner(const void* element) {
+    auto slab = reinterpret_cast<uintptr_t>(element) & ~(kSlabSize - 1);
+    return *reinterpret_cast<NumaPoolAllocator**>(slab);
+  }
+
+  void* New() {
+    uint64_t tid = ThreadCacheIndex::Get();
+    if (tid < thread_caches_.size()) {
+      auto& cache = thread_caches_[tid].free_list_;
+      if (cache.Empty()) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        Refill(&cache);
+      }
+      return cache.Pop();
+    }
+    // more threads than thread caches
+    FreeList tmp;
+    std::lock_guard<std::mutex> guard(mutex_);
+    Refill(&tmp);
+    tmp.MoveTo(&central_, tmp.Size() - 1);
+    return tmp.Pop();
+  }
+
+  void Delete(void* element) {
+    uint64_t tid = ThreadCacheIndex::Get();
+    if (tid < thread_caches_.size()) {
+      auto& cache = thread_caches_[tid].free_list_;
+      cache.Push(element);
+      if (cache.Size() > 2 * kBatchSize) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        cache.MoveTo(&central_, kBatchSize);
+      }
+      return;
+    }
+    std::lock_guard<std::mutex> guard(mutex_);
+    central_.Push(element);
+  }
+
+  uint64_t GetElementSize() const { return element_size_; }
+
+  int GetNumaNode() const { return numa_node_; }
+
+  /// Returns the number of slabs that have been allocated
+  uint64_t GetNumSlabs() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return slabs_.size();
+  }
+
+ private:
+  /// Pads the free list of each thread to a cache line to avoid false sharing
+  struct ThreadCache {
+    FreeList free_list_;
+    char padding_[64 - sizeof(FreeList)];
+  };
+
+  uint64_t element_size_;
+  int numa_node_;
+  std::vector<ThreadCache> thread_caches_;
+  /// Protects all members below
+  mutable std::mutex mutex_;
+  /// Elements that have been returned by threads with too many free elements
+  FreeList central_;
+  std::vector<void*> slabs_;
+  /// Unused memory of the most recent slab
+  char* slab_pos_ = nullptr;
+  char* slab_end_ = nullptr;
+
+  /// Moves up to `kBatchSize` free elements into `free_list`. Takes elements
+  /// from `central_` first and allocates new ones afterwards.
+  /// The caller must hold `mutex_`.
+  void Refill(FreeList* free_list) {
+    central_.MoveTo(free_list, kBatchSize);
+    while (free_list->Size() < kBatchSize) {
+      if (slab_pos_ + element_size_ > slab_end_) {
+        AllocateSlab();
+      }
+      free_list->Push(slab_pos_);
+      slab_pos_ += element_size_;
+    }
+  }
+
+  void AllocateSlab() {
+    void* slab = nullptr;
+    if (posix_memalign(&slab, kSlabSize, kSlabSize) != 0) {
+      throw std::bad_alloc();
+    }
+    // bind the pages before they are touched for the first time
+    numa_tonode_memory(slab, kSlabSize, numa_node_);
+    *static_cast<NumaPoolAllocator**>(slab) = this;
+    slabs_.push_back(slab);
+    slab_pos_ = static_cast<char*>(slab) + kSlabHeaderSize;
+    slab_end_ = static_cast<char*>(slab) + kSlabSize;
+  }
+};
+
+/// Memory allocator for simulation objects and biology modules. Allocations
+/// up to `kMaxElementSize` bytes are served by a `NumaPoolAllocator` for the
+/// given size and the NUMA node of the calling thread. Objects of the same
+/// type are therefore packed in contiguous slabs on the NUMA node of the
+/// thread that created them. Larger allocations are forwarded to the global
+/// `operator new`.\n
+/// Classes opt in with `BDM_MEMORY_MANAGER_OPERATORS`. `SimObject` and
+/// `BaseBiologyModule` do so; therefore, all subclasses use it.
+class MemoryManager {
+ public:
+  static constexpr uint64_t kGranularity = 16;
+  static constexpr uint64_t kMaxElementSize = 4096;
+
+  /// The instance is never destroyed, because simulation objects might be
+  /// deleted during the destruction of other static objects.
+  static MemoryManager* Get() {
+    static MemoryManager* kInstance = new MemoryManager();
+    return kInstance;
+  }
+
+  void* New(std::size_t size) {
+    if (size > kMaxElementSize) {
+      return ::operator new(size);
+    }
+    auto* tinfo = ThreadInfo::GetInstance();
+    // `ThreadInfo` knows the threads of the outermost parallel region.
+    // Threads of nested regions are assumed to run on the same NUMA node.
+    int tid = omp_get_level() > 0 ? omp_get_ancestor_thread_num(1) : 0;
+    int nid = tid < tinfo->GetMaxThreads() ? tinfo->GetNumaNode(tid) : 0;
+    return GetAllocator(size, nid)->New();
+  }
+
+  /// `size` must be the same as for the corresponding call to `New`
+  void Delete(void* p, std::size_t size) {
+    if (p == nullptr) {
+      return;
+    } else if (size > kMaxElementSize) {
+      ::operator delete(p);
+      return;
+    }
+    NumaPoolAllocator::GetOwner(p)->Delete(p);
+  }
+
+  /// Returns the allocator that serves elements of the given size on the
+  /// given NUMA node.
+  NumaPoolAllocator* GetAllocator(std::size_t size, int numa_node) {
+    auto idx = (size + kGranularity - 1) / kGranularity;
+    auto* allocators = pools_[idx].load(std::memory_order_acquire);
+    if (allocators == nullptr) {
+      std::lock_guard<std::mutex> guard(mutex_);
+      allocators = pools_[idx].load(std::memory_order_relaxed);
+      if (allocators == nullptr) {
+        allocators = new std::vector<NumaPoolAllocator*>();
+        for (int n = 0; n < numa_num_configured_nodes(); n++) {
+          allocators->push_back(
+              new NumaPoolAllocator(std::max<uint64_t>(idx, 1) * kGranularity,
+                                    n));
+        }
+        pools_[idx].store(allocators, std::memory_order_release);
+      }
+    }
+    return (*allocators)[numa_node];
+  }
+
+ private:
+  /// One `NumaPoolAllocator` for each NUMA node and each multiple of
+  /// `kGranularity` up to `kMaxElementSize`.
+  std::array<std::atomic<std::vector<NumaPoolAllocator*>*>,
+             kMaxElementSize / kGranularity + 1>
+      pools_;
+  std::mutex mutex_;
+
+  MemoryManager() {
+    for (auto& el : pools_) {
+      el = nullptr;
+    }
+  }
+};
+
+/// Inserts class-specific `operator new` and `operator delete` that allocate
+/// memory from the `MemoryManager`. Derived classes inherit them. The size
+/// argument of `operator delete` is the size of the dynamic type, because
+/// simulation objects and biology modules have virtual destructors.
+#define BDM_MEMORY_MANAGER_OPERATORS                          \
+  static void* operator new(std::size_t size) {               \
+    return ::bdm::MemoryManager::Get()->New(size);            \
+  }                                                           \
+                                                              \
+  static void operator delete(void* p, std::size_t size) {    \
+    ::bdm::MemoryManager::Get()->Delete(p, size);             \
+  }
+
+}  // namespace bdm
+
+#endif  // CORE_MEMORY_MEMORY_MANAGER_H_
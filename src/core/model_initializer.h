@@ -15,6 +15,8 @@
 #ifndef CORE_MODEL_INITIALIZER_H_
 #define CORE_MODEL_INITIALIZER_H_
 
+#include <array>
+#include <cmath>
 #include <ctime>
 #include <string>
 #include <vector>
@@ -24,6 +26,7 @@
 #include "core/resource_manager.h"
 #include "core/simulation.h"
 #include "core/thermal.h"
+#include "core/util/thread_info.h"
 #include "core/util/random.h"
 
 namespace bdm {
@@ -154,6 +157,77 @@ struct ModelInitializer {
     }
   }
 
+  /// Parallel version of `Grid3D`. Each thread creates a contiguous slab of
+  /// the grid on its own NUMA node. The resulting positions, uids and storage
+  /// order are deterministic for a given number of threads.\n
+  /// NB: `cell_builder` is called concurrently and must be thread-safe.
+  /// \see Grid3D
+  template <typename Function>
+  static void Grid3DParallel(const std::array<size_t, 3>& cells_per_dim,
+                             double space, Function cell_builder) {
+    uint64_t num_yz = cells_per_dim[1] * cells_per_dim[2];
+    CreateSimObjectsParallel(
+        cells_per_dim[0] * num_yz, [&](uint64_t idx, int tid) {
+          double x_pos = (idx / num_yz) * space;
+          double y_pos = ((idx / cells_per_dim[2]) % cells_per_dim[1]) * space;
+          double z_pos = (idx % cells_per_dim[2]) * space;
+          return cell_builder({x_pos, y_pos, z_pos});
+        });
+  }
+
+  /// Parallel version of `Grid3D` for a cubic grid.
+  /// \see Grid3DParallel
+  template <typename Function>
+  static void Grid3DParallel(size_t cells_per_dim, double space,
+                             Function cell_builder) {
+    Grid3DParallel({cells_per_dim, cells_per_dim, cells_per_dim}, space,
+                   cell_builder);
+  }
+
+  /// Parallel version of `CreateCells`. Each thread creates a contiguous
+  /// range of `positions` on its own NUMA node. The resulting uids and
+  /// storage order are deterministic for a given number of threads.\n
+  /// NB: `cell_builder` is called concurrently and must be thread-safe.
+  /// \see CreateCells
+  template <typename Function>
+  static void CreateCellsParallel(const std::vector<Double3>& positions,
+                                  Function cell_builder) {
+    CreateSimObjectsParallel(positions.size(), [&](uint64_t idx, int tid) {
+      return cell_builder(positions[idx]);
+    });
+  }
+
+  /// Parallel version of `CreateCellsRandom`. The space is divided into
+  /// slabs along the x-axis; one per thread. Each thread creates its share
+  /// of simulation objects inside its slab on its own NUMA node and draws
+  /// random numbers from a local generator. The seeds of these generators
+  /// are drawn from the calling thread's generator. Therefore, results are
+  /// deterministic for a given seed and number of threads, and subsequent
+  /// calls create different positions.\n
+  /// NB: `cell_builder` is called concurrently and must be thread-safe.
+  /// \see CreateCellsRandom
+  template <typename Function>
+  static void CreateCellsRandomParallel(double min, double max, int num_cells,
+                                        Function cell_builder) {
+    auto* sim = Simulation::GetActive();
+    auto max_threads = ThreadInfo::GetInstance()->GetMaxThreads();
+
+    auto* seeder = sim->GetRandom();
+    std::vector<Random> random(max_threads);
+    for (auto& r : random) {
+      // TRandom3 interprets seed 0 as "use the current time"
+      r.SetSeed(std::floor(seeder->Uniform(1, 4294967295.0)));
+    }
+
+    double slab = (max - min) / max_threads;
+    CreateSimObjectsParallel(num_cells, [&](uint64_t idx, int tid) {
+      double x = random[tid].Uniform(min + tid * slab, min + (tid + 1) * slab);
+      double y = random[tid].Uniform(min, max);
+      double z = random[tid].Uniform(min, max);
+      return cell_builder({x, y, z});
+    });
+  }
+
   /// Allows cells to secrete the specified substance. Diffusion throughout the
   /// simulation space is automatically taken care of by the DiffusionGrid class
   ///
@@ -200,6 +274,69 @@ struct ModelInitializer {
         new ThermalGrid(thermal_diffusivity, resolution, substance_id);
     rm->AddDiffusionGrid(d_grid);
   }
+
+ private:
+  /// Creates `num_sim_objects` simulation objects in parallel and adds them
+  /// to the ResourceManager. Thread `tid` calls `builder(idx, tid)` for a
+  /// contiguous range of indices and stores the results on its NUMA node.
+  /// Uids are reassigned in index order, because the threads obtained them
+  /// concurrently.
+  template <typename Function>
+  static void CreateSimObjectsParallel(uint64_t num_sim_objects,
+                                       Function builder) {
+    auto* rm = Simulation::GetActive()->GetResourceManager();
+    auto* tinfo = ThreadInfo::GetInstance();
+    auto max_threads = tinfo->GetMaxThreads();
+    auto* uid_generator = SoUidGenerator::Get();
+    auto first_uid = uid_generator->GetLastId();
+
+    std::vector<uint64_t> begin(max_threads + 1);
+    for (int tid = 0; tid <= max_threads; tid++) {
+      begin[tid] = num_sim_objects * tid / max_threads;
+    }
+
+    std::vector<std::vector<SimObject*>> sim_objects(max_threads);
+#pragma omp parallel for schedule(static, 1)
+    for (int tid = 0; tid < max_threads; tid++) {
+      auto& thread_sos = sim_objects[tid];
+      thread_sos.reserve(begin[tid + 1] - begin[tid]);
+      for (uint64_t i = begin[tid]; i < begin[tid + 1]; i++) {
+        thread_sos.push_back(builder(i, tid));
+      }
+    }
+
+    // Skip if `builder` created additional simulation objects, because
+    // their uids might be in use.
+    if (uid_generator->GetLastId() - first_uid == num_sim_objects) {
+#pragma omp parallel for schedule(static, 1)
+      for (int tid = 0; tid < max_threads; tid++) {
+        auto& thread_sos = sim_objects[tid];
+        for (uint64_t i = 0; i < thread_sos.size(); i++) {
+          thread_sos[i]->SetUid(first_uid + begin[tid] + i);
+        }
+      }
+    }
+
+    // group threads by numa node
+    std::vector<uint64_t> so_per_numa(tinfo->GetNumaNodes());
+    std::vector<uint64_t> thread_offsets(max_threads);
+    for (int tid = 0; tid < max_threads; tid++) {
+      int nid = tinfo->GetNumaNode(tid);
+      thread_offsets[tid] = so_per_numa[nid];
+      so_per_numa[nid] += sim_objects[tid].size();
+    }
+    std::vector<uint64_t> numa_offsets(tinfo->GetNumaNodes());
+    for (unsigned n = 0; n < so_per_numa.size(); n++) {
+      numa_offsets[n] = rm->GrowSoContainer(so_per_numa[n], n);
+    }
+
+#pragma omp parallel for schedule(static, 1)
+    for (int tid = 0; tid < max_threads; tid++) {
+      int nid = tinfo->GetNumaNode(tid);
+      rm->AddNewSimObjects(nid, numa_offsets[nid] + thread_offsets[tid],
+                           sim_objects[tid]);
+    }
+  }
 };
 
 }  // namespace bdm
@@ -15,6 +15,8 @@
 #ifndef CORE_OPERATION_DIFFUSION_OP_H_
 #define CORE_OPERATION_DIFFUSION_OP_H_
 
+#include <algorithm>
+#include <functional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -22,6 +24,7 @@
 #include "core/container/inline_vector.h"
 #include "core/diffusion_grid.h"
 #include "core/grid.h"
+#include "core/operation/operation.h"
 #include "core/param/param.h"
 #include "core/resource_manager.h"
 #include "core/simulation.h"
@@ -35,33 +38,83 @@ class DiffusionOp {
   virtual ~DiffusionOp() {}
 
   void operator()() {
+    auto* rm = Simulation::GetActive()->GetResourceManager();
+    rm->ApplyOnAllDiffusionGrids([&](DiffusionGrid* dg) { (*this)(dg); });
+  }
+
+  /// Updates a single diffusion grid.
+  void operator()(DiffusionGrid* dg) {
+    auto* param = Simulation::GetActive()->GetParam();
+    UpdateDimensions(dg);
+
+    if (param->leaking_edges_) {
+      dg->DiffuseEulerLeakingEdge();
+    } else {
+      dg->DiffuseEuler();
+    }
+
+    if (param->calculate_gradients_) {
+      dg->CalculateGradient();
+    }
+  }
+
+  /// Splits the update of a single diffusion grid into tasks that each
+  /// process `kPlanesPerTask` xy planes, and appends them to `tasks`. The
+  /// tasks are independent of each other and do not open a parallel region.
+  /// Hence, they can be executed by different threads in parallel with
+  /// other work (see `ResourceManager::ApplyOnAllElementsParallelDynamic`).
+  /// `FinishTasks` must be called once all tasks have been executed.
+  void CreateTasks(DiffusionGrid* dg,
+                   std::vector<std::function<void()>>* tasks) {
+    auto* param = Simulation::GetActive()->GetParam();
+    UpdateDimensions(dg);
+
+    bool leaking_edges = param->leaking_edges_;
+    auto nz = dg->GetNumBoxesArray()[2];
+    for (size_t z = 0; z < nz; z += kPlanesPerTask) {
+      auto z_end = std::min(nz, z + kPlanesPerTask);
+      tasks->push_back([dg, z, z_end, leaking_edges]() {
+        if (leaking_edges) {
+          dg->DiffuseEulerLeakingEdgeSlab(z, z_end);
+        } else {
+          dg->DiffuseEulerSlab(z, z_end);
+        }
+      });
+    }
+  }
+
+  /// Completes the update of a diffusion grid whose tasks have been
+  /// created with `CreateTasks`.
+  void FinishTasks(DiffusionGrid* dg) {
+    dg->FinishDiffusion();
+    if (Simulation::GetActive()->GetParam()->calculate_gradients_) {
+      dg->CalculateGradient();
+    }
+  }
+
+  /// Returns the data that is accessed by updating the given diffusion grid
+  static OpAccess GetAccess(const DiffusionGrid* dg) {
+    return {{OpResource::kSpatialIndex},
+            {OpResource::DiffusionGrid(dg->GetSubstanceId())}};
+  }
+
+ private:
+  /// Number of xy planes that are processed by one task of `CreateTasks`
+  static constexpr size_t kPlanesPerTask = 4;
+
+  /// Updates the diffusion grid dimensions if the neighbor grid dimensions
+  /// have changed. If the space is bound, we do not need to update the
+  /// dimensions, because these should not be changing anyway
+  void UpdateDimensions(DiffusionGrid* dg) {
     auto* sim = Simulation::GetActive();
-    auto* rm = sim->GetResourceManager();
-    auto* grid = sim->GetGrid();
-    auto* param = sim->GetParam();
-
-    rm->ApplyOnAllDiffusionGrids([&](DiffusionGrid* dg) {
-      // Update the diffusion grid dimension if the neighbor grid dimensions
-      // have changed. If the space is bound, we do not need to update the
-      // dimensions, because these should not be changing anyway
-      if (grid->HasGrown() && !param->bound_space_) {
-        Log::Info("DiffusionOp",
-                  "Your simulation objects are getting near the edge of the "
-                  "simulation space. Be aware of boundary conditions that may "
-                  "come into play!");
-        dg->Update(grid->GetDimensionThresholds());
-      }
-
-      if (param->leaking_edges_) {
-        dg->DiffuseEulerLeakingEdge();
-      } else {
-        dg->DiffuseEuler();
-      }
-
-      if (param->calculate_gradients_) {
-        dg->CalculateGradient();
-      }
-    });
+    auto* spatial_index = sim->GetSpatialIndex();
+    if (spatial_index->HasGrown() && !sim->GetParam()->bound_space_) {
+      Log::Info("DiffusionOp",
+                "Your simulation objects are getting near the edge of the "
+                "simulation space. Be aware of boundary conditions that may "
+                "come into play!");
+      dg->Update(spatial_index->GetDimensionThresholds());
+    }
   }
 };
 
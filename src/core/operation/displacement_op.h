@@ -18,6 +18,7 @@
 #include <type_traits>
 
 #include "core/operation/displacement_op_cpu.h"
+#include "core/operation/displacement_op_half_shell.h"
 #ifdef USE_CUDA
 #include "core/operation/displacement_op_cuda.h"
 #endif
@@ -49,9 +50,19 @@ class DisplacementOp {
            (!param->use_gpu_ && !param->use_opencl_);
   }
 
+  /// Returns true if the displacement of all simulation objects is calculated
+  /// at once by `DisplacementOpHalfShell` instead of calculating it for each
+  /// simulation object separately (see `Param::half_shell_displacement_`).
+  bool UseHalfShell() const {
+    auto* param = Simulation::GetActive()->GetParam();
+    return param->half_shell_displacement_ && UseCpu();
+  }
+
   void operator()() {
     auto* param = Simulation::GetActive()->GetParam();
-    if (param->use_gpu_ && !force_cpu_implementation_) {
+    if (UseHalfShell()) {
+      half_shell_();
+    } else if (param->use_gpu_ && !force_cpu_implementation_) {
 #ifdef USE_OPENCL
       if (param->use_opencl_) {
         auto* rm = Simulation::GetActive()->GetResourceManager();
@@ -87,6 +98,7 @@ class DisplacementOp {
   /// will be set to true.
   bool force_cpu_implementation_ = false;
   DisplacementOpCpu cpu_;
+  DisplacementOpHalfShell half_shell_;
 #ifdef USE_CUDA
   DisplacementOpCuda cuda_;  // NOLINT
 #endif
@@ -49,8 +49,8 @@ class DisplacementOpCpu {
     if (last_iteration_ != current_iteration) {
       last_iteration_ = current_iteration;
 
-      auto* grid = sim->GetGrid();
-      auto search_radius = grid->GetLargestObjectSize();
+      auto* spatial_index = sim->GetSpatialIndex();
+      auto search_radius = spatial_index->GetLargestObjectSize();
       squared_radius_ = search_radius * search_radius;
       auto current_time =
           (current_iteration + 1) * param->simulation_time_step_;
@@ -0,0 +1,123 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_OPERATION_DISPLACEMENT_OP_HALF_SHELL_H_
+#define CORE_OPERATION_DISPLACEMENT_OP_HALF_SHELL_H_
+
+#include <atomic>
+
+#include "core/container/math_array.h"
+#include "core/container/sim_object_vector.h"
+#include "core/default_force.h"
+#include "core/grid.h"
+#include "core/operation/bound_space_op.h"
+#include "core/param/param.h"
+#include "core/scheduler.h"
+#include "core/shape.h"
+#include "core/sim_object/cell.h"
+#include "core/simulation.h"
+#include "core/util/log.h"
+#include "core/util/type.h"
+
+namespace bdm {
+
+/// Calculates the displacement of all simulation objects at once.
+/// Each pairwise force is only calculated once: the force on the neighbor is
+/// equal and opposite (Newton's third law). Forces are accumulated in one
+/// shared buffer and applied in a second pass. `Grid::ForEachNeighborPair`
+/// never processes two pairs of the same simulation object concurrently and
+/// visits them in a fixed order. Hence, the accumulation needs no atomics,
+/// the result for a given grid does not depend on the number of threads, and
+/// memory consumption does not grow with the number of threads.
+/// In contrast to `DisplacementOpCpu`, all forces are calculated based on the
+/// positions at the beginning of the operation.
+/// Currently only supports spherical shapes.
+class DisplacementOpHalfShell {
+ public:
+  DisplacementOpHalfShell() {}
+  ~DisplacementOpHalfShell() {}
+
+  void operator()() {
+    auto* sim = Simulation::GetActive();
+    auto* rm = sim->GetResourceManager();
+    auto* grid = sim->GetGrid();
+    auto* param = sim->GetParam();
+
+    auto current_time = (sim->GetScheduler()->GetSimulatedSteps() + 1) *
+                        param->simulation_time_step_;
+    auto delta_time = current_time - last_time_run_;
+    last_time_run_ = current_time;
+
+    // reset force buffers
+    forces_.resize();
+    std::atomic<bool> non_spherical(false);
+    rm->ApplyOnAllElementsParallelDynamic(
+        1000, [&, this](SimObject* so, SoHandle soh) {
+          if (so->GetShape() != Shape::kSphere) {
+            non_spherical = true;
+          }
+          forces_[soh] = {0, 0, 0};
+        });
+    if (sim->GetSpatialIndex() != grid) {
+      Log::Fatal("DisplacementOpHalfShell",
+                 "The half-shell implementation requires the uniform grid "
+                 "(Param::spatial_index_ = \"uniform_grid\").");
+    }
+    if (non_spherical) {
+      Log::Fatal("DisplacementOpHalfShell",
+                 "Currently the half-shell implementation only supports "
+                 "spherical shapes.");
+    }
+
+    // calculate each pairwise force only once
+    auto search_radius = grid->GetLargestObjectSize();
+    grid->ForEachNeighborPair(
+        [this](SimObject* lhs, SoHandle lhs_soh, SimObject* rhs,
+               SoHandle rhs_soh) {
+          DefaultForce default_force;
+          auto force = default_force.GetForce(lhs, rhs);
+          auto& lhs_force = forces_[lhs_soh];
+          auto& rhs_force = forces_[rhs_soh];
+          for (int i = 0; i < 3; i++) {
+            lhs_force[i] += force[i];
+            rhs_force[i] -= force[i];
+          }
+        },
+        search_radius * search_radius);
+
+    // apply the sum of all forces
+    rm->ApplyOnAllElementsParallelDynamic(
+        1000, [&, this](SimObject* so, SoHandle soh) {
+          if (!so->RunDisplacement()) {
+            return;
+          }
+          auto* cell = bdm_static_cast<Cell*>(so);
+          cell->ApplyDisplacement(
+              cell->CalculateDisplacementFromForce(forces_[soh], delta_time));
+          if (param->bound_space_) {
+            ApplyBoundingBox(so, param->min_bound_, param->max_bound_);
+          }
+          rm->UpdateSoAStore(so, soh);
+        });
+  }
+
+ private:
+  double last_time_run_ = 0;
+  /// Sum of all forces on each simulation object
+  SimObjectVector<Double3> forces_;
+};
+
+}  // namespace bdm
+
+#endif  // CORE_OPERATION_DISPLACEMENT_OP_HALF_SHELL_H_
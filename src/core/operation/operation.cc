@@ -17,6 +17,45 @@
 
 namespace bdm {
 
+bool OpResource::Overlaps(const OpResource& other) const {
+  if (type_ == kDiffusionGrid && other.type_ == kDiffusionGrid) {
+    return substance_id_ == other.substance_id_;
+  }
+  auto is_dgrid = [](Type type) {
+    return type == kDiffusionGrid || type == kAllDiffusionGrids;
+  };
+  if (is_dgrid(type_) && is_dgrid(other.type_)) {
+    return true;
+  }
+  return type_ == other.type_;
+}
+
+namespace {
+
+bool Overlaps(const std::vector<OpResource>& lhs,
+              const std::vector<OpResource>& rhs) {
+  for (auto& l : lhs) {
+    for (auto& r : rhs) {
+      if (l.Overlaps(r)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+bool OpAccess::ConflictsWith(const OpAccess& other) const {
+  return Overlaps(writes_, other.reads_) || Overlaps(writes_, other.writes_) ||
+         Overlaps(reads_, other.writes_);
+}
+
+void OpAccess::Merge(const OpAccess& other) {
+  reads_.insert(reads_.end(), other.reads_.begin(), other.reads_.end());
+  writes_.insert(writes_.end(), other.writes_.begin(), other.writes_.end());
+}
+
 Operation::Operation() : name_("null") {}
 
 Operation::Operation(const std::string& name, const FunctionType& f)
@@ -26,6 +65,14 @@ Operation::Operation(const std::string& name, uint32_t frequency,
                      const FunctionType& f)
     : frequency_(frequency), name_(name), function_(f) {}
 
-void Operation::operator()(SimObject* so) const { function_(so); }
+void Operation::operator()(SimObject* so) const {
+  if (type_filter_ != nullptr && typeid(*so) != *type_filter_) {
+    return;
+  }
+  if (filter_ && !filter_(so)) {
+    return;
+  }
+  function_(so);
+}
 
 }  // namespace bdm
@@ -17,16 +17,56 @@
 
 #include <functional>
 #include <string>
+#include <typeinfo>
+#include <vector>
 
 namespace bdm {
 
 class SimObject;
 
+/// Data that is accessed by an operation, or by another phase of
+/// `Scheduler::Execute`.
+struct OpResource {
+  enum Type { kSimObjects, kSpatialIndex, kDiffusionGrid, kAllDiffusionGrids };
+
+  OpResource(Type type, int substance_id = -1)  // NOLINT
+      : type_(type), substance_id_(substance_id) {}
+
+  /// The diffusion grid of the given substance
+  static OpResource DiffusionGrid(int substance_id) {
+    return OpResource(kDiffusionGrid, substance_id);
+  }
+
+  /// Returns true if `this` and `other` refer to (partially) the same data
+  bool Overlaps(const OpResource& other) const;
+
+  Type type_;
+  /// Only used for `kDiffusionGrid`
+  int substance_id_;
+};
+
+/// Read and write set of an operation, or of another phase of
+/// `Scheduler::Execute`.
+struct OpAccess {
+  std::vector<OpResource> reads_;
+  std::vector<OpResource> writes_;
+
+  /// Returns true if `this` and `other` must not be executed concurrently,
+  /// because one of them writes data that the other one reads or writes.
+  bool ConflictsWith(const OpAccess& other) const;
+
+  /// Adds the reads and writes of `other` to `this`.
+  void Merge(const OpAccess& other);
+};
+
 /// An Operation contains a function that will be executed for each simulation
 /// object. It's data member `frequency_` specifies how often it will be
 /// executed (every simulation step, every second, ...).
+/// `type_filter_` and `filter_` restrict the operation to a subset of
+/// simulation objects.
 struct Operation {
   using FunctionType = std::function<void(SimObject*)>;
+  using FilterType = std::function<bool(const SimObject*)>;
 
   Operation();
 
@@ -34,8 +74,16 @@ struct Operation {
 
   Operation(const std::string& name, uint32_t frequency, const FunctionType& f);
 
+  /// Executes the function for `so`, if `so` passes the filters
   void operator()(SimObject* so) const;
 
+  /// Restricts this operation to simulation objects whose dynamic type is
+  /// exactly `TSimObject` (subclasses are excluded).
+  template <typename TSimObject>
+  void SetTypeFilter() {
+    type_filter_ = &typeid(TSimObject);
+  }
+
   /// Specifies how often this operation will be executed.\n
   /// 1: every timestep\n
   /// 2: every second timestep\n
@@ -43,6 +91,25 @@ struct Operation {
   uint32_t frequency_ = 1;
   /// Operation name / unique identifier
   std::string name_;
+  /// Data this operation reads and writes in addition to the simulation
+  /// object it is executed for. The `Scheduler` uses it to determine which
+  /// phases of an iteration can overlap with the operations on simulation
+  /// objects (see `Scheduler::Execute`).\n
+  /// By default, an operation may read and write all simulation objects and
+  /// all diffusion grids, and read the spatial index. Restricting the set
+  /// can only improve performance if the declared set is complete.
+  /// Otherwise, race conditions occur.
+  OpAccess access_ = {
+      {OpResource::kSimObjects, OpResource::kSpatialIndex,
+       OpResource::kAllDiffusionGrids},
+      {OpResource::kSimObjects, OpResource::kAllDiffusionGrids}};
+  /// If set, the operation is only executed for simulation objects whose
+  /// dynamic type is `*type_filter_` (see `SetTypeFilter`). The check only
+  /// compares type information and does not call a virtual function.
+  const std::type_info* type_filter_ = nullptr;
+  /// If set, the operation is only executed for simulation objects for which
+  /// `filter_` returns true. Checked after `type_filter_`.
+  FilterType filter_;
 
  private:
   FunctionType function_;
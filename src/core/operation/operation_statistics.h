@@ -0,0 +1,225 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_OPERATION_OPERATION_STATISTICS_H_
+#define CORE_OPERATION_OPERATION_STATISTICS_H_
+
+#include <omp.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "core/operation/operation.h"
+#include "core/util/thread_info.h"
+
+namespace bdm {
+
+/// Measures the execution time of operations on simulation objects in
+/// nanoseconds for each operation and thread (see `Param::statistics_`).\n
+/// `Instrument` wraps an operation, such that each invocation adds its
+/// duration to counters of the calling thread. Therefore, threads do not
+/// synchronize while operations are executed. `Merge` adds the counters of
+/// all threads to the totals at the end of each step.\n
+/// The durations of single invocations are recorded in a histogram with
+/// buckets of powers of two (bucket `b` contains durations in
+/// [2^b, 2^(b+1)) ns). Hence, percentiles are upper bounds that are at
+/// most two times larger than the exact values.
+class OperationStatistics {
+ public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr uint64_t kNumBuckets = 64;
+
+  OperationStatistics()
+      : thread_counters_(ThreadInfo::GetInstance()->GetMaxThreads()) {}
+
+  /// Returns an operation that executes `op` and records its execution
+  /// time. The returned operation must not outlive this object.\n
+  /// NB: This function is not thread-safe.
+  Operation Instrument(const Operation& op) {
+    auto idx = GetIndex(op.name_);
+    Operation instrumented(
+        op.name_, op.frequency_, [this, idx, op](SimObject* so) {
+          auto start = Clock::now();
+          op(so);
+          auto duration = Clock::now() - start;
+          Record(idx, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          duration)
+                          .count());
+        });
+    instrumented.access_ = op.access_;
+    // objects that are filtered out must not be counted
+    instrumented.type_filter_ = op.type_filter_;
+    instrumented.filter_ = op.filter_;
+    return instrumented;
+  }
+
+  /// Records one invocation of the operation with index `op_idx` that took
+  /// `ns` nanoseconds for the calling thread.
+  void Record(uint64_t op_idx, uint64_t ns) {
+    uint64_t tid = omp_get_thread_num();
+    if (tid >= thread_counters_.size()) {
+      // thread has been created after this object
+      tid = 0;
+    }
+    thread_counters_[tid][op_idx].Add(ns);
+  }
+
+  /// Adds the counters of all threads to the totals and resets them.\n
+  /// NB: This function is not thread-safe.
+  void Merge() {
+    for (uint64_t tid = 0; tid < thread_counters_.size(); tid++) {
+      auto& counters = thread_counters_[tid];
+      for (uint64_t op = 0; op < counters.size(); op++) {
+        totals_[op].Add(counters[op]);
+        thread_totals_[op][tid] += counters[op].time_;
+        counters[op] = Counters();
+      }
+    }
+  }
+
+  /// Returns the total execution time of the given operation in ns
+  uint64_t GetTotalTime(const std::string& op_name) const {
+    auto* counters = GetTotals(op_name);
+    return counters != nullptr ? counters->time_ : 0;
+  }
+
+  /// Returns the number of invocations of the given operation
+  uint64_t GetCount(const std::string& op_name) const {
+    auto* counters = GetTotals(op_name);
+    return counters != nullptr ? counters->count_ : 0;
+  }
+
+  /// Returns an upper bound in ns for the given percentile `p` (0 < p <= 1)
+  /// of the durations of single invocations of the given operation.
+  uint64_t GetPercentile(const std::string& op_name, double p) const {
+    auto* counters = GetTotals(op_name);
+    if (counters == nullptr || counters->count_ == 0) {
+      return 0;
+    }
+    uint64_t cumulative = 0;
+    for (uint64_t b = 0; b < kNumBuckets; b++) {
+      cumulative += counters->histogram_[b];
+      if (cumulative >= p * counters->count_) {
+        return b + 1 < kNumBuckets ? 1ull << (b + 1) : UINT64_MAX;
+      }
+    }
+    return UINT64_MAX;
+  }
+
+  /// Returns the percentage of time threads were idle in the given
+  /// operation, while the slowest thread was still busy:
+  /// `100 * (1 - mean / max)` of the execution times of all threads.
+  double GetLoadImbalance(const std::string& op_name) const {
+    auto it = indices_.find(op_name);
+    if (it == indices_.end()) {
+      return 0;
+    }
+    auto& times = thread_totals_[it->second];
+    uint64_t total = 0;
+    uint64_t max = 0;
+    for (auto time : times) {
+      total += time;
+      max = std::max(max, time);
+    }
+    if (max == 0) {
+      return 0;
+    }
+    return 100 * (1 - static_cast<double>(total) / times.size() / max);
+  }
+
+ private:
+  struct Counters {
+    uint64_t time_ = 0;
+    uint64_t count_ = 0;
+    std::array<uint64_t, kNumBuckets> histogram_ = {};
+
+    void Add(uint64_t ns) {
+      time_ += ns;
+      count_++;
+      histogram_[ns != 0 ? 63 - __builtin_clzll(ns) : 0]++;
+    }
+
+    void Add(const Counters& other) {
+      time_ += other.time_;
+      count_ += other.count_;
+      for (uint64_t b = 0; b < kNumBuckets; b++) {
+        histogram_[b] += other.histogram_[b];
+      }
+    }
+  };
+
+  /// Operation names in the order of their first instrumentation
+  std::vector<std::string> names_;
+  std::map<std::string, uint64_t> indices_;
+  /// Counters of the current step for each thread and operation
+  std::vector<std::vector<Counters>> thread_counters_;
+  /// Counters of all merged steps for each operation
+  std::vector<Counters> totals_;
+  /// Execution time of all merged steps for each operation and thread
+  std::vector<std::vector<uint64_t>> thread_totals_;
+
+  uint64_t GetIndex(const std::string& op_name) {
+    auto it = indices_.find(op_name);
+    if (it != indices_.end()) {
+      return it->second;
+    }
+    auto idx = names_.size();
+    names_.push_back(op_name);
+    indices_[op_name] = idx;
+    for (auto& counters : thread_counters_) {
+      counters.resize(idx + 1);
+    }
+    totals_.resize(idx + 1);
+    thread_totals_.emplace_back(thread_counters_.size(), 0);
+    return idx;
+  }
+
+  const Counters* GetTotals(const std::string& op_name) const {
+    auto it = indices_.find(op_name);
+    return it != indices_.end() ? &totals_[it->second] : nullptr;
+  }
+
+  friend std::ostream& operator<<(std::ostream& os,
+                                  const OperationStatistics& stats);
+};
+
+inline std::ostream& operator<<(std::ostream& os,
+                                const OperationStatistics& stats) {
+  if (stats.names_.size() == 0) {
+    return os;
+  }
+  os << "\033[1mOperations on simulation objects (total / calls / mean / "
+        "percentiles of single calls / thread load imbalance):\033[0m"
+     << std::endl;
+  for (auto& name : stats.names_) {
+    auto count = stats.GetCount(name);
+    auto total = stats.GetTotalTime(name);
+    os << name << ": " << total / 1e6 << " ms / " << count << " calls / "
+       << (count != 0 ? total / count : 0) << " ns"
+       << " / p50 <= " << stats.GetPercentile(name, 0.5) << " ns"
+       << ", p90 <= " << stats.GetPercentile(name, 0.9) << " ns"
+       << ", p99 <= " << stats.GetPercentile(name, 0.99) << " ns"
+       << " / " << stats.GetLoadImbalance(name) << " %" << std::endl;
+  }
+  return os;
+}
+
+}  // namespace bdm
+
+#endif  // CORE_OPERATION_OPERATION_STATISTICS_H_
@@ -57,6 +57,10 @@ void Param::AssignFromConfig(const std::shared_ptr<cpptoml::table>& config) {
   BDM_ASSIGN_CONFIG_VALUE(backup_file_, "simulation.backup_file");
   BDM_ASSIGN_CONFIG_VALUE(restore_file_, "simulation.restore_file");
   BDM_ASSIGN_CONFIG_VALUE(backup_interval_, "simulation.backup_interval");
+  BDM_ASSIGN_CONFIG_VALUE(backup_interval_steps_,
+                          "simulation.backup_interval_steps");
+  BDM_ASSIGN_CONFIG_VALUE(async_backup_, "simulation.async_backup");
+  BDM_ASSIGN_CONFIG_VALUE(native_backup_, "simulation.native_backup");
   BDM_ASSIGN_CONFIG_VALUE(simulation_time_step_, "simulation.time_step");
   BDM_ASSIGN_CONFIG_VALUE(simulation_max_displacement_,
                           "simulation.max_displacement");
@@ -146,9 +150,27 @@ void Param::AssignFromConfig(const std::shared_ptr<cpptoml::table>& config) {
   // performance group
   BDM_ASSIGN_CONFIG_VALUE(scheduling_batch_size_,
                           "performance.scheduling_batch_size");
+  BDM_ASSIGN_CONFIG_VALUE(adaptive_scheduling_batch_size_,
+                          "performance.adaptive_scheduling_batch_size");
   BDM_ASSIGN_CONFIG_VALUE(detect_static_sim_objects_,
                           "performance.detect_static_sim_objects");
   BDM_ASSIGN_CONFIG_VALUE(cache_neighbors_, "performance.cache_neighbors");
+  BDM_ASSIGN_CONFIG_VALUE(incremental_grid_update_,
+                          "performance.incremental_grid_update");
+  BDM_ASSIGN_CONFIG_VALUE(compact_grid_layout_,
+                          "performance.compact_grid_layout");
+  BDM_ASSIGN_CONFIG_VALUE(grid_box_length_factor_,
+                          "performance.grid_box_length_factor");
+  BDM_ASSIGN_CONFIG_VALUE(half_shell_displacement_,
+                          "performance.half_shell_displacement");
+  BDM_ASSIGN_CONFIG_VALUE(verlet_lists_, "performance.verlet_lists");
+  BDM_ASSIGN_CONFIG_VALUE(verlet_skin_, "performance.verlet_skin");
+  BDM_ASSIGN_CONFIG_VALUE(spatial_index_, "performance.spatial_index");
+  BDM_ASSIGN_CONFIG_VALUE(box_coloring_, "performance.box_coloring");
+  BDM_ASSIGN_CONFIG_VALUE(numa_rebalancing_frequency_,
+                          "performance.numa_rebalancing_frequency");
+  BDM_ASSIGN_CONFIG_VALUE(numa_rebalancing_threshold_,
+                          "performance.numa_rebalancing_threshold");
 
   // development group
   BDM_ASSIGN_CONFIG_VALUE(statistics_, "development.statistics");
@@ -98,6 +98,37 @@ struct Param {
   ///     backup_interval = 1800  # backup every half an hour
   uint32_t backup_interval_ = 1800;
 
+  /// Specifies the interval (in simulation steps) in which backups will be
+  /// performed. If it is not zero, it replaces the time based
+  /// `backup_interval_`. In contrast to the latter, backups are created at
+  /// the same simulation steps in each run.\n
+  /// Default Value: `0` (use `backup_interval_`)\n
+  /// TOML config file:
+  ///
+  ///     [simulation]
+  ///     backup_interval_steps = 1000
+  uint64_t backup_interval_steps_ = 0;
+
+  /// If enabled, backups are written in the background while the simulation
+  /// continues (see `SimulationBackup::BackupAsync`).\n
+  /// Default Value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [simulation]
+  ///     async_backup = false
+  bool async_backup_ = false;
+
+  /// If enabled, backups are written in the native binary format of
+  /// `Checkpoint` instead of a ROOT file. It is written and restored in
+  /// parallel, but does not include the random number generator state and
+  /// parameters. The format of a restore file is detected automatically.\n
+  /// Default Value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [simulation]
+  ///     native_backup = false
+  bool native_backup_ = false;
+
   /// Time between two simulation steps, in hours.
   /// Default value: `0.01`\n
   /// TOML config file:
@@ -268,6 +299,18 @@ struct Param {
   ///     scheduling_batch_size = 1000
   uint64_t scheduling_batch_size_ = 1000;
 
+  /// If enabled, the `Scheduler` measures the execution time of each batch
+  /// and adjusts the batch size after each iteration (see
+  /// `BatchSizeTuner`). `scheduling_batch_size_` is used as initial value.
+  /// The chosen batch sizes and the load imbalance are reported in the
+  /// statistics output (see `statistics_`).\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     adaptive_scheduling_batch_size = false
+  bool adaptive_scheduling_batch_size_ = false;
+
   /// Calculation of the displacement (mechanical interaction) is an
   /// expensive operation. If simulation objects do not move or grow,
   /// displacement calculation is ommited if detect_static_sim_objects is turned
@@ -291,6 +334,155 @@ struct Param {
   ///     cache_neighbors = false
   bool cache_neighbors_ = false;
 
+  /// Update the neighbor grid incrementally. Instead of rebuilding the grid
+  /// from scratch at every time step, only simulation objects that moved to
+  /// a different box are relinked. The grid is still rebuilt if simulation
+  /// objects leave the current grid dimensions or if the box length changes.
+  /// Beneficial for simulations in which most simulation objects remain
+  /// in the same box between two time steps.\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     incremental_grid_update = false
+  bool incremental_grid_update_ = false;
+
+  /// Selects the memory layout of the neighbor grid. If turned off, the
+  /// simulation objects of each box are stored in a linked list. If turned
+  /// on, the grid is built with a parallel counting sort: all SoHandles are
+  /// stored contiguously, sorted by box index (compressed sparse row
+  /// layout). Neighbor searches therefore iterate over one contiguous range
+  /// per neighbor box instead of following the successors of a linked list.\n
+  /// The compact layout is always rebuilt from scratch
+  /// (see `incremental_grid_update_`).\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     compact_grid_layout = false
+  bool compact_grid_layout_ = false;
+
+  /// Length of a neighbor grid box relative to the size of the largest
+  /// simulation object (`box_length = ceil(factor * largest_object_size)`).
+  /// By default, boxes are as large as the largest simulation object and the
+  /// neighbor search considers the 26 surrounding boxes. Smaller values
+  /// reduce the number of distance calculations in simulations with
+  /// heterogeneous object sizes (e.g. one large soma and many small neurite
+  /// elements). The neighbor search then walks all boxes that can contain
+  /// objects within the size of the largest object, which requires
+  /// more boxes and therefore more memory.\n
+  /// Values must be in the range (0, 1].\n
+  /// Default value: `1.0`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     grid_box_length_factor = 1.0
+  double grid_box_length_factor_ = 1.0;
+
+  /// Calculates the mechanical interactions between simulation objects with a
+  /// half-shell traversal of the neighbor grid. Each pairwise force is only
+  /// calculated once and applied to both simulation objects with opposite
+  /// sign. The displacement of all simulation objects is calculated after
+  /// all other operations of a time step, based on the positions at this
+  /// point in time (instead of the positions at the time a simulation object
+  /// is updated).\n
+  /// Currently only supports spherical shapes and the CPU implementation.\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     half_shell_displacement = false
+  bool half_shell_displacement_ = false;
+
+  /// Stores a persistent neighbor list for each simulation object. The lists
+  /// contain all simulation objects within `largest_object_size +
+  /// verlet_skin` and are reused in subsequent iterations. Neighbor searches
+  /// iterate over the list instead of the grid boxes. Lists (and the grid)
+  /// are only rebuilt if a simulation object moved more than half of the
+  /// skin distance since the last build, if simulation objects have been
+  /// added or removed, or if a simulation object grew larger than the
+  /// largest object at build time.\n
+  /// Assumes that simulation objects do not move further than
+  /// `simulation_max_displacement_` within one iteration.\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     verlet_lists = false
+  bool verlet_lists_ = false;
+
+  /// Skin distance of the Verlet neighbor lists (see `verlet_lists_`).
+  /// Larger values lead to fewer rebuilds, but longer neighbor lists.
+  /// Must be larger than `2 * simulation_max_displacement_`.\n
+  /// Default value: `10.0`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     verlet_skin = 10.0
+  double verlet_skin_ = 10.0;
+
+  /// Data structure that answers neighbor queries.\n
+  /// `uniform_grid`: divides the simulation space into boxes with the size
+  /// of the largest object (see `Grid`). Memory consumption scales with the
+  /// volume of the simulation space.\n
+  /// `kd_tree`: balanced kd-tree (see `KdTree`). Memory consumption scales
+  /// with the number of simulation objects. Therefore, it is better suited
+  /// for sparse, highly clustered populations. The options
+  /// `incremental_grid_update_`, `compact_grid_layout_`, `verlet_lists_`,
+  /// and `half_shell_displacement_` only apply to the uniform grid.\n
+  /// Default value: `uniform_grid`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     spatial_index = "uniform_grid"
+  std::string spatial_index_ = "uniform_grid";
+
+  /// Protects the neighborhood of simulation objects by graph coloring of
+  /// the uniform grid instead of neighbor mutexes. The grid is partitioned
+  /// into super-boxes of `2 * Grid::GetStencilRadius()` boxes along each
+  /// axis, which are assigned one of eight colors like a 3D checkerboard.
+  /// The scheduler processes one color after the other. Simulation objects
+  /// in super-boxes of the same color can be updated in parallel without
+  /// any locks. Falls back to neighbor mutexes if the `kd_tree` is used as
+  /// spatial index (see `spatial_index_`).\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     box_coloring = false
+  bool box_coloring_ = false;
+
+  /// Simulation objects are appended to the NUMA node of the thread that
+  /// created them. Over time, the number of simulation objects per NUMA node
+  /// diverges and neighbors are scattered in memory. Every
+  /// `numa_rebalancing_frequency` iterations, the scheduler therefore sorts
+  /// all simulation objects along the Z-order curve of the spatial index and
+  /// distributes them evenly across NUMA nodes
+  /// (see `ResourceManager::SortAndBalanceNumaNodes`).
+  /// The value `0` turns periodic rebalancing off.\n
+  /// The time spent is reported as `numa rebalancing` in the statistics
+  /// (see `statistics_`).\n
+  /// Default value: `0`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     numa_rebalancing_frequency = 0
+  uint64_t numa_rebalancing_frequency_ = 0;
+
+  /// Triggers the rebalancing described in `numa_rebalancing_frequency_`
+  /// as soon as either of the following metrics exceeds this threshold:\n
+  /// `ResourceManager::GetNumaImbalance`: relative deviation of the number
+  /// of simulation objects on a NUMA node from its balanced share.\n
+  /// `ResourceManager::GetUnsortedFraction`: fraction of simulation objects
+  /// that have been added since the last rebalancing.\n
+  /// The value `0` turns threshold based rebalancing off.\n
+  /// Default value: `0`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     numa_rebalancing_threshold = 0
+  double numa_rebalancing_threshold_ = 0;
+
   // development values --------------------------------------------------------
   /// Statistics of profiling data; keeps track of the execution time of each
   /// operation at every timestep.\n
@@ -13,7 +13,12 @@
 // -----------------------------------------------------------------------------
 
 #include "core/resource_manager.h"
-#include "core/grid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include "core/spatial_index.h"
 
 namespace bdm {
 
@@ -39,8 +44,51 @@ void ResourceManager::ApplyOnAllElementsParallel(
   }
 }
 
+namespace {
+
+/// Chunks [begin, end) of the simulation objects on one numa node. Packed
+/// into a single word, such that the owning thread and thieves can modify
+/// it with one compare-and-swap.
+struct WorkRange {
+  static constexpr uint64_t kNumaNodeBits = SoHandle::kNumaNodeBits;
+  static constexpr uint64_t kChunkBits = (64 - kNumaNodeBits) / 2;
+  static constexpr uint64_t kChunkMask = (1ull << kChunkBits) - 1;
+
+  uint64_t numa_node;
+  uint64_t begin;
+  uint64_t end;
+
+  static uint64_t Pack(uint64_t numa_node, uint64_t begin, uint64_t end) {
+    return (numa_node << (2 * kChunkBits)) | (begin << kChunkBits) | end;
+  }
+
+  static WorkRange Unpack(uint64_t word) {
+    return {word >> (2 * kChunkBits), (word >> kChunkBits) & kChunkMask,
+            word & kChunkMask};
+  }
+};
+
+/// Work range and measurements of one thread. Padded to avoid false sharing
+/// between threads.
+struct PaddedWorkRange {
+  std::atomic<uint64_t> range_;
+  uint64_t busy_time_;
+  uint64_t num_chunks_;
+  uint64_t num_steals_;
+  uint64_t task_time_;
+  char padding_[64 - sizeof(std::atomic<uint64_t>) - 4 * sizeof(uint64_t)];
+};
+
+}  // namespace
+
 void ResourceManager::ApplyOnAllElementsParallelDynamic(
-    uint64_t chunk, const std::function<void(SimObject*, SoHandle)>& function) {
+    uint64_t chunk, const std::function<void(SimObject*, SoHandle)>& function,
+    ParallelLoopStatistics* statistics,
+    const std::vector<std::function<void()>>& tasks) {
+  using Clock = std::chrono::steady_clock;
+  using std::chrono::nanoseconds;
+  using std::chrono::duration_cast;
+
   // adapt chunk size
   auto num_so = GetNumSimObjects();
   uint64_t factor = (num_so / thread_info_->GetMaxThreads()) / chunk;
@@ -53,86 +101,301 @@ void ResourceManager::ApplyOnAllElementsParallelDynamic(
   // different containers
   auto numa_nodes = thread_info_->GetNumaNodes();
   auto max_threads = omp_get_max_threads();
+  for (int n = 0; n < numa_nodes; n++) {
+    // `WorkRange` can only encode `kChunkMask` chunks per numa node
+    auto min_chunk = sim_objects_[n].size() / WorkRange::kChunkMask + 1;
+    chunk = std::max<uint64_t>(chunk, min_chunk);
+  }
   std::vector<uint64_t> num_chunks_per_numa(numa_nodes);
   for (int n = 0; n < numa_nodes; n++) {
     auto correction = sim_objects_[n].size() % chunk == 0 ? 0 : 1;
     num_chunks_per_numa[n] = sim_objects_[n].size() / chunk + correction;
   }
 
-  std::vector<std::atomic<uint64_t>*> counters(max_threads, nullptr);
-  std::vector<uint64_t> max_counters(max_threads);
-  for (int thread_cnt = 0; thread_cnt < max_threads; thread_cnt++) {
-    uint64_t current_nid = thread_info_->GetNumaNode(thread_cnt);
-
+  // Each thread starts with an equal share of the chunks of its numa node
+  std::vector<PaddedWorkRange> ranges(max_threads);
+  // Threads steal from threads of the same numa node first
+  std::vector<std::vector<int>> victims(max_threads);
+  for (int tid = 0; tid < max_threads; tid++) {
+    int nid = thread_info_->GetNumaNode(tid);
+    auto threads_in_numa = thread_info_->GetThreadsInNumaNode(nid);
     auto correction =
-        num_chunks_per_numa[current_nid] %
-                    thread_info_->GetThreadsInNumaNode(current_nid) ==
-                0
-            ? 0
-            : 1;
+        num_chunks_per_numa[nid] % threads_in_numa == 0 ? 0 : 1;
     uint64_t num_chunks_per_thread =
-        num_chunks_per_numa[current_nid] /
-            thread_info_->GetThreadsInNumaNode(current_nid) +
-        correction;
-    auto start =
-        num_chunks_per_thread * thread_info_->GetNumaThreadId(thread_cnt);
-    auto end = std::min(num_chunks_per_numa[current_nid],
+        num_chunks_per_numa[nid] / threads_in_numa + correction;
+    auto start = std::min(
+        num_chunks_per_numa[nid],
+        num_chunks_per_thread * thread_info_->GetNumaThreadId(tid));
+    auto end = std::min(num_chunks_per_numa[nid],
                         start + num_chunks_per_thread);
-
-    counters[thread_cnt] = new std::atomic<uint64_t>(start);
-    max_counters[thread_cnt] = end;
+    ranges[tid].range_ = WorkRange::Pack(nid, start, end);
+    ranges[tid].busy_time_ = 0;
+    ranges[tid].num_chunks_ = 0;
+    ranges[tid].num_steals_ = 0;
+    ranges[tid].task_time_ = 0;
+
+    for (int n = 0; n < numa_nodes; n++) {
+      int victim_nid = (nid + n) % numa_nodes;
+      for (int i = 1; i < max_threads; i++) {
+        int victim = (tid + i) % max_threads;
+        if (thread_info_->GetNumaNode(victim) == victim_nid) {
+          victims[tid].push_back(victim);
+        }
+      }
+    }
   }
 
+  std::atomic<uint64_t> next_task(0);
+
 #pragma omp parallel
   {
     auto tid = omp_get_thread_num();
-    auto nid = thread_info_->GetNumaNode(tid);
-
-    // thread private variables (compilation error with
-    // firstprivate(chunk, numa_node_) with some openmp versions clause)
-    auto p_numa_nodes = thread_info_->GetNumaNodes();
-    auto p_max_threads = omp_get_max_threads();
-    auto p_chunk = chunk;
     assert(thread_info_->GetNumaNode(tid) == numa_node_of_cpu(sched_getcpu()));
+    auto& own = ranges[tid].range_;
+    bool measure = statistics != nullptr;
+
+    for (uint64_t t = next_task++; t < tasks.size(); t = next_task++) {
+      auto task_start = measure ? Clock::now() : Clock::time_point();
+      tasks[t]();
+      if (measure) {
+        auto duration = duration_cast<nanoseconds>(Clock::now() - task_start);
+        ranges[tid].busy_time_ += duration.count();
+        ranges[tid].task_time_ += duration.count();
+      }
+    }
 
-    // dynamic scheduling
-    uint64_t start = 0;
-    uint64_t end = 0;
-
-    // this loop implements work stealing from other NUMA nodes if there
-    // are imbalances. Each thread starts with its NUMA domain. Once, it
-    // is finished the thread looks for tasks on other domains
-    for (int n = 0; n < p_numa_nodes; n++) {
-      int current_nid = (nid + n) % p_numa_nodes;
-      for (int thread_cnt = 0; thread_cnt < p_max_threads; thread_cnt++) {
-        uint64_t current_tid = (tid + thread_cnt) % p_max_threads;
-        if (current_nid != thread_info_->GetNumaNode(current_tid)) {
-          continue;
-        }
-
-        auto& numa_sos = sim_objects_[current_nid];
-        uint64_t old_count = (*(counters[current_tid]))++;
-        while (old_count < max_counters[current_tid]) {
-          start = old_count * p_chunk;
-          end =
-              std::min(static_cast<uint64_t>(numa_sos.size()), start + p_chunk);
-
+    while (true) {
+      // take chunks from the front of the own range
+      uint64_t word = own.load();
+      auto r = WorkRange::Unpack(word);
+      if (r.begin < r.end) {
+        auto next = WorkRange::Pack(r.numa_node, r.begin + 1, r.end);
+        if (own.compare_exchange_weak(word, next)) {
+          auto chunk_start = measure ? Clock::now() : Clock::time_point();
+          auto& numa_sos = sim_objects_[r.numa_node];
+          auto start = r.begin * chunk;
+          auto end = std::min<uint64_t>(numa_sos.size(), start + chunk);
           for (uint64_t i = start; i < end; ++i) {
-            function(numa_sos[i], SoHandle(current_nid, i));
+            function(numa_sos[i], SoHandle(r.numa_node, i));
+          }
+          if (measure) {
+            auto duration = Clock::now() - chunk_start;
+            ranges[tid].busy_time_ +=
+                duration_cast<nanoseconds>(duration).count();
+            ranges[tid].num_chunks_++;
           }
+        }
+        continue;
+      }
 
-          old_count = (*(counters[current_tid]))++;
+      // own range is empty: steal the upper half of the range of a victim
+      bool stolen = false;
+      for (int victim : victims[tid]) {
+        auto& other = ranges[victim].range_;
+        uint64_t victim_word = other.load();
+        auto v = WorkRange::Unpack(victim_word);
+        while (v.begin < v.end) {
+          auto mid = v.begin + (v.end - v.begin) / 2;
+          auto remaining = WorkRange::Pack(v.numa_node, v.begin, mid);
+          if (other.compare_exchange_weak(victim_word, remaining)) {
+            // Nobody modifies an empty range. Hence, a plain store suffices.
+            own.store(WorkRange::Pack(v.numa_node, mid, v.end));
+            ranges[tid].num_steals_++;
+            stolen = true;
+            break;
+          }
+          v = WorkRange::Unpack(victim_word);
+        }
+        if (stolen) {
+          break;
         }
-      }  // work stealing loop numa_nodes_
-    }    // work stealing loop  threads
+      }
+      if (!stolen) {
+        break;
+      }
+    }
   }
 
-  for (auto* counter : counters) {
-    delete counter;
+  if (statistics != nullptr) {
+    statistics->num_sim_objects_ = num_so;
+    statistics->chunk_ = chunk;
+    statistics->num_chunks_ = 0;
+    statistics->num_steals_ = 0;
+    statistics->task_time_ = 0;
+    statistics->busy_time_.resize(max_threads);
+    for (int tid = 0; tid < max_threads; tid++) {
+      statistics->num_chunks_ += ranges[tid].num_chunks_;
+      statistics->num_steals_ += ranges[tid].num_steals_;
+      statistics->busy_time_[tid] = ranges[tid].busy_time_;
+      statistics->task_time_ += ranges[tid].task_time_;
+    }
   }
 }
 
-void ResourceManager::SortAndBalanceNumaNodes() {
+void ResourceManager::UpdateSoAStore() {
+  auto numa_nodes = sim_objects_.size();
+  bool incremental = soa_in_sync_ && soa_positions_.size() == numa_nodes;
+  soa_in_sync_ = false;
+  soa_positions_.resize(numa_nodes);
+  soa_diameters_.resize(numa_nodes);
+  soa_box_indices_.resize(numa_nodes);
+  NextSoAEpoch();
+  // simulation objects that have been appended since the last call
+  std::vector<uint64_t> first_added(numa_nodes, 0);
+  for (uint64_t n = 0; n < numa_nodes; n++) {
+    auto num_sos = sim_objects_[n].size();
+    first_added[n] = soa_positions_[n].size();
+    if (first_added[n] > num_sos) {
+      // simulation objects have been removed without revoking
+      // `SetSoAStoreInSync`
+      incremental = false;
+    }
+    if (soa_positions_[n].capacity() < num_sos) {
+      // `ParallelResizeVector` does not preserve its elements if it
+      // reallocates. Leave room for simulation objects that are added in
+      // the following iterations to keep them incremental.
+      incremental = false;
+      auto capacity = num_sos + num_sos / 2;
+      soa_positions_[n].reserve(capacity);
+      soa_diameters_[n].reserve(capacity);
+      soa_box_indices_[n].reserve(capacity);
+    }
+    soa_positions_[n].resize(num_sos);
+    soa_diameters_[n].resize(num_sos);
+    soa_box_indices_[n].resize(num_sos);
+  }
+  if (!incremental) {
+    soa_outdated_.clear();
+    ApplyOnAllElementsParallelDynamic(
+        1000,
+        [this](SimObject* so, SoHandle soh) { UpdateSoAStore(so, soh); });
+    return;
+  }
+
+  for (uint64_t n = 0; n < numa_nodes; n++) {
+    int64_t begin = first_added[n];
+    int64_t end = sim_objects_[n].size();
+#pragma omp parallel for
+    for (int64_t i = begin; i < end; i++) {
+      UpdateSoAStore(sim_objects_[n][i], SoHandle(n, i));
+    }
+  }
+  // `MarkSoAEntryOutdated` returns each handle only once
+  int64_t num_outdated = soa_outdated_.size();
+#pragma omp parallel for
+  for (int64_t i = 0; i < num_outdated; i++) {
+    auto soh = soa_outdated_[i];
+    UpdateSoAStore(GetSimObjectWithSoHandle(soh), soh);
+  }
+  soa_outdated_.clear();
+}
+
+void ResourceManager::NextSoAEpoch() {
+  auto numa_nodes = sim_objects_.size();
+  soa_epochs_.resize(numa_nodes);
+  if (++soa_epoch_ == 0) {
+    // overflow: reset all epochs
+    soa_epoch_ = 1;
+    for (auto& epochs : soa_epochs_) {
+      epochs = std::vector<std::atomic<uint32_t>>(epochs.size());
+    }
+  }
+  for (uint64_t n = 0; n < numa_nodes; n++) {
+    auto num_sos = sim_objects_[n].size();
+    if (soa_epochs_[n].size() < num_sos) {
+      // leave room for simulation objects that are added later
+      auto capacity = num_sos + num_sos / 2;
+      soa_epochs_[n] = std::vector<std::atomic<uint32_t>>(capacity);
+    }
+  }
+}
+
+void ResourceManager::RemoveSimObjects(const std::vector<SoUid>& uids) {
+  auto numa_nodes = sim_objects_.size();
+  soa_in_sync_ = false;
+  std::vector<std::vector<char>> remove(numa_nodes);
+  std::vector<uint64_t> first_removed(numa_nodes,
+                                      std::numeric_limits<uint64_t>::max());
+  for (uint64_t n = 0; n < numa_nodes; n++) {
+    remove[n].resize(sim_objects_[n].size(), 0);
+  }
+
+  // mark simulation objects
+  // `uids` might contain duplicates
+  for (auto uid : uids) {
+    auto soh = uid_soh_map_[uid];
+    if (soh == SoHandle()) {
+      continue;
+    }
+    uid_soh_map_.Remove(uid);
+    auto n = soh.GetNumaNode();
+    remove[n][soh.GetElementIdx()] = 1;
+    first_removed[n] = std::min<uint64_t>(first_removed[n],
+                                          soh.GetElementIdx());
+  }
+
+  for (uint64_t n = 0; n < numa_nodes; n++) {
+    auto& numa_sos = sim_objects_[n];
+    auto begin = first_removed[n];
+    if (begin == std::numeric_limits<uint64_t>::max()) {
+      continue;
+    }
+    auto num_elements = numa_sos.size() - begin;
+    // number of remaining elements in all preceding blocks
+    std::vector<uint64_t> offsets(omp_get_max_threads() + 1);
+    std::vector<SimObject*> remaining;
+
+#pragma omp parallel
+    {
+      auto tid = omp_get_thread_num();
+      auto nthreads = omp_get_num_threads();
+      auto block_begin = begin + num_elements * tid / nthreads;
+      auto block_end = begin + num_elements * (tid + 1) / nthreads;
+
+      uint64_t cnt = 0;
+      for (uint64_t i = block_begin; i < block_end; i++) {
+        if (remove[n][i]) {
+          delete numa_sos[i];
+        } else {
+          cnt++;
+        }
+      }
+      offsets[tid + 1] = cnt;
+
+#pragma omp barrier
+#pragma omp single
+      {
+        for (int t = 1; t <= nthreads; t++) {
+          offsets[t] += offsets[t - 1];
+        }
+        remaining.resize(offsets[nthreads]);
+      }
+
+      // compact the remaining elements and update their storage location
+      auto pos = offsets[tid];
+      for (uint64_t i = block_begin; i < block_end; i++) {
+        if (!remove[n][i]) {
+          auto* so = numa_sos[i];
+          remaining[pos] = so;
+          if (begin + pos != i) {
+            uid_soh_map_.Insert(so->GetUid(), SoHandle(n, begin + pos));
+          }
+          pos++;
+        }
+      }
+
+#pragma omp barrier
+      for (uint64_t i = offsets[tid]; i < offsets[tid + 1]; i++) {
+        numa_sos[begin + i] = remaining[i];
+      }
+    }
+
+    numa_sos.resize(begin + remaining.size());
+  }
+  uid_soh_map_.ShrinkToFit();
+}
+
+std::vector<uint64_t> ResourceManager::GetBalancedNumaShares() const {
   // balance simulation objects per numa node according to the number of
   // threads associated with each numa domain
   auto numa_nodes = thread_info_->GetNumaNodes();
@@ -146,6 +409,26 @@ void ResourceManager::SortAndBalanceNumaNodes() {
     cummulative += num_so;
   }
   so_per_numa[0] = GetNumSimObjects() - cummulative;
+  return so_per_numa;
+}
+
+double ResourceManager::GetNumaImbalance() const {
+  auto so_per_numa = GetBalancedNumaShares();
+  double imbalance = 0;
+  for (uint64_t n = 0; n < so_per_numa.size(); n++) {
+    double actual = sim_objects_[n].size();
+    double expected = so_per_numa[n];
+    double deviation = std::abs(actual - expected) / std::max(expected, 1.0);
+    imbalance = std::max(imbalance, deviation);
+  }
+  return imbalance;
+}
+
+void ResourceManager::SortAndBalanceNumaNodes() {
+  num_added_since_sort_ = 0;
+  soa_in_sync_ = false;
+  auto numa_nodes = thread_info_->GetNumaNodes();
+  auto so_per_numa = GetBalancedNumaShares();
 
   // using first touch policy - page will be allocated to the numa domain of
   // the thread that accesses it first.
@@ -177,8 +460,8 @@ void ResourceManager::SortAndBalanceNumaNodes() {
     cnt++;
   };
 
-  auto* grid = Simulation::GetActive()->GetGrid();
-  grid->IterateZOrder(rearrange);
+  auto* spatial_index = Simulation::GetActive()->GetSpatialIndex();
+  spatial_index->IterateZOrder(rearrange);
 
   for (int n = 0; n < numa_nodes; n++) {
     auto& dest = so_rearranged[n];
@@ -211,11 +494,11 @@ void ResourceManager::SortAndBalanceNumaNodes() {
         auto start = thread_info_->GetNumaThreadId(tid) * chunk;
         auto end = std::min(sohandles.size(), start + chunk);
 
+        // only the pointers are reordered; the memory of the simulation
+        // objects is migrated below
         for (uint64_t e = start; e < end; e++) {
           auto& handle = sohandles[e];
-          auto* so = sim_objects_[handle.GetNumaNode()][handle.GetElementIdx()];
-          dest[e] = so->GetCopy();
-          delete so;
+          dest[e] = sim_objects_[handle.GetNumaNode()][handle.GetElementIdx()];
         }
       }
     }
@@ -225,9 +508,12 @@ void ResourceManager::SortAndBalanceNumaNodes() {
     sim_objects_[n].swap(so_rearranged[n]);
   }
 
+  MigrateSimObjects();
+
   // update uid_soh_map_
-  ApplyOnAllElements([this](SimObject* so, SoHandle soh) {
-    this->uid_soh_map_[so->GetUid()] = soh;
+  // entries exist already; hence, `Insert` can be called in parallel
+  ApplyOnAllElementsParallelDynamic(1000, [this](SimObject* so, SoHandle soh) {
+    this->uid_soh_map_.Insert(so->GetUid(), soh);
   });
 
   if (Simulation::GetActive()->GetParam()->debug_numa_) {
@@ -235,6 +521,60 @@ void ResourceManager::SortAndBalanceNumaNodes() {
   }
 }
 
+void ResourceManager::MigrateSimObjects() {
+  auto numa_nodes = sim_objects_.size();
+  if (numa_nodes == 1) {
+    return;
+  }
+
+  // Simulation objects and biology modules that are stored on another numa
+  // node are copied into the memory pool of their new numa node by one of
+  // its threads. Migrating the memory pages instead would also move free
+  // pool elements and objects of other numa nodes that share these pages.
+#pragma omp parallel
+  {
+    auto tid = omp_get_thread_num();
+    auto nid = thread_info_->GetNumaNode(tid);
+    auto& numa_sos = sim_objects_[nid];
+    auto threads_in_numa = thread_info_->GetThreadsInNumaNode(nid);
+    auto start = thread_info_->GetNumaThreadId(tid);
+
+    std::vector<void*> addresses;
+    for (uint64_t i = start; i < numa_sos.size(); i += threads_in_numa) {
+      auto* so = numa_sos[i];
+      addresses.push_back(so);
+      for (auto* bm : so->GetAllBiologyModules()) {
+        addresses.push_back(bm);
+      }
+    }
+    // Query the numa node of each object. Pool elements never span multiple
+    // numa nodes, because whole slabs are bound to the node of their pool.
+    // Objects that are not stored in a pool are copied as a whole.
+    std::vector<int> locations(addresses.size(), nid);
+    numa_move_pages(0, addresses.size(), addresses.data(), nullptr,
+                    locations.data(), 0);
+    // negative values indicate pages that could not be queried
+    auto is_remote = [&](uint64_t idx) {
+      return locations[idx] >= 0 && locations[idx] != nid;
+    };
+
+    uint64_t idx = 0;
+    for (uint64_t i = start; i < numa_sos.size(); i += threads_in_numa) {
+      auto* so = numa_sos[i];
+      bool relocate_so = is_remote(idx++);
+      for (uint64_t b = 0; b < so->GetAllBiologyModules().size(); b++) {
+        if (is_remote(idx++)) {
+          so->RelocateBiologyModule(b);
+        }
+      }
+      if (relocate_so) {
+        numa_sos[i] = so->Relocate();
+        delete so;
+      }
+    }
+  }
+}
+
 void ResourceManager::DebugNuma() const {
   std::cout << "ResourceManager size of sim object containers\n" << std::endl;
   uint64_t cnt = 0;
@@ -19,6 +19,8 @@
 #include <sched.h>
 #include <tbb/concurrent_unordered_map.h>
 #include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <cmath>
 #include <limits>
 #include <memory>
@@ -37,6 +39,8 @@
 #endif
 #endif
 
+#include "core/container/parallel_resize_vector.h"
+#include "core/container/so_uid_map.h"
 #include "core/diffusion_grid.h"
 #include "core/sim_object/sim_object.h"
 #include "core/sim_object/so_uid.h"
@@ -48,60 +52,133 @@
 
 namespace bdm {
 
+/// Number of bits of a `SoHandle` that encode the numa node. The remaining
+/// bits encode the element index. The default supports 256 numa nodes and
+/// 2^56 simulation objects per numa node. Can be changed at build time,
+/// e.g. `-DBDM_SO_HANDLE_NUMA_NODE_BITS=4`.
+#ifndef BDM_SO_HANDLE_NUMA_NODE_BITS
+#define BDM_SO_HANDLE_NUMA_NODE_BITS 8
+#endif  // BDM_SO_HANDLE_NUMA_NODE_BITS
+
 /// Unique identifier of a simulation object. Acts as a type erased pointer.
 /// Has the same type for every simulation object. \n
 /// Points to the storage location of a sim object inside ResourceManager.\n
 /// The id is split into two parts: Numa node, element index.
 /// The first one is used to obtain the numa storage, and the second specifies
-/// the element within this vector.
+/// the element within this vector.\n
+/// Both parts are packed into one 64 bit word (see
+/// `BDM_SO_HANDLE_NUMA_NODE_BITS`). Therefore, `std::atomic<SoHandle>` is
+/// lock-free (see `Grid::Box::start_`).
 class SoHandle {
  public:
   using NumaNode_t = uint16_t;
-  using ElementIdx_t = uint32_t;
+  using ElementIdx_t = uint64_t;
+
+  static constexpr uint64_t kNumaNodeBits = BDM_SO_HANDLE_NUMA_NODE_BITS;
+  static constexpr uint64_t kElementIdxBits = 64 - kNumaNodeBits;
+  static constexpr uint64_t kElementIdxMask = (1ull << kElementIdxBits) - 1;
+  static_assert(kNumaNodeBits > 0 && kNumaNodeBits <= 16,
+                "BDM_SO_HANDLE_NUMA_NODE_BITS must be in the range [1, 16]");
+
+  /// Returns the number of numa nodes that can be encoded
+  static constexpr uint64_t GetMaxNumaNodes() { return 1ull << kNumaNodeBits; }
 
   constexpr SoHandle() noexcept
-      : numa_node_(std::numeric_limits<NumaNode_t>::max()),
-        element_idx_(std::numeric_limits<ElementIdx_t>::max()) {}
+      : handle_(std::numeric_limits<uint64_t>::max()) {}
 
-  explicit SoHandle(ElementIdx_t element_idx)
-      : numa_node_(0), element_idx_(element_idx) {}
+  explicit SoHandle(ElementIdx_t element_idx) : SoHandle(0, element_idx) {}
 
   SoHandle(NumaNode_t numa_node, ElementIdx_t element_idx)
-      : numa_node_(numa_node), element_idx_(element_idx) {}
+      : handle_((static_cast<uint64_t>(numa_node) << kElementIdxBits) |
+                (element_idx & kElementIdxMask)) {
+    assert(numa_node < GetMaxNumaNodes() && element_idx <= kElementIdxMask);
+  }
 
-  NumaNode_t GetNumaNode() const { return numa_node_; }
-  ElementIdx_t GetElementIdx() const { return element_idx_; }
-  void SetElementIdx(ElementIdx_t element_idx) { element_idx_ = element_idx; }
+  NumaNode_t GetNumaNode() const { return handle_ >> kElementIdxBits; }
+  ElementIdx_t GetElementIdx() const { return handle_ & kElementIdxMask; }
+  void SetElementIdx(ElementIdx_t element_idx) {
+    assert(element_idx <= kElementIdxMask);
+    handle_ = (handle_ & ~kElementIdxMask) | (element_idx & kElementIdxMask);
+  }
 
   bool operator==(const SoHandle& other) const {
-    return numa_node_ == other.numa_node_ && element_idx_ == other.element_idx_;
+    return handle_ == other.handle_;
   }
 
   bool operator!=(const SoHandle& other) const { return !(*this == other); }
 
+  /// The numa node is stored in the most significant bits. Hence, handles
+  /// are ordered by numa node first and element index second.
   bool operator<(const SoHandle& other) const {
-    if (numa_node_ == other.numa_node_) {
-      return element_idx_ < other.element_idx_;
-    } else {
-      return numa_node_ < other.numa_node_;
-    }
+    return handle_ < other.handle_;
   }
 
   friend std::ostream& operator<<(std::ostream& stream,
                                   const SoHandle& handle) {
-    stream << "Numa node: " << handle.numa_node_
-           << " element idx: " << handle.element_idx_;
+    stream << "Numa node: " << handle.GetNumaNode()
+           << " element idx: " << handle.GetElementIdx();
     return stream;
   }
 
  private:
-  NumaNode_t numa_node_;
+  /// numa node in the most significant `kNumaNodeBits` bits, element index
+  /// in the remaining ones
+  uint64_t handle_;
 
-  /// changed element index to uint32_t after issues with std::atomic with
-  /// size 16 -> max element_idx: 4.294.967.296
-  ElementIdx_t element_idx_;
+  BDM_CLASS_DEF_NV(SoHandle, 2);
+};
+
+static_assert(sizeof(SoHandle) == sizeof(uint64_t),
+              "SoHandle must fit into one 64 bit word");
+
+/// Measurements of one call to
+/// `ResourceManager::ApplyOnAllElementsParallelDynamic`
+struct ParallelLoopStatistics {
+  /// Number of simulation objects that have been processed
+  uint64_t num_sim_objects_ = 0;
+  /// Batch size that has been used (after adaption to the number of
+  /// simulation objects)
+  uint64_t chunk_ = 0;
+  uint64_t num_chunks_ = 0;
+  /// Number of successful steal attempts
+  uint64_t num_steals_ = 0;
+  /// Time in ns each thread spent processing chunks and independent tasks
+  std::vector<uint64_t> busy_time_;
+  /// Total time in ns spent in independent tasks
+  uint64_t task_time_ = 0;
+
+  /// Returns the total time in ns that was spent processing chunks
+  uint64_t GetChunkTime() const {
+    uint64_t total = 0;
+    for (auto time : busy_time_) {
+      total += time;
+    }
+    return total - task_time_;
+  }
+
+  /// Returns the average time in ns that was needed to process one chunk
+  double GetMeanChunkTime() const {
+    if (num_chunks_ == 0) {
+      return 0;
+    }
+    return static_cast<double>(GetChunkTime()) / num_chunks_;
+  }
 
-  BDM_CLASS_DEF_NV(SoHandle, 1);
+  /// Returns the percentage of time threads were idle, while the slowest
+  /// thread was still busy: `100 * (1 - mean / max)` of `busy_time_`.
+  double GetLoadImbalance() const {
+    uint64_t total = 0;
+    uint64_t max = 0;
+    for (auto time : busy_time_) {
+      total += time;
+      max = std::max(max, time);
+    }
+    if (max == 0) {
+      return 0;
+    }
+    double mean = static_cast<double>(total) / busy_time_.size();
+    return 100 * (1 - mean / max);
+  }
 };
 
 /// ResourceManager stores simulation objects and diffusion grids and provides
@@ -119,6 +196,12 @@ class ResourceManager {
       Log::Fatal("ResourceManager",
                  "Call to numa_available failed with return code: ", ret);
     }
+    if (static_cast<uint64_t>(numa_num_configured_nodes()) >
+        SoHandle::GetMaxNumaNodes()) {
+      Log::Fatal("ResourceManager", "SoHandle can only encode ",
+                 SoHandle::GetMaxNumaNodes(), " numa nodes. Please increase ",
+                 "BDM_SO_HANDLE_NUMA_NODE_BITS.");
+    }
     sim_objects_.resize(numa_num_configured_nodes());
   }
 
@@ -148,6 +231,7 @@ class ResourceManager {
     }
     sim_objects_ = std::move(other.sim_objects_);
     diffusion_grids_ = std::move(other.diffusion_grids_);
+    soa_in_sync_ = false;
 
     RestoreUidSoMap();
     return *this;
@@ -159,17 +243,16 @@ class ResourceManager {
     for (unsigned n = 0; n < sim_objects_.size(); ++n) {
       for (unsigned i = 0; i < sim_objects_[n].size(); ++i) {
         auto* so = sim_objects_[n][i];
-        this->uid_soh_map_[so->GetUid()] = SoHandle(n, i);
+        uid_soh_map_.Insert(so->GetUid(), SoHandle(n, i));
       }
     }
   }
 
   SimObject* GetSimObject(SoUid uid) {
-    auto search_it = uid_soh_map_.find(uid);
-    if (search_it == uid_soh_map_.end()) {
+    SoHandle soh = uid_soh_map_[uid];
+    if (soh == SoHandle()) {
       return nullptr;
     }
-    SoHandle soh = search_it->second;
     return sim_objects_[soh.GetNumaNode()][soh.GetElementIdx()];
   }
 
@@ -177,7 +260,8 @@ class ResourceManager {
     return sim_objects_[soh.GetNumaNode()][soh.GetElementIdx()];
   }
 
-  SoHandle GetSoHandle(SoUid uid) { return uid_soh_map_[uid]; }
+  /// Returns `SoHandle()` if there is no simulation object with `uid`
+  SoHandle GetSoHandle(SoUid uid) const { return uid_soh_map_[uid]; }
 
   void AddDiffusionGrid(DiffusionGrid* dgrid) {
     uint64_t substance_id = dgrid->GetSubstanceId();
@@ -284,13 +368,120 @@ class ResourceManager {
   /// Apply a function on all elements.\n
   /// Function invocations are parallelized.\n
   /// Uses dynamic scheduling and work stealing. Batch size controlled by
-  /// `chunk`.
+  /// `chunk`.\n
+  /// Each thread starts with an equal share of the chunks of its numa node
+  /// and processes them from the front. Threads that run out of work steal
+  /// the upper half of the remaining chunks of another thread. Threads of
+  /// the same numa node are visited first.
   /// \param chunk number of sim objects that are assigned to a thread (batch
   /// size)
+  /// \param statistics if not null, the execution is measured and the
+  /// results are stored in this object (see `Scheduler` and
+  /// `BatchSizeTuner`)
+  /// \param tasks functions that are independent of `function` and of each
+  /// other. They are executed by the same threads concurrently with
+  /// `function`. Each task is executed by one thread. Threads take tasks
+  /// before they start with their own chunks; meanwhile, other threads steal
+  /// these chunks.
   /// \see ApplyOnAllElements
   void ApplyOnAllElementsParallelDynamic(
-      uint64_t chunk,
-      const std::function<void(SimObject*, SoHandle)>& function);
+      uint64_t chunk, const std::function<void(SimObject*, SoHandle)>& function,
+      ParallelLoopStatistics* statistics = nullptr,
+      const std::vector<std::function<void()>>& tasks = {});
+
+  /// Copies position, diameter and box index of all simulation objects into
+  /// contiguous arrays (structure of arrays), which are indexed by SoHandle.
+  /// Loops of the spatial index over these attributes can therefore stream
+  /// through memory instead of dereferencing each simulation object.\n
+  /// Must be called after simulation objects have been added, removed or
+  /// reordered. The spatial index calls it at the beginning of each update.
+  /// Afterwards, the scheduler keeps the arrays in sync by calling
+  /// `UpdateSoAStore(so, soh)` after each simulation object update.\n
+  /// If `SetSoAStoreInSync` has been called since the last call, only
+  /// simulation objects that have been added or marked with
+  /// `MarkSoAEntryOutdated` are copied. Otherwise, all of them.
+  void UpdateSoAStore();
+
+  /// Declares that the structure of arrays is up to date, and that all
+  /// simulation objects that are modified afterwards are either copied with
+  /// `UpdateSoAStore(so, soh)` or marked with `MarkSoAEntryOutdated`. Called
+  /// by the scheduler after the spatial index has been updated.
+  /// Removing or reordering simulation objects revokes this declaration.
+  void SetSoAStoreInSync() {
+    // `UpdateSoAStore()` must have been called at least once
+    soa_in_sync_ = soa_epochs_.size() == sim_objects_.size();
+  }
+
+  /// Marks the structure of arrays entry of `soh` as outdated (e.g. a
+  /// simulation object that might be modified by a neighbor). Returns true
+  /// if `soh` must be passed to `AddOutdatedSoAEntries`, i.e. only for the
+  /// first call per handle since the last `UpdateSoAStore()` and only while
+  /// the structure of arrays is declared in sync. Thread-safe.
+  bool MarkSoAEntryOutdated(SoHandle soh) {
+    if (!soa_in_sync_) {
+      return false;
+    }
+    auto nid = soh.GetNumaNode();
+    auto idx = soh.GetElementIdx();
+    // simulation objects added after the last `UpdateSoAStore()` are
+    // copied anyway
+    return idx < soa_positions_[nid].size() &&
+           soa_epochs_[nid][idx].exchange(
+               soa_epoch_, std::memory_order_relaxed) != soa_epoch_;
+  }
+
+  /// Adds handles returned by `MarkSoAEntryOutdated`. They are copied during
+  /// the next `UpdateSoAStore()`.\n
+  /// NB: This method is not thread-safe!
+  void AddOutdatedSoAEntries(const std::vector<SoHandle>& handles) {
+    if (soa_in_sync_) {
+      soa_outdated_.insert(soa_outdated_.end(), handles.begin(), handles.end());
+    }
+  }
+
+  /// Copies the attributes of the given simulation object into the structure
+  /// of arrays (see `UpdateSoAStore()`). This function is thread-safe for
+  /// different SoHandles.
+  void UpdateSoAStore(const SimObject* so, SoHandle soh) {
+    auto nid = soh.GetNumaNode();
+    auto idx = soh.GetElementIdx();
+    soa_positions_[nid][idx] = so->GetPosition();
+    soa_diameters_[nid][idx] = so->GetDiameter();
+    soa_box_indices_[nid][idx] = so->GetBoxIdx();
+  }
+
+  /// Returns the position of the simulation object with the given SoHandle
+  /// at the time of the last `UpdateSoAStore` call.
+  const Double3& GetSoAPosition(SoHandle soh) const {
+    return soa_positions_[soh.GetNumaNode()][soh.GetElementIdx()];
+  }
+
+  /// Returns the diameter of the simulation object with the given SoHandle
+  /// at the time of the last `UpdateSoAStore` call.
+  double GetSoADiameter(SoHandle soh) const {
+    return soa_diameters_[soh.GetNumaNode()][soh.GetElementIdx()];
+  }
+
+  /// Returns the box index of the simulation object with the given SoHandle.
+  uint32_t GetSoABoxIdx(SoHandle soh) const {
+    return soa_box_indices_[soh.GetNumaNode()][soh.GetElementIdx()];
+  }
+
+  void SetSoABoxIdx(SoHandle soh, uint32_t box_idx) {
+    soa_box_indices_[soh.GetNumaNode()][soh.GetElementIdx()] = box_idx;
+  }
+
+  /// Returns the positions of all simulation objects in the given numa node.
+  /// Contains `GetNumSimObjects(numa_node)` elements.
+  const Double3* GetSoAPositions(int numa_node) const {
+    return soa_positions_[numa_node].data();
+  }
+
+  /// Returns the diameters of all simulation objects in the given numa node.
+  /// Contains `GetNumSimObjects(numa_node)` elements.
+  const double* GetSoADiameters(int numa_node) const {
+    return soa_diameters_[numa_node].data();
+  }
 
   /// Reserves enough memory to hold `capacity` number of simulation objects for
   /// each numa domain.
@@ -301,7 +492,9 @@ class ResourceManager {
   }
 
   /// Resize `sim_objects_[numa_node]` such that it holds `current + additional`
-  /// elements after this call.
+  /// elements after this call. Also makes room in `uid_soh_map_` for
+  /// all uids that have been generated so far. Therefore, `AddNewSimObjects`
+  /// can be called in parallel afterwards.
   /// Returns the size after
   uint64_t GrowSoContainer(size_t additional, size_t numa_node) {
     if (additional == 0) {
@@ -309,13 +502,15 @@ class ResourceManager {
     }
     auto current = sim_objects_[numa_node].size();
     sim_objects_[numa_node].resize(current + additional);
+    num_added_since_sort_ += additional;
+    uid_soh_map_.Reserve(SoUidGenerator::Get()->GetLastId());
     return current;
   }
 
   /// Returns true if a sim object with the given uid is stored in this
   /// ResourceManager.
   bool Contains(SoUid uid) const {
-    return uid_soh_map_.find(uid) != uid_soh_map_.end();
+    return uid_soh_map_.Contains(uid);
   }
 
   /// Remove all simulation objects
@@ -324,6 +519,8 @@ class ResourceManager {
   /// not affected.
   void Clear() {
     uid_soh_map_.clear();
+    num_added_since_sort_ = 0;
+    soa_in_sync_ = false;
     for (auto& numa_sos : sim_objects_) {
       for (auto* so : numa_sos) {
         delete so;
@@ -336,6 +533,23 @@ class ResourceManager {
   /// nodes. Nearby sim objects will be moved to the same NUMA node.
   void SortAndBalanceNumaNodes();
 
+  /// Returns the largest relative deviation of the number of simulation
+  /// objects on a NUMA node from the number that `SortAndBalanceNumaNodes`
+  /// would assign to it.
+  double GetNumaImbalance() const;
+
+  /// Returns the fraction of simulation objects that have been added since
+  /// the last call to `SortAndBalanceNumaNodes`. These simulation objects
+  /// have been appended to the end of the NUMA node of the thread that
+  /// created them, instead of being stored next to their neighbors.
+  double GetUnsortedFraction() const {
+    auto num_sos = GetNumSimObjects();
+    if (num_sos == 0) {
+      return 0;
+    }
+    return std::min(1.0, static_cast<double>(num_added_since_sort_) / num_sos);
+  }
+
   void DebugNuma() const;
 
   /// NB: This method is not thread-safe! This function might invalidate
@@ -344,8 +558,9 @@ class ResourceManager {
   void push_back(SimObject* so,  // NOLINT
                  typename SoHandle::NumaNode_t numa_node = 0) {
     sim_objects_[numa_node].push_back(so);
-    uid_soh_map_[so->GetUid()] =
-        SoHandle(numa_node, sim_objects_[numa_node].size() - 1);
+    num_added_since_sort_++;
+    auto idx = sim_objects_[numa_node].size() - 1;
+    uid_soh_map_.Insert(so->GetUid(), SoHandle(numa_node, idx));
   }
 
   /// Adds `new_sim_objects` to `sim_objects_[numa_node]`. `offset` specifies
@@ -358,22 +573,34 @@ class ResourceManager {
     uint64_t i = 0;
     for (auto& pair : new_sim_objects) {
       auto uid = pair.first;
-      uid_soh_map_[uid] = SoHandle(numa_node, offset + i);
+      uid_soh_map_.Insert(uid, SoHandle(numa_node, offset + i));
       sim_objects_[numa_node][offset + i] = pair.second;
       i++;
     }
   }
 
+  /// Same as `AddNewSimObjects` above, but keeps the order of
+  /// `new_sim_objects`.
+  void AddNewSimObjects(typename SoHandle::NumaNode_t numa_node,
+                        uint64_t offset,
+                        const std::vector<SimObject*>& new_sim_objects) {
+    for (uint64_t i = 0; i < new_sim_objects.size(); i++) {
+      auto* so = new_sim_objects[i];
+      uid_soh_map_.Insert(so->GetUid(), SoHandle(numa_node, offset + i));
+      sim_objects_[numa_node][offset + i] = so;
+    }
+  }
+
   /// Removes the simulation object with the given uid.\n
   /// NB: This method is not thread-safe! This function invalidates
   /// sim_object references pointing into the ResourceManager. SoPointer are
   /// not affected.
   void Remove(SoUid uid) {
     // remove from map
-    auto it = uid_soh_map_.find(uid);
-    if (it != uid_soh_map_.end()) {
-      SoHandle soh = it->second;
-      uid_soh_map_.unsafe_erase(it);
+    SoHandle soh = uid_soh_map_[uid];
+    if (!(soh == SoHandle())) {
+      uid_soh_map_.Remove(uid);
+      soa_in_sync_ = false;
       // remove from vector
       auto& numa_sos = sim_objects_[soh.GetNumaNode()];
       if (soh.GetElementIdx() == numa_sos.size() - 1) {
@@ -385,11 +612,21 @@ class ResourceManager {
         auto* reordered = numa_sos.back();
         numa_sos[soh.GetElementIdx()] = reordered;
         numa_sos.pop_back();
-        uid_soh_map_[reordered->GetUid()] = soh;
+        uid_soh_map_.Insert(reordered->GetUid(), soh);
       }
     }
   }
 
+  /// Removes all simulation objects with the given uids. Uids that are not
+  /// stored in this ResourceManager are ignored.\n
+  /// In contrast to `Remove`, the remaining simulation objects keep their
+  /// relative order. Each numa node is compacted in parallel starting from
+  /// the first removed element.\n
+  /// NB: This method is not thread-safe! This function invalidates
+  /// sim_object references pointing into the ResourceManager. SoPointer are
+  /// not affected.
+  void RemoveSimObjects(const std::vector<SoUid>& uids);
+
  protected:
 #ifdef USE_OPENCL
   cl::Context* GetOpenCLContext() { return &opencl_context_; }
@@ -399,14 +636,53 @@ class ResourceManager {
 #endif
 
   /// Maps an SoUid to its storage location in `sim_objects_` \n
-  tbb::concurrent_unordered_map<SoUid, SoHandle> uid_soh_map_;  //!
+  SoUidMap<SoHandle> uid_soh_map_;  //!
   ///
   std::vector<std::vector<SimObject*>> sim_objects_;
 
   std::unordered_map<uint64_t, DiffusionGrid*> diffusion_grids_;
 
+  /// Structure of arrays with frequently accessed attributes of the simulation
+  /// objects in `sim_objects_` (see `UpdateSoAStore`). One vector per numa
+  /// node.
+  std::vector<ParallelResizeVector<Double3>> soa_positions_;     //!
+  std::vector<ParallelResizeVector<double>> soa_diameters_;      //!
+  std::vector<ParallelResizeVector<uint32_t>> soa_box_indices_;  //!
+  /// True if the structure of arrays is up to date except for
+  /// `soa_outdated_` and simulation objects that have been appended since
+  /// the last `UpdateSoAStore()` (see `SetSoAStoreInSync`).
+  bool soa_in_sync_ = false;  //!
+  /// SoHandles whose structure of arrays entries are outdated
+  std::vector<SoHandle> soa_outdated_;  //!
+  /// Incremented by each `UpdateSoAStore()` (see `MarkSoAEntryOutdated`)
+  uint32_t soa_epoch_ = 1;  //!
+  /// The epoch in which each structure of arrays entry has been marked as
+  /// outdated. One vector per numa node, with room for added simulation
+  /// objects.
+  std::vector<std::vector<std::atomic<uint32_t>>> soa_epochs_;  //!
+
+  /// Number of simulation objects that have been added since the last call
+  /// to `SortAndBalanceNumaNodes` (see `GetUnsortedFraction`)
+  uint64_t num_added_since_sort_ = 0;  //!
+
   ThreadInfo* thread_info_ = ThreadInfo::GetInstance();  //!
 
+  /// Returns the number of simulation objects each NUMA node should store
+  /// according to the number of threads associated with it.
+  std::vector<uint64_t> GetBalancedNumaShares() const;
+
+  /// Starts a new epoch for `MarkSoAEntryOutdated` and provides an epoch
+  /// for each simulation object.
+  void NextSoAEpoch();
+
+  /// Moves the memory of simulation objects and their biology modules to the
+  /// NUMA node that stores the simulation object. Used by
+  /// `SortAndBalanceNumaNodes`, which only reorders pointers.\n
+  /// Objects that are stored on another NUMA node are copied into the memory
+  /// pool of the target node by one of its threads. Biology modules are
+  /// moved to the relocated simulation object instead of being copied.
+  void MigrateSimObjects();
+
 #ifdef USE_OPENCL
   cl::Context opencl_context_;             //!
   cl::CommandQueue opencl_command_queue_;  //!
@@ -416,6 +692,7 @@ class ResourceManager {
 #endif
 
   friend class SimulationBackup;
+  friend class Checkpoint;
   BDM_CLASS_DEF_NV(ResourceManager, 1);
 };
 
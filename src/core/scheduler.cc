@@ -19,14 +19,17 @@
 
 #include "core/execution_context/in_place_exec_ctxt.h"
 #include "core/gpu/gpu_helper.h"
+#include "core/grid.h"
 #include "core/operation/bound_space_op.h"
 #include "core/operation/diffusion_op.h"
 #include "core/operation/displacement_op.h"
 #include "core/operation/op_timer.h"
+#include "core/operation/operation_statistics.h"
 #include "core/param/param.h"
 #include "core/resource_manager.h"
 #include "core/simulation.h"
 #include "core/simulation_backup.h"
+#include "core/util/batch_size_tuner.h"
 #include "core/util/log.h"
 #include "core/visualization/catalyst_adaptor.h"
 
@@ -43,6 +46,8 @@ Scheduler::Scheduler() {
   bound_space_ = new BoundSpace();
   displacement_ = new DisplacementOp();
   diffusion_ = new DiffusionOp();
+  batch_size_tuner_ = new BatchSizeTuner(param->scheduling_batch_size_);
+  op_statistics_ = new OperationStatistics();
 
   // initialise operations_
   auto first_op =
@@ -53,10 +58,21 @@ Scheduler::Scheduler() {
       "biology modules", [](SimObject* so) { so->RunBiologyModules(); });
   auto discretization_op = Operation(
       "discretization", [](SimObject* so) { so->RunDiscretization(); });
-
+  auto bound_space_op = Operation("bound space", *bound_space_);
   auto displacement_op = Operation("displacement", *displacement_);
 
-  operations_ = {first_op,          Operation("bound space", *bound_space_),
+  // Biology modules are defined by the user and keep the default access.
+  OpAccess sim_objects_only = {{OpResource::kSimObjects},
+                               {OpResource::kSimObjects}};
+  first_op.access_ = sim_objects_only;
+  last_op.access_ = sim_objects_only;
+  discretization_op.access_ = sim_objects_only;
+  bound_space_op.access_ = sim_objects_only;
+  displacement_op.access_ = {
+      {OpResource::kSimObjects, OpResource::kSpatialIndex},
+      {OpResource::kSimObjects}};
+
+  operations_ = {first_op,          bound_space_op,
                  biology_module_op, displacement_op,
                  discretization_op, last_op};
   protected_operations_ = {first_op.name_, biology_module_op.name_,
@@ -69,16 +85,21 @@ Scheduler::~Scheduler() {
   delete bound_space_;
   delete displacement_;
   delete diffusion_;
+  delete batch_size_tuner_;
   auto* param = Simulation::GetActive()->GetParam();
   if (param->statistics_) {
-    std::cout << gStatistics << std::endl;
+    std::cout << gStatistics << *op_statistics_ << std::endl;
   }
+  delete op_statistics_;
 }
 
 void Scheduler::Simulate(uint64_t steps) {
   if (Restore(&steps)) {
     return;
   }
+  // operations might have been modified through pointers returned by
+  // `GetOperation` or `GetOperationAccess`
+  scheduled_ops_outdated_ = true;
 
   Initialize();
   for (unsigned step = 0; step < steps; step++) {
@@ -94,6 +115,7 @@ uint64_t Scheduler::GetSimulatedSteps() const { return total_steps_; }
 void Scheduler::AddOperation(const Operation& op) {
   auto it = operations_.end() - 2;
   operations_.insert(it, op);
+  scheduled_ops_outdated_ = true;
 }
 
 void Scheduler::RemoveOperation(const std::string& name) {
@@ -106,6 +128,7 @@ void Scheduler::RemoveOperation(const std::string& name) {
   for (auto it = operations_.begin(); it != operations_.end(); ++it) {
     if (name == it->name_) {
       operations_.erase(it);
+      scheduled_ops_outdated_ = true;
       return;
     }
   }
@@ -120,16 +143,39 @@ Operation* Scheduler::GetOperation(const std::string& name) {
   for (uint64_t i = 0; i < operations_.size(); i++) {
     auto& op = operations_[i];
     if (name == op.name_) {
+      scheduled_ops_outdated_ = true;
       return &op;
     }
   }
   return nullptr;
 }
 
+OpAccess* Scheduler::GetOperationAccess(const std::string& name) {
+  for (auto& op : operations_) {
+    if (name == op.name_) {
+      scheduled_ops_outdated_ = true;
+      return &op.access_;
+    }
+  }
+  return nullptr;
+}
+
+bool Scheduler::SetOperationFilter(const std::string& name,
+                                   const Operation::FilterType& filter) {
+  for (auto& op : operations_) {
+    if (name == op.name_) {
+      op.filter_ = filter;
+      scheduled_ops_outdated_ = true;
+      return true;
+    }
+  }
+  return false;
+}
+
 void Scheduler::Execute(bool last_iteration) {
   auto* sim = Simulation::GetActive();
   auto* rm = sim->GetResourceManager();
-  auto* grid = sim->GetGrid();
+  auto* spatial_index = sim->GetSpatialIndex();
   auto* param = sim->GetParam();
 
   Timing::Time("Set up exec context", [&]() {
@@ -140,19 +186,92 @@ void Scheduler::Execute(bool last_iteration) {
   Timing::Time("visualize", [&]() {
     visualization_->Visualize(total_steps_, last_iteration);
   });
-  Timing::Time("neighbors", [&]() { grid->UpdateGrid(); });
+  Timing::Time("neighbors", [&]() { spatial_index->Update(); });
+  if (NumaRebalancingRequired()) {
+    // `SortAndBalanceNumaNodes` traverses the spatial index in Z-order and
+    // assigns new SoHandles to all simulation objects. Hence, the spatial
+    // index must be rebuilt afterwards.
+    Timing::Time("numa rebalancing", [&]() {
+      rm->SortAndBalanceNumaNodes();
+      spatial_index->Update();
+    });
+  }
+
+  // The structure of arrays has just been updated by the spatial index. All
+  // operations below copy the attributes of the simulation objects they
+  // update, or mark them if they modify a neighbor. Hence, the next update
+  // only has to copy those. Hardware accelerated operations bypass the
+  // structure of arrays, and simulation objects might be modified outside
+  // the scheduler after the last iteration.
+  if (!last_iteration &&
+      !(param->run_mechanical_interactions_ && !displacement_->UseCpu())) {
+    rm->SetSoAStoreInSync();
+  }
 
   // update all sim objects: run all CPU operations
   const auto& scheduled_ops = GetScheduleOps();
-  rm->ApplyOnAllElementsParallelDynamic(
-      param->scheduling_batch_size_, [&](SimObject* so, SoHandle) {
-        sim->GetExecutionContext()->Execute(so, scheduled_ops);
-      });
+  // diffusion grids that are updated at the end of this step
+  std::vector<DiffusionGrid*> remaining_dgrids;
+  auto* grid = sim->GetGrid();
+  if (param->box_coloring_ && spatial_index == grid &&
+      grid->GetNeighborMutexBuilder() != nullptr) {
+    grid->ApplyOnAllElementsColored([&](SimObject* so, SoHandle soh) {
+      sim->GetExecutionContext()->ExecuteWithoutNeighborMutex(so, soh,
+                                                              scheduled_ops);
+    });
+    rm->ApplyOnAllDiffusionGrids(
+        [&](DiffusionGrid* dg) { remaining_dgrids.push_back(dg); });
+  } else {
+    // Each diffusion grid is split into many tasks. Otherwise, one thread
+    // would update a whole grid while the others process simulation objects.
+    std::vector<std::function<void()>> diffusion_tasks;
+    std::vector<DiffusionGrid*> overlapped_dgrids;
+    rm->ApplyOnAllDiffusionGrids([&](DiffusionGrid* dg) {
+      if (scheduled_ops_access_.ConflictsWith(DiffusionOp::GetAccess(dg))) {
+        remaining_dgrids.push_back(dg);
+      } else {
+        diffusion_->CreateTasks(dg, &diffusion_tasks);
+        overlapped_dgrids.push_back(dg);
+      }
+    });
+
+    auto batch_size = param->scheduling_batch_size_;
+    if (param->adaptive_scheduling_batch_size_) {
+      batch_size = batch_size_tuner_->GetBatchSize();
+    }
+    bool measure = param->adaptive_scheduling_batch_size_ || param->statistics_;
+    ParallelLoopStatistics loop_statistics;
+    rm->ApplyOnAllElementsParallelDynamic(
+        batch_size,
+        [&](SimObject* so, SoHandle soh) {
+          sim->GetExecutionContext()->Execute(so, soh, scheduled_ops);
+        },
+        measure ? &loop_statistics : nullptr, diffusion_tasks);
+    for (auto* dg : overlapped_dgrids) {
+      diffusion_->FinishTasks(dg);
+    }
+    if (param->adaptive_scheduling_batch_size_) {
+      batch_size_tuner_->Update(loop_statistics);
+    }
+    if (param->statistics_) {
+      gStatistics.AddSample("scheduling batch size", loop_statistics.chunk_);
+      gStatistics.AddSample("scheduling load imbalance [%]",
+                            loop_statistics.GetLoadImbalance());
+    }
+  }
+
+  if (param->statistics_) {
+    op_statistics_->Merge();
+  }
 
   // update all sim objects: hardware accelerated operations
   if (param->run_mechanical_interactions_ && !displacement_->UseCpu()) {
     Timing::Time("displacement (GPU/FPGA)", *displacement_);
   }
+  // update all sim objects: displacement of all sim objects at once
+  if (param->run_mechanical_interactions_ && displacement_->UseHalfShell()) {
+    Timing::Time("displacement (half shell)", *displacement_);
+  }
 
   // finish updating sim objects
   Timing::Time("Tear down exec context", [&]() {
@@ -161,18 +280,50 @@ void Scheduler::Execute(bool last_iteration) {
   });
 
   // update all substances (DiffusionGrids)
-  Timing::Time("diffusion", *diffusion_);
+  Timing::Time("diffusion", [&]() {
+    for (auto* dg : remaining_dgrids) {
+      (*diffusion_)(dg);
+    }
+  });
+}
+
+bool Scheduler::NumaRebalancingRequired() const {
+  auto* sim = Simulation::GetActive();
+  auto* param = sim->GetParam();
+  auto* rm = sim->GetResourceManager();
+  if (rm->GetNumSimObjects() == 0) {
+    return false;
+  }
+  auto frequency = param->numa_rebalancing_frequency_;
+  if (frequency != 0 && total_steps_ % frequency == 0) {
+    return true;
+  }
+  auto threshold = param->numa_rebalancing_threshold_;
+  return threshold > 0 && (rm->GetNumaImbalance() > threshold ||
+                           rm->GetUnsortedFraction() > threshold);
 }
 
 void Scheduler::Backup() {
   using std::chrono::seconds;
   using std::chrono::duration_cast;
   auto* param = Simulation::GetActive()->GetParam();
-  if (backup_->BackupEnabled() &&
-      duration_cast<seconds>(Clock::now() - last_backup_).count() >=
-          param->backup_interval_) {
+  if (!backup_->BackupEnabled()) {
+    return;
+  }
+  bool backup = false;
+  if (param->backup_interval_steps_ != 0) {
+    backup = total_steps_ % param->backup_interval_steps_ == 0;
+  } else {
+    backup = duration_cast<seconds>(Clock::now() - last_backup_).count() >=
+             param->backup_interval_;
+  }
+  if (backup) {
     last_backup_ = Clock::now();
-    backup_->Backup(total_steps_);
+    if (param->async_backup_) {
+      backup_->BackupAsync(total_steps_);
+    } else {
+      backup_->Backup(total_steps_);
+    }
   }
 }
 
@@ -201,6 +352,7 @@ bool Scheduler::Restore(uint64_t* steps) {
 void Scheduler::Initialize() {
   auto* sim = Simulation::GetActive();
   auto* grid = sim->GetGrid();
+  auto* spatial_index = sim->GetSpatialIndex();
   auto* rm = sim->GetResourceManager();
   auto* param = sim->GetParam();
 
@@ -216,9 +368,13 @@ void Scheduler::Initialize() {
   if (param->bound_space_) {
     rm->ApplyOnAllElementsParallel(*bound_space_);
   }
-  grid->Initialize();
-  int lbound = grid->GetDimensionThresholds()[0];
-  int rbound = grid->GetDimensionThresholds()[1];
+  if (spatial_index == grid) {
+    grid->Initialize();
+  } else {
+    spatial_index->Update();
+  }
+  int lbound = spatial_index->GetDimensionThresholds()[0];
+  int rbound = spatial_index->GetDimensionThresholds()[1];
   rm->ApplyOnAllDiffusionGrids([&](DiffusionGrid* dgrid) {
     // Create data structures, whose size depend on the grid dimensions
     dgrid->Initialize({lbound, rbound, lbound, rbound, lbound, rbound});
@@ -227,21 +383,51 @@ void Scheduler::Initialize() {
   });
 }
 
-std::vector<Operation> Scheduler::GetScheduleOps() {
-  std::vector<Operation> scheduled_ops;
-  scheduled_ops.reserve(operations_.size());
+const std::vector<Operation>& Scheduler::GetScheduleOps() {
+  bool changed = scheduled_ops_outdated_;
+  scheduled_.resize(operations_.size());
+  for (uint64_t i = 0; i < operations_.size(); i++) {
+    bool scheduled = IsScheduled(operations_[i]);
+    if (scheduled != scheduled_[i]) {
+      scheduled_[i] = scheduled;
+      changed = true;
+    }
+  }
+  if (!changed) {
+    return scheduled_ops_;
+  }
+
   auto* param = Simulation::GetActive()->GetParam();
-  for (auto& op : operations_) {
-    // special condition for displacement
-    if (!param->run_mechanical_interactions_ && op.name_ == "displacement" &&
-        !displacement_->UseCpu()) {
+  scheduled_ops_.clear();
+  scheduled_ops_access_ = OpAccess();
+  for (uint64_t i = 0; i < operations_.size(); i++) {
+    if (!scheduled_[i]) {
       continue;
     }
-    if (total_steps_ % op.frequency_ == 0) {
-      scheduled_ops.push_back(op);
+    auto& op = operations_[i];
+    if (param->statistics_) {
+      scheduled_ops_.push_back(op_statistics_->Instrument(op));
+    } else {
+      scheduled_ops_.push_back(op);
     }
+    scheduled_ops_access_.Merge(op.access_);
+  }
+  scheduled_ops_outdated_ = false;
+  return scheduled_ops_;
+}
+
+bool Scheduler::IsScheduled(const Operation& op) const {
+  auto* param = Simulation::GetActive()->GetParam();
+  // special condition for displacement
+  if (!param->run_mechanical_interactions_ && op.name_ == "displacement" &&
+      !displacement_->UseCpu()) {
+    return false;
+  }
+  // the half-shell displacement is executed for all sim objects at once
+  if (op.name_ == "displacement" && displacement_->UseHalfShell()) {
+    return false;
   }
-  return scheduled_ops;
+  return total_steps_ % op.frequency_ == 0;
 }
 
 }  // namespace bdm
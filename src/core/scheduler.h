@@ -24,12 +24,14 @@
 
 namespace bdm {
 
+class BatchSizeTuner;
 class SimObject;
 class SimulationBackup;
 class CatalystAdaptor;
 class BoundSpace;
 class DisplacementOp;
 class DiffusionOp;
+class OperationStatistics;
 
 class Scheduler {
  public:
@@ -57,11 +59,31 @@ class Scheduler {
   /// returned.
   Operation* GetOperation(const std::string& op_name);
 
+  /// Returns the data accesses of an operation (see `Operation::access_`).
+  /// In contrast to `GetOperation`, the accesses of protected operations are
+  /// returned as well. For example, a simulation can declare that none of
+  /// its biology modules accesses diffusion grids. Thus, diffusion overlaps
+  /// with the operations on simulation objects (see `Execute`).\n
+  /// Returns a nullptr if the operation does not exist.
+  OpAccess* GetOperationAccess(const std::string& op_name);
+
+  /// Restricts an operation to the simulation objects for which `filter`
+  /// returns true (see `Operation::filter_`). In contrast to `GetOperation`,
+  /// protected operations can be restricted as well; e.g. discretization
+  /// to neurite elements.\n
+  /// Returns false if the operation does not exist.
+  bool SetOperationFilter(const std::string& op_name,
+                          const Operation::FilterType& filter);
+
  protected:
   uint64_t total_steps_ = 0;
 
   /// Executes one step.
-  /// This design makes testing more convenient
+  /// This design makes testing more convenient\n
+  /// Diffusion grids that are neither read nor written by any scheduled
+  /// operation (see `Operation::access_`) are updated by the same threads
+  /// concurrently with the operations on simulation objects. All other
+  /// diffusion grids are updated at the end of the step.
   virtual void Execute(bool last_iteration);
 
  private:
@@ -74,11 +96,34 @@ class Scheduler {
   BoundSpace* bound_space_;
   DisplacementOp* displacement_;
   DiffusionOp* diffusion_;
+  /// Adjusts the batch size if `Param::adaptive_scheduling_batch_size_` is
+  /// enabled
+  BatchSizeTuner* batch_size_tuner_;
+  /// Execution times of the operations on simulation objects if
+  /// `Param::statistics_` is enabled
+  OperationStatistics* op_statistics_;
 
   std::vector<Operation> operations_;  //!
   std::set<std::string> protected_operations_;
+  /// Operations that are executed in the current step (see
+  /// `GetScheduleOps`)
+  std::vector<Operation> scheduled_ops_;  //!
+  /// Merged data accesses of `scheduled_ops_`
+  OpAccess scheduled_ops_access_;  //!
+  /// `scheduled_ops_` contains `operations_[i]` iff `scheduled_[i]` is true
+  std::vector<bool> scheduled_;
+  /// True if `scheduled_ops_` must be rebuilt, because operations have been
+  /// added or removed, or might have been modified.
+  bool scheduled_ops_outdated_ = true;
+
+  /// Returns true if simulation objects should be sorted and balanced
+  /// across NUMA nodes in this iteration (see
+  /// `Param::numa_rebalancing_frequency_` and
+  /// `Param::numa_rebalancing_threshold_`).
+  bool NumaRebalancingRequired() const;
 
   /// Backup the simulation. Backup interval based on `Param::backup_interval_`
+  /// or `Param::backup_interval_steps_`
   void Backup();
 
   /// Restore the simulation if requested at the right time
@@ -91,8 +136,14 @@ class Scheduler {
   // if Simulate is called with one timestep.
   void Initialize();
 
-  // Decide which operations should be executed
-  std::vector<Operation> GetScheduleOps();
+  /// Decide which operations should be executed.\n
+  /// The list is only rebuilt if the set of operations that are due in this
+  /// step differs from the previous step, or if it has been invalidated
+  /// (see `scheduled_ops_outdated_`).
+  const std::vector<Operation>& GetScheduleOps();
+
+  /// Returns true if `op` should be executed in the current step
+  bool IsScheduled(const Operation& op) const;
 };
 
 }  // namespace bdm
@@ -29,6 +29,7 @@
 #include "core/event/cell_division_event.h"
 #include "core/event/event.h"
 #include "core/execution_context/in_place_exec_ctxt.h"
+#include "core/grid.h"
 #include "core/param/param.h"
 #include "core/shape.h"
 #include "core/sim_object/sim_object.h"
@@ -264,26 +265,6 @@ class Cell : public SimObject {
     // There is also a computation of the torque (only applied
     // by the daughter neurites), stored in rotationForce.
 
-    // TODO(roman) : There might be a problem, in the sense that the biology
-    // is not applied if the total Force is smaller than adherence.
-    // Once, I should look at this more carefully.
-
-    // fixme why? copying
-    const auto& tf = GetTractorForce();
-
-    // the 3 types of movement that can occur
-    // bool biological_translation = false;
-    bool physical_translation = false;
-    // bool physical_rotation = false;
-
-    double h = dt;
-    Double3 movement_at_next_step{0, 0, 0};
-
-    // BIOLOGY :
-    // 0) Start with tractor force : What the biology defined as active
-    // movement------------
-    movement_at_next_step += tf * h;
-
     // PHYSICS
     // the physics force to move the point mass
     Double3 translation_force_on_point_mass{0, 0, 0};
@@ -312,6 +293,35 @@ class Cell : public SimObject {
                                       squared_radius);
 
     // 4) PhysicalBonds
+    return CalculateDisplacementFromForce(translation_force_on_point_mass, dt);
+  }
+
+  /// Calculates the displacement of this cell, given the sum of the forces
+  /// that its neighbors exert on it. Used by `CalculateDisplacement` and by
+  /// operations that calculate the neighbor forces themselves
+  /// (e.g. `DisplacementOpHalfShell`).
+  Double3 CalculateDisplacementFromForce(
+      const Double3& translation_force_on_point_mass, double dt) {
+    // TODO(roman) : There might be a problem, in the sense that the biology
+    // is not applied if the total Force is smaller than adherence.
+    // Once, I should look at this more carefully.
+
+    // fixme why? copying
+    const auto& tf = GetTractorForce();
+
+    // the 3 types of movement that can occur
+    // bool biological_translation = false;
+    bool physical_translation = false;
+    // bool physical_rotation = false;
+
+    double h = dt;
+    Double3 movement_at_next_step{0, 0, 0};
+
+    // BIOLOGY :
+    // 0) Start with tractor force : What the biology defined as active
+    // movement------------
+    movement_at_next_step += tf * h;
+
     // How the physics influences the next displacement
     double norm_of_force = std::sqrt(translation_force_on_point_mass *
                                      translation_force_on_point_mass);
@@ -70,6 +70,15 @@ SimObject::~SimObject() {
   }
 }
 
+SimObject* SimObject::Relocate() {
+  // the copy constructor would copy all biology modules
+  std::vector<BaseBiologyModule*> bms;
+  bms.swap(biology_modules_);
+  auto* copy = GetCopy();
+  copy->biology_modules_.swap(bms);
+  return copy;
+}
+
 void SimObject::ApplyRunDisplacementForAllNextTs() {
   if (!Simulation::GetActive()->GetParam()->detect_static_sim_objects_) {
     run_displacement_next_ts_ = true;
@@ -132,6 +141,12 @@ void SimObject::RunBiologyModules() {
 const std::vector<BaseBiologyModule*>& SimObject::GetAllBiologyModules() const {
   return biology_modules_;
 }
+
+void SimObject::RelocateBiologyModule(uint64_t idx) {
+  auto* copy = biology_modules_[idx]->GetCopy();
+  delete biology_modules_[idx];
+  biology_modules_[idx] = copy;
+}
 // ---------------------------------------------------------------------------
 
 void SimObject::RemoveFromSimulation() const {
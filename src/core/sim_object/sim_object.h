@@ -27,6 +27,7 @@
 #include <vector>
 
 #include "core/container/math_array.h"
+#include "core/memory/memory_manager.h"
 #include "core/shape.h"
 #include "core/sim_object/so_pointer.h"
 #include "core/sim_object/so_uid.h"
@@ -137,6 +138,8 @@ class SimObject {
 
   virtual ~SimObject();
 
+  BDM_MEMORY_MANAGER_OPERATORS
+
   /// Executes the given function for all data members
   /// \see `SoVisitor`
   virtual void ForEachDataMember(SoVisitor* visitor) const {
@@ -161,6 +164,12 @@ class SimObject {
   /// Create a copy of this object.
   virtual SimObject* GetCopy() const = 0;
 
+  /// Returns a copy of this simulation object that is allocated by the
+  /// calling thread (see `MemoryManager`). In contrast to `GetCopy`, the
+  /// biology modules are moved instead of copied. Afterwards, this simulation
+  /// object has no biology modules and can be deleted.
+  SimObject* Relocate();
+
   virtual const char* GetTypeName() const { return "SimObject"; }
 
   virtual Shape GetShape() const = 0;
@@ -175,6 +184,9 @@ class SimObject {
 
   void AssignNewUid();
 
+  /// NB: `uid` must not be used by another simulation object.
+  void SetUid(SoUid uid) { uid_ = uid; }
+
   SoUid GetUid() const;
 
   uint32_t GetBoxIdx() const;
@@ -221,6 +233,10 @@ class SimObject {
 
   /// Return all biology modules
   const std::vector<BaseBiologyModule*>& GetAllBiologyModules() const;
+
+  /// Replaces the biology module at index `idx` with a copy that is
+  /// allocated by the calling thread (see `MemoryManager`).
+  void RelocateBiologyModule(uint64_t idx);
   // ---------------------------------------------------------------------------
 
   virtual Double3 CalculateDisplacement(double squared_radius, double dt) = 0;
@@ -38,6 +38,10 @@ class SoUidGenerator {
 
   SoUid GetLastId() const { return counter_; }
 
+  /// Continues with `last_id`. Only used to restore a checkpoint, which
+  /// replaces all simulation objects (see `Checkpoint::Restore`).
+  void SetLastId(SoUid last_id) { counter_ = last_id; }
+
  private:
   SoUidGenerator() : counter_(0) {}
   std::atomic<SoUid> counter_;
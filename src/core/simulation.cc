@@ -23,6 +23,7 @@
 #include <vector>
 #include "core/execution_context/in_place_exec_ctxt.h"
 #include "core/grid.h"
+#include "core/kd_tree.h"
 #include "core/param/command_line_options.h"
 #include "core/param/param.h"
 #include "core/resource_manager.h"
@@ -103,6 +104,9 @@ Simulation::~Simulation() {
   active_ = this;
 
   delete rm_;
+  if (spatial_index_ != grid_) {
+    delete spatial_index_;
+  }
   delete grid_;
   delete scheduler_;
   delete param_;
@@ -128,6 +132,8 @@ const Param* Simulation::GetParam() const { return param_; }
 
 Grid* Simulation::GetGrid() { return grid_; }
 
+SpatialIndex* Simulation::GetSpatialIndex() { return spatial_index_; }
+
 Scheduler* Simulation::GetScheduler() { return scheduler_; }
 
 Random* Simulation::GetRandom() { return random_[omp_get_thread_num()]; }
@@ -178,6 +184,15 @@ void Simulation::InitializeMembers() {
   }
   rm_ = new ResourceManager();
   grid_ = new Grid();
+  if (param_->spatial_index_ == "uniform_grid") {
+    spatial_index_ = grid_;
+  } else if (param_->spatial_index_ == "kd_tree") {
+    spatial_index_ = new KdTree();
+  } else {
+    Log::Fatal("Simulation::InitializeMembers", "Unknown spatial index '",
+               param_->spatial_index_,
+               "'. Possible values: uniform_grid, kd_tree");
+  }
   scheduler_ = new Scheduler();
 }
 
@@ -25,6 +25,7 @@ namespace bdm {
 // forward declarations
 class ResourceManager;
 class Grid;
+class SpatialIndex;
 class Scheduler;
 struct Param;
 class InPlaceExecutionContext;
@@ -76,6 +77,11 @@ class Simulation {
 
   Grid* GetGrid();
 
+  /// Returns the data structure that answers neighbor queries (see
+  /// `Param::spatial_index_`). Returns the same object as `GetGrid()` if the
+  /// uniform grid has been selected.
+  SpatialIndex* GetSpatialIndex();
+
   Scheduler* GetScheduler();
 
   /// Returns a thread local random number generator.
@@ -117,8 +123,9 @@ class Simulation {
   ResourceManager* rm_ = nullptr;
   Param* param_ = nullptr;
   std::string name_;
-  Grid* grid_ = nullptr;            //!
-  Scheduler* scheduler_ = nullptr;  //!
+  Grid* grid_ = nullptr;                   //!
+  SpatialIndex* spatial_index_ = nullptr;  //!
+  Scheduler* scheduler_ = nullptr;         //!
   /// This id is unique for each simulation within the same process
   uint64_t id_ = 0;  //!
   /// cached value where `id_` is appended to `name_` if `id_` is
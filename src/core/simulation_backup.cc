@@ -14,6 +14,9 @@
 
 #include "core/simulation_backup.h"
 
+#include <sys/wait.h>
+#include <unistd.h>
+
 namespace bdm {
 
 SimulationBackup::SimulationBackup(const std::string& backup_file,
@@ -39,8 +42,53 @@ SimulationBackup::SimulationBackup(const std::string& backup_file,
   }
 }
 
+SimulationBackup::~SimulationBackup() { WaitForAsyncBackup(); }
+
+void SimulationBackup::BackupAsync(size_t completed_simulation_steps) {
+  if (!backup_) {
+    Log::Fatal("SimulationBackup",
+               "Requested to backup data, but no backup file given.");
+  }
+  WaitForAsyncBackup();
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    // The child only consists of this thread. Therefore, it must not open
+    // parallel regions. It exits without running destructors or exit
+    // handlers of the parent's objects.
+    try {
+      WriteBackupFile(completed_simulation_steps, false);
+    } catch (...) {
+      _exit(1);
+    }
+    _exit(0);
+  } else if (pid < 0) {
+    Log::Warning("SimulationBackup",
+                 "Could not fork the process for an asynchronous backup. "
+                 "Falling back to a synchronous backup.");
+    Backup(completed_simulation_steps);
+    return;
+  }
+  async_backup_pid_ = pid;
+}
+
+void SimulationBackup::WaitForAsyncBackup() {
+  if (async_backup_pid_ == -1) {
+    return;
+  }
+  int status = 0;
+  waitpid(async_backup_pid_, &status, 0);
+  async_backup_pid_ = -1;
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    Log::Warning("SimulationBackup", "Asynchronous backup to ", backup_file_,
+                 " failed.");
+  }
+}
+
 size_t SimulationBackup::GetSimulationStepsFromBackup() {
-  if (restore_) {
+  if (restore_ && Checkpoint::IsCheckpoint(restore_file_)) {
+    return Checkpoint::GetSimulationSteps(restore_file_);
+  } else if (restore_) {
     IntegralTypeWrapper<size_t>* wrapper = nullptr;
     bdm::GetPersistentObject(restore_file_.c_str(), kSimulationStepName.c_str(),
                              wrapper);
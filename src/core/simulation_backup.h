@@ -15,11 +15,14 @@
 #ifndef CORE_SIMULATION_BACKUP_H_
 #define CORE_SIMULATION_BACKUP_H_
 
+#include <sys/types.h>
 #include <functional>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "core/checkpoint.h"
+#include "core/param/param.h"
 #include "core/simulation.h"
 
 #include "core/util/io.h"
@@ -50,40 +53,44 @@ class SimulationBackup {
   SimulationBackup(const std::string& backup_file,
                    const std::string& restore_file);
 
+  /// Waits for a running asynchronous backup
+  ~SimulationBackup();
+
   void Backup(size_t completed_simulation_steps) {
     if (!backup_) {
       Log::Fatal("SimulationBackup",
                  "Requested to backup data, but no backup file given.");
     }
-
-    // create temporary file
-    // if application crashes during backup; last backup is not corrupted
-    std::stringstream tmp_file;
-    tmp_file << "tmp_" << backup_file_;
-
-    // Backup
-    {
-      TFileRaii f(tmp_file.str(), "UPDATE");
-      auto* simulation = Simulation::GetActive();
-      f.Get()->WriteObject(simulation, kSimulationName.c_str());
-      IntegralTypeWrapper<size_t> wrapper(completed_simulation_steps);
-      f.Get()->WriteObject(&wrapper, kSimulationStepName.c_str());
-      RuntimeVariables rv;
-      f.Get()->WriteObject(&rv, kRuntimeVariableName.c_str());
-      // TODO(lukas)  random number generator; all statics (e.g. Param)
-    }
-
-    // remove last backup file
-    remove(backup_file_.c_str());
-    // rename temporary file
-    rename(tmp_file.str().c_str(), backup_file_.c_str());
+    // an asynchronous backup might still write to the same files
+    WaitForAsyncBackup();
+    WriteBackupFile(completed_simulation_steps, true);
   }
 
+  /// Same as `Backup`, but returns immediately. The calling process is
+  /// forked. The child process has a copy-on-write snapshot of the whole
+  /// simulation at the time of the call and writes the backup, while the
+  /// parent continues with the simulation. Only the pages that are modified
+  /// in the meantime are copied.\n
+  /// At most one asynchronous backup is running at a time. Hence, this
+  /// function waits for the previous one to finish first.\n
+  /// NB: Must be called outside of parallel regions. Falls back to `Backup`
+  /// if the process cannot be forked.
+  void BackupAsync(size_t completed_simulation_steps);
+
+  /// Blocks until the running asynchronous backup has finished. Returns
+  /// immediately if there is none.
+  void WaitForAsyncBackup();
+
   void Restore() {
     if (!restore_) {
       Log::Fatal("SimulationBackup",
                  "Requested to restore data, but no restore file given.");
     }
+    if (Checkpoint::IsCheckpoint(restore_file_)) {
+      Checkpoint::Restore(restore_file_);
+      Log::Info("Scheduler", "Restored simulation from ", restore_file_);
+      return;
+    }
     after_restore_event_.clear();
 
     TFileRaii file(TFile::Open(restore_file_.c_str()));
@@ -118,6 +125,36 @@ class SimulationBackup {
   bool restore_ = true;
   std::string backup_file_;
   std::string restore_file_;
+  /// Process id of the running asynchronous backup; -1 if there is none
+  pid_t async_backup_pid_ = -1;
+
+  /// Writes the backup in the format given by `Param::native_backup_`.
+  /// If `parallel` is false, no parallel region is opened.
+  void WriteBackupFile(size_t completed_simulation_steps, bool parallel) {
+    // create temporary file
+    // if application crashes during backup; last backup is not corrupted
+    std::stringstream tmp_file;
+    tmp_file << "tmp_" << backup_file_;
+
+    // Backup
+    auto* simulation = Simulation::GetActive();
+    if (simulation->GetParam()->native_backup_) {
+      Checkpoint::Write(tmp_file.str(), completed_simulation_steps, parallel);
+    } else {
+      TFileRaii f(tmp_file.str(), "UPDATE");
+      f.Get()->WriteObject(simulation, kSimulationName.c_str());
+      IntegralTypeWrapper<size_t> wrapper(completed_simulation_steps);
+      f.Get()->WriteObject(&wrapper, kSimulationStepName.c_str());
+      RuntimeVariables rv;
+      f.Get()->WriteObject(&rv, kRuntimeVariableName.c_str());
+      // TODO(lukas)  random number generator; all statics (e.g. Param)
+    }
+
+    // remove last backup file
+    remove(backup_file_.c_str());
+    // rename temporary file
+    rename(tmp_file.str().c_str(), backup_file_.c_str());
+  }
 };
 
 }  // namespace bdm
@@ -0,0 +1,177 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_SPATIAL_INDEX_H_
+#define CORE_SPATIAL_INDEX_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "core/container/fixed_size_vector.h"
+#include "core/container/math_array.h"
+#include "core/resource_manager.h"  // SoHandle
+
+namespace bdm {
+
+class SimObject;
+
+/// Interface of data structures that answer neighbor queries for the
+/// simulation objects of the active simulation (e.g. `Grid` or `KdTree`).
+/// The implementation is selected with `Param::spatial_index_`.\n
+/// Implementations assign an index to each simulation object
+/// (`SimObject::SetBoxIdx`) that identifies its region in space. The
+/// `NeighborMutexBuilder` uses this index to protect the neighborhood of a
+/// simulation object.
+class SpatialIndex {
+ public:
+  /// This class ensures thread-safety for the InPlaceExecutionContext for the
+  /// case that a simulation object modifies its neighbors.
+  class NeighborMutexBuilder {
+   public:
+    /// The NeighborMutex class is a synchronization primitive that can be
+    /// used to protect sim_objects data from being simultaneously accessed by
+    /// multiple threads.
+    class NeighborMutex {
+     public:
+      NeighborMutex(const FixedSizeVector<uint64_t, 27>& mutex_indices,
+                    NeighborMutexBuilder* mutex_builder)
+          : mutex_indices_(mutex_indices), mutex_builder_(mutex_builder) {
+        // Deadlocks occur if mutliple threads try to acquire the same locks,
+        // but in different order.
+        // -> sort to avoid deadlocks - see lock ordering
+        std::sort(mutex_indices_.begin(), mutex_indices_.end());
+      }
+
+      void lock() {  // NOLINT
+        for (auto idx : mutex_indices_) {
+          auto& mutex = mutex_builder_->mutexes_[idx].mutex_;
+          // acquire lock (and spin if another thread is holding it)
+          while (mutex.test_and_set(std::memory_order_acquire)) {
+          }
+        }
+      }
+
+      void unlock() {  // NOLINT
+        for (auto idx : mutex_indices_) {
+          auto& mutex = mutex_builder_->mutexes_[idx].mutex_;
+          mutex.clear(std::memory_order_release);
+        }
+      }
+
+     private:
+      FixedSizeVector<uint64_t, 27> mutex_indices_;
+      NeighborMutexBuilder* mutex_builder_;
+    };
+
+    /// Used to store mutexes in a vector.
+    /// Always creates a new mutex (even for the copy constructor)
+    struct MutexWrapper {
+      MutexWrapper() {}
+      MutexWrapper(const MutexWrapper&) {}
+      std::atomic_flag mutex_ = ATOMIC_FLAG_INIT;
+    };
+
+    virtual ~NeighborMutexBuilder() {}
+
+    /// Adapts the number of mutexes after the spatial index has been updated
+    virtual void Update() = 0;
+
+    /// Returns the mutex that protects all simulation objects within the
+    /// size of the largest object of a simulation object with the given box
+    /// index (see `SimObject::GetBoxIdx`).
+    virtual NeighborMutex GetMutex(uint64_t box_idx) = 0;
+
+   protected:
+    std::vector<MutexWrapper> mutexes_;
+  };
+
+  virtual ~SpatialIndex() {}
+
+  /// Updates the spatial index, as simulation objects may have moved, added
+  /// or deleted
+  virtual void Update() = 0;
+
+  /// Applies the given lambda to each neighbor of the query object. Neighbors
+  /// are all simulation objects within the size of the largest object. Some
+  /// implementations might return additional simulation objects.
+  virtual void ForEachNeighbor(
+      const std::function<void(const SimObject*)>& lambda,
+      const SimObject& query) = 0;
+
+  /// Applies the given lambda to each neighbor of the query object (see
+  /// above) together with its squared distance to the query object.
+  virtual void ForEachNeighbor(
+      const std::function<void(const SimObject*, double)>& lambda,
+      const SimObject& query) = 0;
+
+  /// Applies the given lambda to each simulation object whose squared
+  /// distance to the query object is smaller than `squared_radius`.
+  /// Beyond `GetNeighborSearchRadius()`, distances are based on the positions
+  /// at the time of the last `Update`, because simulation objects outside
+  /// the neighborhood protected by the `NeighborMutex` might be modified
+  /// concurrently.
+  virtual void ForEachNeighborWithinRadius(
+      const std::function<void(const SimObject*)>& lambda,
+      const SimObject& query, double squared_radius) = 0;
+
+  /// Returns the `k` simulation objects that are closest to the query object
+  /// sorted by increasing distance. Simulation objects with the same
+  /// distance are sorted by uid. Distances are based on the positions at the
+  /// time of the last `Update`.
+  virtual std::vector<const SimObject*> GetKNearestNeighbors(
+      const SimObject& query, uint64_t k) const = 0;
+
+  /// Returns the radius within which `ForEachNeighbor` is guaranteed to find
+  /// all neighbors of a simulation object.
+  virtual double GetNeighborSearchRadius() const = 0;
+
+  /// Returns the index of the region that contains `position` (see
+  /// `SimObject::GetBoxIdx`). `position` must lie within `GetDimensions()`.
+  virtual size_t GetBoxIndex(const Double3& position) const = 0;
+
+  /// Iterates over the SoHandles of all simulation objects in an order that
+  /// preserves spatial locality.
+  virtual void IterateZOrder(
+      const std::function<void(const SoHandle&)>& lambda) = 0;
+
+  /// Gets the size of the largest object
+  virtual double GetLargestObjectSize() const = 0;
+
+  /// Returns the cube which contains all simulation objects
+  /// {x_min, x_max, y_min, y_max, z_min, z_max}
+  virtual const std::array<int32_t, 6>& GetDimensions() const = 0;
+
+  /// Returns the min / max dimension value that need to be surpassed in order
+  /// to trigger a diffusion grid change
+  virtual const std::array<int32_t, 2>& GetDimensionThresholds() const = 0;
+
+  /// Returns true if the dimensions have increased during the last update
+  virtual bool HasGrown() = 0;
+
+  /// Returns the `NeighborMutexBuilder`. The client use it to create a
+  /// `NeighborMutex`. If neighbor mutexes has been disabled by calling
+  /// `DisableNeighborMutexes`, this function will return a nullptr.
+  virtual NeighborMutexBuilder* GetNeighborMutexBuilder() = 0;
+
+  /// Disable neighbor mutexes management. `GetNeighborMutexBuilder()` will
+  /// return a nullptr.
+  virtual void DisableNeighborMutexes() = 0;
+};
+
+}  // namespace bdm
+
+#endif  // CORE_SPATIAL_INDEX_H_
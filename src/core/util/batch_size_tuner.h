@@ -0,0 +1,83 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_UTIL_BATCH_SIZE_TUNER_H_
+#define CORE_UTIL_BATCH_SIZE_TUNER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+#include "core/resource_manager.h"
+
+namespace bdm {
+
+/// Adjusts the batch size of
+/// `ResourceManager::ApplyOnAllElementsParallelDynamic` based on the
+/// measurements of the previous call (see
+/// `Param::adaptive_scheduling_batch_size_`).\n
+/// Small batches balance the load better, but each batch adds the overhead
+/// of taking it from the work range, or stealing it from another thread.
+/// Therefore, the tuner aims for batches that take `kTargetChunkTime`, but
+/// limits the batch size such that each thread processes at least
+/// `kMinChunksPerThread` batches. If the load imbalance of the last call
+/// exceeded `kMaxLoadImbalance`, the batch size is halved.\n
+/// The new batch size is the average of the previous one and the target to
+/// damp oscillations caused by noisy measurements. It grows at most by 50%
+/// per update.
+class BatchSizeTuner {
+ public:
+  /// Target execution time of one batch in ns
+  static constexpr double kTargetChunkTime = 50000;
+  static constexpr uint64_t kMinChunksPerThread = 16;
+  /// Maximum tolerated load imbalance in percent
+  /// (see `ParallelLoopStatistics::GetLoadImbalance`)
+  static constexpr double kMaxLoadImbalance = 5;
+
+  explicit BatchSizeTuner(uint64_t batch_size)
+      : batch_size_(std::max<uint64_t>(batch_size, 1)) {}
+
+  uint64_t GetBatchSize() const { return batch_size_; }
+
+  void Update(const ParallelLoopStatistics& statistics) {
+    auto num_threads = statistics.busy_time_.size();
+    if (statistics.num_chunks_ == 0 || num_threads == 0) {
+      return;
+    }
+    uint64_t total_time = statistics.GetChunkTime();
+
+    double target = std::numeric_limits<uint64_t>::max();
+    if (total_time != 0) {
+      double time_per_so =
+          static_cast<double>(total_time) / statistics.num_sim_objects_;
+      target = kTargetChunkTime / time_per_so;
+    }
+    double balanced = static_cast<double>(statistics.num_sim_objects_) /
+                      (num_threads * kMinChunksPerThread);
+    target = std::min(target, balanced);
+    if (statistics.GetLoadImbalance() > kMaxLoadImbalance) {
+      target = std::min(target, statistics.chunk_ / 2.0);
+    }
+    target = std::min<double>(target, batch_size_ * 2.0);
+
+    batch_size_ = std::max<uint64_t>((batch_size_ + target) / 2, 1);
+  }
+
+ private:
+  uint64_t batch_size_;
+};
+
+}  // namespace bdm
+
+#endif  // CORE_UTIL_BATCH_SIZE_TUNER_H_
@@ -18,10 +18,12 @@
 #ifdef USE_NUMA
 
 #include <numa.h>
+#include <numaif.h>
 
 #else
 
 #include <omp.h>
+#include <cstddef>
 
 inline int numa_available() { return 0; }
 inline int numa_num_configured_nodes() { return 1; }
@@ -33,6 +35,8 @@ inline int numa_move_pages(int pid, unsigned long count, void **pages,
   return 0;
 }
 
+inline void numa_tonode_memory(void *start, size_t size, int node) {}
+
 // on linux in <sched.h>, but missing on MacOS
 inline int sched_getcpu() { return 0; }
 
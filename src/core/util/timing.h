@@ -52,22 +52,29 @@ class Timing {
   }
 
   explicit Timing(const std::string& description = "")
-      : start_{Timestamp()}, text_{description} {}
+      : start_{std::chrono::steady_clock::now()}, text_{description} {}
 
   Timing(const std::string& description, TimingAggregator* aggregator)
-      : start_{Timestamp()}, text_{description}, aggregator_{aggregator} {}
+      : start_{std::chrono::steady_clock::now()},
+        text_{description},
+        aggregator_{aggregator} {}
 
+  /// Measures with nanosecond resolution. Durations are printed, or added to
+  /// the aggregator, in nanoseconds.
   ~Timing() {
-    int64_t duration = (Timestamp() - start_);
+    using std::chrono::nanoseconds;
+    using std::chrono::duration_cast;
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    int64_t duration = duration_cast<nanoseconds>(elapsed).count();
     if (aggregator_ == nullptr) {
-      std::cout << text_ << " " << duration << " ms" << std::endl;
+      std::cout << text_ << " " << duration / 1e6 << " ms" << std::endl;
     } else {
       aggregator_->AddEntry(text_, duration);
     }
   }
 
  private:
-  int64_t start_;
+  std::chrono::time_point<std::chrono::steady_clock> start_;
   std::string text_;
   TimingAggregator* aggregator_ = nullptr;
 };
@@ -15,6 +15,7 @@
 #ifndef CORE_UTIL_TIMING_AGGREGATOR_H_
 #define CORE_UTIL_TIMING_AGGREGATOR_H_
 
+#include <algorithm>
 #include <map>
 #include <ostream>
 #include <string>
@@ -24,6 +25,8 @@
 
 namespace bdm {
 
+/// Collects execution times in nanoseconds (see `Timing`) and other sampled
+/// values.
 class TimingAggregator {
  public:
   TimingAggregator() {}
@@ -39,10 +42,17 @@ class TimingAggregator {
     }
   }
 
+  /// Records a value that is not an execution time (e.g. a batch size).
+  /// Samples are summarized by their mean, minimum and maximum.
+  void AddSample(const std::string& key, double value) {
+    samples_[key].push_back(value);
+  }
+
   void AddDescription(const std::string text) { descriptions_.push_back(text); }
 
  private:
   std::map<std::string, std::vector<int64_t>> timings_;
+  std::map<std::string, std::vector<double>> samples_;
   std::vector<std::string> descriptions_;
 
   friend std::ostream& operator<<(std::ostream& os, const TimingAggregator& p);
@@ -54,11 +64,22 @@ inline std::ostream& operator<<(std::ostream& os, const TimingAggregator& ta) {
   if (ta.timings_.size() != 0) {
     os << "\033[1mTotal execution time per operation:\033[0m" << std::endl;
     for (auto& timing : ta.timings_) {
-      os << timing.first << ": "
-         << std::accumulate(timing.second.begin(), timing.second.end(), 0)
-         << std::endl;
+      auto total_ns = std::accumulate(timing.second.begin(),
+                                      timing.second.end(), int64_t(0));
+      os << timing.first << ": " << total_ns / 1e6 << " ms" << std::endl;
     }
-  } else {
+  }
+  if (ta.samples_.size() != 0) {
+    os << "\033[1mSampled values (mean / min / max):\033[0m" << std::endl;
+    for (auto& sample : ta.samples_) {
+      auto& values = sample.second;
+      auto minmax = std::minmax_element(values.begin(), values.end());
+      os << sample.first << ": "
+         << std::accumulate(values.begin(), values.end(), 0.0) / values.size()
+         << " / " << *minmax.first << " / " << *minmax.second << std::endl;
+    }
+  }
+  if (ta.timings_.size() == 0 && ta.samples_.size() == 0) {
     os << "No statistics were gathered!" << std::endl;
   }
   return os;
@@ -21,6 +21,7 @@
 #include <vector>
 
 #include "core/default_force.h"
+#include "core/grid.h"
 #include "core/shape.h"
 #include "core/sim_object/sim_object.h"
 #include "core/util/log.h"
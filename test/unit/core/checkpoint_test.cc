@@ -0,0 +1,236 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/checkpoint.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "core/biology_module/grow_divide.h"
+#include "core/diffusion_grid.h"
+#include "core/resource_manager.h"
+#include "core/sim_object/cell.h"
+#include "core/simulation_backup.h"
+#include "gtest/gtest.h"
+#include "unit/test_util/test_util.h"
+
+namespace bdm {
+
+#define CHECKPOINT_FILE "checkpoint-test.bdm"
+
+struct CheckpointTestBm : public BaseBiologyModule {
+  CheckpointTestBm() {}
+  explicit CheckpointTestBm(double value) : value_(value) {}
+
+  BaseBiologyModule* GetInstance(const Event& event, BaseBiologyModule* other,
+                                 uint64_t new_oid = 0) const override {
+    return new CheckpointTestBm();
+  }
+
+  BaseBiologyModule* GetCopy() const override {
+    return new CheckpointTestBm(*this);
+  }
+
+  void ForEachDataMember(SoVisitor* visitor) const override {
+    BDM_SIM_OBJECT_FOREACHDM_BODY(value_)
+    BaseBiologyModule::ForEachDataMember(visitor);
+  }
+
+  void Run(SimObject* so) override {}
+
+  double value_ = 0;
+};
+
+/// Not registered with `Checkpoint`
+class UnregisteredCell : public Cell {
+  BDM_SIM_OBJECT_HEADER(UnregisteredCell, Cell, 1, dummy_);
+
+ public:
+  UnregisteredCell() {}
+  UnregisteredCell(const Event& event, SimObject* other, uint64_t new_oid = 0)
+      : Base(event, other, new_oid) {}
+
+ private:
+  int dummy_ = 0;
+};
+
+inline void CreateCellsAndSubstance(ResourceManager* rm) {
+  for (uint64_t i = 0; i < 1000; i++) {
+    auto* cell = new Cell({i * 1.0, i * 2.0, i * 3.0});
+    cell->SetDiameter(10 + i % 7);
+    if (i % 3 == 0) {
+      cell->AddBiologyModule(new GrowDivide());
+    }
+    if (i % 5 == 0) {
+      cell->AddBiologyModule(new CheckpointTestBm(i));
+    }
+    rm->push_back(cell);
+  }
+
+  auto* dgrid = new DiffusionGrid(0, "Substance", 0.4, 0.01, 5);
+  dgrid->Initialize({0, 50, 0, 50, 0, 50});
+  for (size_t i = 0; i < dgrid->GetNumBoxes(); i++) {
+    dgrid->IncreaseConcentrationBy(i, i * 0.5);
+  }
+  dgrid->CalculateGradient();
+  rm->AddDiffusionGrid(dgrid);
+}
+
+TEST(CheckpointTest, WriteAndRestore) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  Checkpoint::RegisterBiologyModule<CheckpointTestBm>();
+  CreateCellsAndSubstance(rm);
+
+  remove(CHECKPOINT_FILE);
+  Checkpoint::Write(CHECKPOINT_FILE, 12);
+  EXPECT_TRUE(Checkpoint::IsCheckpoint(CHECKPOINT_FILE));
+  EXPECT_EQ(12u, Checkpoint::GetSimulationSteps(CHECKPOINT_FILE));
+
+  // keep a copy of the original state
+  std::vector<Cell*> expected;
+  rm->ApplyOnAllElements([&](SimObject* so) {
+    expected.push_back(static_cast<Cell*>(so->GetCopy()));
+  });
+  auto* expected_grid = rm->GetDiffusionGrid(0);
+  std::vector<double> expected_concentrations(
+      expected_grid->GetAllConcentrations(),
+      expected_grid->GetAllConcentrations() + expected_grid->GetNumBoxes());
+  std::vector<double> expected_gradients(
+      expected_grid->GetAllGradients(),
+      expected_grid->GetAllGradients() + 3 * expected_grid->GetNumBoxes());
+  auto expected_dims = expected_grid->GetDimensions();
+  auto last_uid = SoUidGenerator::Get()->GetLastId();
+
+  // modify the simulation
+  rm->push_back(new Cell(3));
+  expected_grid->IncreaseConcentrationBy(0, 100);
+
+  Checkpoint::Restore(CHECKPOINT_FILE);
+
+  EXPECT_EQ(last_uid, SoUidGenerator::Get()->GetLastId());
+  ASSERT_EQ(expected.size(), rm->GetNumSimObjects());
+  for (auto* exp : expected) {
+    auto uid = exp->GetUid();
+    ASSERT_TRUE(rm->Contains(uid));
+    auto* cell = dynamic_cast<Cell*>(rm->GetSimObject(uid));
+    ASSERT_TRUE(cell != nullptr);
+    EXPECT_EQ(exp->GetPosition(), cell->GetPosition());
+    EXPECT_EQ(exp->GetDiameter(), cell->GetDiameter());
+    EXPECT_EQ(exp->GetVolume(), cell->GetVolume());
+    EXPECT_EQ(exp->GetBoxIdx(), cell->GetBoxIdx());
+
+    const auto& exp_bms = exp->GetAllBiologyModules();
+    const auto& bms = cell->GetAllBiologyModules();
+    ASSERT_EQ(exp_bms.size(), bms.size());
+    for (size_t i = 0; i < bms.size(); i++) {
+      EXPECT_EQ(typeid(*exp_bms[i]), typeid(*bms[i]));
+      EXPECT_EQ(exp_bms[i]->Copy(gAllEventIds), bms[i]->Copy(gAllEventIds));
+      if (auto* test_bm = dynamic_cast<CheckpointTestBm*>(bms[i])) {
+        EXPECT_EQ(static_cast<CheckpointTestBm*>(exp_bms[i])->value_,
+                  test_bm->value_);
+      }
+    }
+    delete exp;
+  }
+
+  auto* dgrid = rm->GetDiffusionGrid(0);
+  EXPECT_EQ("Substance", dgrid->GetSubstanceName());
+  EXPECT_EQ(expected_dims, dgrid->GetDimensions());
+  ASSERT_EQ(expected_concentrations.size(), dgrid->GetNumBoxes());
+  for (size_t i = 0; i < dgrid->GetNumBoxes(); i++) {
+    EXPECT_EQ(expected_concentrations[i], dgrid->GetAllConcentrations()[i]);
+    EXPECT_EQ(expected_gradients[3 * i + 2],
+              dgrid->GetAllGradients()[3 * i + 2]);
+  }
+
+  remove(CHECKPOINT_FILE);
+}
+
+TEST(CheckpointTest, IsCheckpoint) {
+  remove(CHECKPOINT_FILE);
+  EXPECT_FALSE(Checkpoint::IsCheckpoint(CHECKPOINT_FILE));
+  {
+    std::ofstream ofs(CHECKPOINT_FILE);
+    ofs << "no checkpoint";
+  }
+  EXPECT_FALSE(Checkpoint::IsCheckpoint(CHECKPOINT_FILE));
+  remove(CHECKPOINT_FILE);
+}
+
+TEST(CheckpointTest, SimulationBackup) {
+  auto set_param = [](Param* param) { param->native_backup_ = true; };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* cell = new Cell(6);
+  auto uid = cell->GetUid();
+  rm->push_back(new Cell(5));
+  rm->push_back(cell);
+
+  remove(CHECKPOINT_FILE);
+  SimulationBackup backup(CHECKPOINT_FILE, "");
+  backup.Backup(7);
+  backup.BackupAsync(8);
+  backup.WaitForAsyncBackup();
+  rm->Clear();
+
+  SimulationBackup restore("", CHECKPOINT_FILE);
+  EXPECT_EQ(8u, restore.GetSimulationStepsFromBackup());
+  restore.Restore();
+  EXPECT_EQ(2u, rm->GetNumSimObjects());
+  ASSERT_TRUE(rm->Contains(uid));
+  EXPECT_EQ(6, rm->GetSimObject(uid)->GetDiameter());
+
+  remove(CHECKPOINT_FILE);
+}
+
+TEST(CheckpointDeathTest, UnregisteredSimObject) {
+  ASSERT_DEATH(
+      {
+        Simulation simulation("CheckpointDeathTest_UnregisteredSimObject");
+        simulation.GetResourceManager()->push_back(new UnregisteredCell());
+        Checkpoint::Write(CHECKPOINT_FILE, 0, false);
+      },
+      ".*has not been registered.*");
+  remove(CHECKPOINT_FILE);
+}
+
+TEST(CheckpointDeathTest, Truncated) {
+  ASSERT_DEATH(
+      {
+        Simulation simulation("CheckpointDeathTest_Truncated");
+        Checkpoint::RegisterBiologyModule<CheckpointTestBm>();
+        CreateCellsAndSubstance(simulation.GetResourceManager());
+        Checkpoint::Write(CHECKPOINT_FILE, 0, false);
+
+        std::string content;
+        {
+          std::ifstream ifs(CHECKPOINT_FILE, std::ios::binary);
+          content.assign(std::istreambuf_iterator<char>(ifs),
+                         std::istreambuf_iterator<char>());
+        }
+        {
+          std::ofstream ofs(CHECKPOINT_FILE, std::ios::binary);
+          ofs.write(content.data(), content.size() / 2);
+        }
+        Checkpoint::Restore(CHECKPOINT_FILE);
+      },
+      ".*truncated or corrupted.*");
+  remove(CHECKPOINT_FILE);
+}
+
+}  // namespace bdm
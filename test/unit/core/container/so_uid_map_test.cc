@@ -0,0 +1,100 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/container/so_uid_map.h"
+#include <gtest/gtest.h>
+
+namespace bdm {
+
+TEST(SoUidMapTest, Basics) {
+  SoUidMap<int> map;
+  EXPECT_FALSE(map.Contains(0));
+  EXPECT_EQ(0, map[123]);
+
+  map.Insert(100, 1);
+  map.Insert(105, 2);
+  EXPECT_TRUE(map.Contains(100));
+  EXPECT_FALSE(map.Contains(101));
+  EXPECT_TRUE(map.Contains(105));
+  EXPECT_EQ(2, map[105]);
+
+  // uid on a different page
+  map.Insert(5000, 3);
+  EXPECT_EQ(3, map[5000]);
+  EXPECT_EQ(1, map[100]);
+  EXPECT_EQ(2, map[105]);
+  EXPECT_FALSE(map.Contains(4999));
+
+  map.Remove(100);
+  map.Remove(1000000);
+  EXPECT_FALSE(map.Contains(100));
+  EXPECT_TRUE(map.Contains(105));
+
+  map.clear();
+  EXPECT_FALSE(map.Contains(105));
+  EXPECT_EQ(0u, map.size());
+}
+
+TEST(SoUidMapTest, ParallelInsert) {
+  SoUidMap<uint64_t> map;
+  map.Reserve(10010);
+  // pages are allocated on demand
+  EXPECT_EQ(0u, map.size());
+
+#pragma omp parallel for
+  for (uint64_t uid = 10; uid < 10010; uid++) {
+    map.Insert(uid, uid + 1);
+  }
+
+  EXPECT_LE(10010u, map.size());
+  for (uint64_t uid = 10; uid < 10010; uid++) {
+    EXPECT_EQ(uid + 1, map[uid]);
+  }
+}
+
+TEST(SoUidMapTest, ShrinkToFit) {
+  uint64_t page_size = SoUidMap<int>::kPageSize;
+  SoUidMap<int> map;
+  for (uint64_t i = 0; i < 10 * page_size; i++) {
+    map.Insert(i, i + 1);
+  }
+  EXPECT_EQ(10 * page_size, map.size());
+
+  // a long-lived simulation object with a small uid does not keep the
+  // other pages alive
+  for (uint64_t i = 1; i < 10 * page_size; i++) {
+    if (i != 5 * page_size + 3) {
+      map.Remove(i);
+    }
+  }
+  map.ShrinkToFit();
+  EXPECT_EQ(2 * page_size, map.size());
+  EXPECT_EQ(1, map[0]);
+  EXPECT_EQ(static_cast<int>(5 * page_size + 4), map[5 * page_size + 3]);
+  EXPECT_FALSE(map.Contains(5 * page_size + 2));
+  EXPECT_FALSE(map.Contains(3 * page_size));
+
+  // released pages are allocated again
+  map.Insert(3 * page_size, 7);
+  EXPECT_EQ(7, map[3 * page_size]);
+  EXPECT_EQ(3 * page_size, map.size());
+
+  map.Remove(0);
+  map.Remove(3 * page_size);
+  map.Remove(5 * page_size + 3);
+  map.ShrinkToFit();
+  EXPECT_EQ(0u, map.size());
+}
+
+}  // namespace bdm
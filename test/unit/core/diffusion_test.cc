@@ -12,6 +12,7 @@
 //
 // -----------------------------------------------------------------------------
 
+#include <algorithm>
 #include <fstream>
 
 #include "core/diffusion_grid.h"
@@ -343,6 +344,44 @@ TEST(DiffusionTest, CopyOldData) {
   delete d_grid;
 }
 
+// Slabs processed in any order must give the same result as the parallel
+// update of the whole grid
+TEST(DiffusionTest, Slabs) {
+  for (bool leaking_edges : {false, true}) {
+    DiffusionGrid expected(0, "Kalium", 0.4, 0.01, 11);
+    DiffusionGrid actual(0, "Kalium", 0.4, 0.01, 11);
+    for (auto* d_grid : {&expected, &actual}) {
+      d_grid->Initialize({-100, 100, -100, 100, -100, 100});
+      d_grid->IncreaseConcentrationBy({{0, 0, 0}}, 4);
+      d_grid->IncreaseConcentrationBy({{-90, 50, 90}}, 2);
+    }
+
+    auto nz = actual.GetNumBoxesArray()[2];
+    for (int i = 0; i < 5; i++) {
+      if (leaking_edges) {
+        expected.DiffuseEulerLeakingEdge();
+      } else {
+        expected.DiffuseEuler();
+      }
+      for (size_t z = nz; z > 0; z -= std::min<size_t>(z, 3)) {
+        auto z_begin = z - std::min<size_t>(z, 3);
+        if (leaking_edges) {
+          actual.DiffuseEulerLeakingEdgeSlab(z_begin, z);
+        } else {
+          actual.DiffuseEulerSlab(z_begin, z);
+        }
+      }
+      actual.FinishDiffusion();
+    }
+
+    ASSERT_EQ(expected.GetNumBoxes(), actual.GetNumBoxes());
+    for (size_t i = 0; i < expected.GetNumBoxes(); i++) {
+      EXPECT_EQ(expected.GetAllConcentrations()[i],
+                actual.GetAllConcentrations()[i]);
+    }
+  }
+}
+
 #ifdef USE_DICT
 
 // Test if all the data members of the diffusion grid are correctly serialized
@@ -164,6 +164,29 @@ TEST(InPlaceExecutionContext, Execute) {
   EXPECT_TRUE(op2_called);
 }
 
+TEST(InPlaceExecutionContext, ExecuteUpdatesSoAStore) {
+  Simulation sim(TEST_NAME);
+  auto* rm = sim.GetResourceManager();
+  auto* ctxt = sim.GetExecutionContext();
+
+  ctxt->DisableNeighborGuard();
+
+  auto* cell = new Cell({1, 2, 3});
+  cell->SetDiameter(10);
+  rm->push_back(cell);
+  rm->UpdateSoAStore();
+
+  auto op = Operation("op", [](SimObject* so) {
+    so->SetPosition({4, 5, 6});
+    so->SetDiameter(20);
+  });
+  ctxt->Execute(cell, {op});
+
+  auto soh = rm->GetSoHandle(cell->GetUid());
+  EXPECT_EQ(Double3({4, 5, 6}), rm->GetSoAPosition(soh));
+  EXPECT_EQ(20, rm->GetSoADiameter(soh));
+}
+
 TEST(InPlaceExecutionContext, ExecuteThreadSafety) {
   Simulation sim(TEST_NAME);
   auto* rm = sim.GetResourceManager();
@@ -217,4 +240,98 @@ TEST(InPlaceExecutionContext, ExecuteThreadSafety) {
   });
 }
 
+TEST(InPlaceExecutionContext, ForEachNeighborTemplateAndStdFunction) {
+  auto set_param = [](auto* param) { param->cache_neighbors_ = true; };
+  Simulation sim(TEST_NAME, set_param);
+  auto* rm = sim.GetResourceManager();
+  auto* ctxt = sim.GetExecutionContext();
+
+  auto construct = [](const Double3& position) {
+    Cell* cell = new Cell(position);
+    cell->SetDiameter(10);
+    return cell;
+  };
+  ModelInitializer::Grid3D(4, 10, construct);
+  sim.GetGrid()->Initialize();
+
+  SimObject* query = nullptr;
+  rm->ApplyOnAllElements([&](SimObject* so) {
+    if (so->GetPosition() == Double3({10, 10, 10})) {
+      query = so;
+    }
+  });
+  ASSERT_NE(nullptr, query);
+
+  std::vector<SoUid> expected;
+  std::function<void(const SimObject*)> std_function =
+      [&](const SimObject* neighbor) { expected.push_back(neighbor->GetUid()); };
+  ctxt->ForEachNeighborWithinRadius(std_function, *query, 101);
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(6u, expected.size());
+
+  // template version; populates the neighbor cache
+  std::vector<SoUid> actual;
+  ctxt->ForEachNeighbor(
+      [&](const SimObject* neighbor, double squared_distance) {
+        if (squared_distance < 101) {
+          actual.push_back(neighbor->GetUid());
+        }
+      },
+      *query);
+  std::sort(actual.begin(), actual.end());
+  EXPECT_EQ(expected, actual);
+
+  // template version; uses the neighbor cache
+  actual.clear();
+  ctxt->ForEachNeighborWithinRadius(
+      [&](const auto* neighbor) { actual.push_back(neighbor->GetUid()); },
+      *query, 101);
+  std::sort(actual.begin(), actual.end());
+  EXPECT_EQ(expected, actual);
+}
+
+TEST(InPlaceExecutionContext, LargeRadiusAndKNearestNeighbors) {
+  auto set_param = [](auto* param) { param->cache_neighbors_ = true; };
+  Simulation sim(TEST_NAME, set_param);
+  auto* rm = sim.GetResourceManager();
+  auto* ctxt = sim.GetExecutionContext();
+
+  auto construct = [](const Double3& position) {
+    Cell* cell = new Cell(position);
+    cell->SetDiameter(10);
+    return cell;
+  };
+  ModelInitializer::Grid3D(4, 10, construct);
+  sim.GetGrid()->Initialize();
+
+  SimObject* query = nullptr;
+  rm->ApplyOnAllElements([&](SimObject* so) {
+    if (so->GetPosition() == Double3({10, 10, 10})) {
+      query = so;
+    }
+  });
+  ASSERT_NE(nullptr, query);
+
+  // populates the neighbor cache
+  uint64_t cnt = 0;
+  ctxt->ForEachNeighborWithinRadius([&](const SimObject*) { cnt++; }, *query,
+                                    101);
+  EXPECT_EQ(6u, cnt);
+
+  // radius exceeds the cached neighbors
+  cnt = 0;
+  ctxt->ForEachNeighborWithinRadius([&](const SimObject*) { cnt++; }, *query,
+                                    2501);
+  EXPECT_EQ(63u, cnt);
+
+  auto neighbors = ctxt->GetKNearestNeighbors(*query, 7);
+  ASSERT_EQ(7u, neighbors.size());
+  for (uint64_t i = 0; i < 6; i++) {
+    auto diff = neighbors[i]->GetPosition() - query->GetPosition();
+    EXPECT_NEAR(100, diff * diff, abs_error<double>::value);
+  }
+  auto diff = neighbors[6]->GetPosition() - query->GetPosition();
+  EXPECT_NEAR(200, diff * diff, abs_error<double>::value);
+}
+
 }  // namespace bdm
@@ -12,7 +12,17 @@
 //
 // -----------------------------------------------------------------------------
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <set>
+#include <string>
+#include <thread>
+
+#include <morton/morton.h>
+
 #include "core/grid.h"
+#include "core/scheduler.h"
 #include "core/sim_object/cell.h"
 #include "gtest/gtest.h"
 #include "unit/test_util/test_util.h"
@@ -193,6 +203,546 @@ TEST(GridTest, NoRaceConditionDuringUpdate) {
   }
 }
 
+TEST(GridTest, IncrementalUpdateGrid) {
+  auto set_param = [](auto* param) { param->incremental_grid_update_ = true; };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid = simulation.GetGrid();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+  CellFactory(rm, 4);
+
+  grid->Initialize();
+
+  // Remove cells 1 and 42
+  rm->Remove(ref_uid + 1);
+  rm->Remove(ref_uid + 42);
+
+  RunUpdateGridTest(&simulation, ref_uid);
+}
+
+// Returns the sorted uids of all neighbors for each simulation object
+std::unordered_map<SoUid, std::vector<SoUid>> GetAllNeighbors(
+    ResourceManager* rm, SpatialIndex* index) {
+  std::unordered_map<SoUid, std::vector<SoUid>> neighbors;
+  rm->ApplyOnAllElements([&](SimObject* so) {
+    auto& so_neighbors = neighbors[so->GetUid()];
+    index->ForEachNeighbor(
+        [&](const SimObject* neighbor) {
+          so_neighbors.push_back(neighbor->GetUid());
+        },
+        *so);
+    std::sort(so_neighbors.begin(), so_neighbors.end());
+  });
+  return neighbors;
+}
+
+TEST(GridTest, IncrementalUpdateGridMovedAddedAndRemoved) {
+  auto set_param = [](auto* param) { param->incremental_grid_update_ = true; };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid = simulation.GetGrid();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+  CellFactory(rm, 4);
+
+  grid->Initialize();
+  auto num_boxes = grid->GetNumBoxes();
+
+  // move cells to different boxes inside the current grid dimensions
+  rm->GetSimObject(ref_uid)->SetPosition({40, 40, 40});
+  rm->GetSimObject(ref_uid + 63)->SetPosition({1, 2, 3});
+  rm->GetSimObject(ref_uid + 21)->SetPosition({59, 0, 20});
+  // remove and add cells
+  rm->Remove(ref_uid + 5);
+  rm->Remove(ref_uid + 30);
+  auto* new_cell = new Cell({25, 25, 25});
+  new_cell->SetDiameter(30);
+  rm->push_back(new_cell);
+
+  grid->UpdateGrid();
+  // grid must not have been rebuilt
+  EXPECT_EQ(num_boxes, grid->GetNumBoxes());
+  EXPECT_FALSE(grid->HasGrown());
+  auto incremental = GetAllNeighbors(rm, grid);
+
+  grid->ClearGrid();
+  grid->UpdateGrid();
+  auto rebuilt = GetAllNeighbors(rm, grid);
+
+  EXPECT_EQ(63u, incremental.size());
+  EXPECT_EQ(rebuilt, incremental);
+}
+
+TEST(GridTest, IncrementalUpdateGridFallsBackToRebuild) {
+  auto set_param = [](auto* param) { param->incremental_grid_update_ = true; };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid = simulation.GetGrid();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+  CellFactory(rm, 3);
+
+  grid->Initialize();
+
+  rm->GetSimObject(ref_uid)->SetPosition({{100, 0, 0}});
+  grid->UpdateGrid();
+  std::array<int32_t, 6> expected_dim = {{-30, 150, -30, 90, -30, 90}};
+  EXPECT_EQ(expected_dim, grid->GetDimensions());
+  EXPECT_TRUE(grid->HasGrown());
+
+  auto incremental = GetAllNeighbors(rm, grid);
+  grid->ClearGrid();
+  grid->UpdateGrid();
+  EXPECT_EQ(GetAllNeighbors(rm, grid), incremental);
+}
+
+TEST(GridTest, CompactLayoutUpdateGrid) {
+  auto set_param = [](auto* param) { param->compact_grid_layout_ = true; };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid = simulation.GetGrid();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+  CellFactory(rm, 4);
+
+  // make sure that there are multiple cells per box
+  rm->GetSimObject(ref_uid)->SetDiameter(60);
+
+  grid->Initialize();
+
+  // Remove cells 1 and 42
+  rm->Remove(ref_uid + 1);
+  rm->Remove(ref_uid + 42);
+
+  for (uint16_t i = 0; i < 10; i++) {
+    RunUpdateGridTest(&simulation, ref_uid);
+  }
+}
+
+TEST(GridTest, CompactLayoutSameNeighborsAsLinkedList) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid = simulation.GetGrid();
+  auto* param = simulation.GetParam();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+  CellFactory(rm, 5);
+  rm->GetSimObject(ref_uid + 7)->SetPosition({3, 4, 5});
+  rm->GetSimObject(ref_uid + 12)->SetDiameter(45);
+
+  grid->Initialize();
+  auto linked_list = GetAllNeighbors(rm, grid);
+  std::vector<SoHandle> linked_list_zorder;
+  grid->IterateZOrder(
+      [&](const SoHandle& soh) { linked_list_zorder.push_back(soh); });
+
+  const_cast<Param*>(param)->compact_grid_layout_ = true;
+  grid->UpdateGrid();
+  auto compact = GetAllNeighbors(rm, grid);
+  std::vector<SoHandle> compact_zorder;
+  grid->IterateZOrder(
+      [&](const SoHandle& soh) { compact_zorder.push_back(soh); });
+
+  EXPECT_EQ(125u, compact.size());
+  EXPECT_EQ(linked_list, compact);
+  EXPECT_EQ(125u, compact_zorder.size());
+  std::sort(linked_list_zorder.begin(), linked_list_zorder.end());
+  std::sort(compact_zorder.begin(), compact_zorder.end());
+  EXPECT_EQ(linked_list_zorder, compact_zorder);
+}
+
+// Returns the sorted uids of all neighbors within `radius` for each
+// simulation object
+std::unordered_map<SoUid, std::vector<SoUid>> GetAllNeighborsWithinRadius(
+    ResourceManager* rm, SpatialIndex* index, double radius) {
+  std::unordered_map<SoUid, std::vector<SoUid>> neighbors;
+  rm->ApplyOnAllElements([&](SimObject* so) {
+    auto& so_neighbors = neighbors[so->GetUid()];
+    index->ForEachNeighborWithinRadius(
+        [&](const SimObject* neighbor) {
+          so_neighbors.push_back(neighbor->GetUid());
+        },
+        *so, radius * radius);
+    std::sort(so_neighbors.begin(), so_neighbors.end());
+  });
+  return neighbors;
+}
+
+TEST(GridTest, SmallBoxLength) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid = simulation.GetGrid();
+  auto* param = const_cast<Param*>(simulation.GetParam());
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+  CellFactory(rm, 4);
+  rm->GetSimObject(ref_uid + 5)->SetPosition({7, 11, 13});
+  rm->GetSimObject(ref_uid + 9)->SetDiameter(10);
+
+  grid->Initialize();
+  EXPECT_EQ(30u, grid->GetBoxLength());
+  EXPECT_EQ(1u, grid->GetStencilRadius());
+  auto expected = GetAllNeighborsWithinRadius(rm, grid, 30);
+
+  param->grid_box_length_factor_ = 0.25;
+  grid->UpdateGrid();
+  EXPECT_EQ(8u, grid->GetBoxLength());
+  EXPECT_EQ(4u, grid->GetStencilRadius());
+  EXPECT_EQ(expected, GetAllNeighborsWithinRadius(rm, grid, 30));
+
+  param->compact_grid_layout_ = true;
+  grid->UpdateGrid();
+  EXPECT_EQ(expected, GetAllNeighborsWithinRadius(rm, grid, 30));
+}
+
+TEST(GridTest, Adjacency) {
+  auto set_param = [](auto* param) { param->grid_box_length_factor_ = 0.5; };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid = simulation.GetGrid();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+  // query, face, edge and corner neighbor
+  std::vector<Double3> positions = {
+      {15, 15, 15}, {25, 15, 15}, {25, 25, 15}, {25, 25, 25}};
+  for (auto& pos : positions) {
+    auto* cell = new Cell(pos);
+    cell->SetDiameter(20);
+    rm->push_back(cell);
+  }
+
+  auto get_neighbors = [&]() {
+    std::vector<SoUid> neighbors;
+    grid->ForEachNeighbor(
+        [&](const SimObject* neighbor) {
+          neighbors.push_back(neighbor->GetUid() - ref_uid);
+        },
+        *rm->GetSimObject(ref_uid));
+    std::sort(neighbors.begin(), neighbors.end());
+    return neighbors;
+  };
+
+  grid->Initialize(Grid::kLow);
+  EXPECT_EQ(10u, grid->GetBoxLength());
+  EXPECT_EQ(2u, grid->GetStencilRadius());
+  EXPECT_EQ(std::vector<SoUid>({1}), get_neighbors());
+
+  grid->Initialize(Grid::kMedium);
+  EXPECT_EQ(std::vector<SoUid>({1, 2}), get_neighbors());
+
+  grid->Initialize(Grid::kHigh);
+  EXPECT_EQ(std::vector<SoUid>({1, 2, 3}), get_neighbors());
+}
+
+// Returns the sorted uids of all simulation objects within `radius` for each
+// simulation object. Compares all pairs of simulation objects.
+std::unordered_map<SoUid, std::vector<SoUid>> GetAllNeighborsBruteForce(
+    ResourceManager* rm, double radius) {
+  std::unordered_map<SoUid, std::vector<SoUid>> neighbors;
+  rm->ApplyOnAllElements([&](SimObject* so) {
+    auto& so_neighbors = neighbors[so->GetUid()];
+    rm->ApplyOnAllElements([&](SimObject* neighbor) {
+      auto diff = neighbor->GetPosition() - so->GetPosition();
+      if (neighbor != so && diff * diff < radius * radius) {
+        so_neighbors.push_back(neighbor->GetUid());
+      }
+    });
+    std::sort(so_neighbors.begin(), so_neighbors.end());
+  });
+  return neighbors;
+}
+
+TEST(GridTest, VerletLists) {
+  auto set_param = [](auto* param) {
+    param->verlet_lists_ = true;
+    param->verlet_skin_ = 10;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid = simulation.GetGrid();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+  CellFactory(rm, 4);
+
+  grid->Initialize();
+  EXPECT_EQ(1u, grid->GetNumVerletListBuilds());
+  EXPECT_EQ(GetAllNeighborsBruteForce(rm, 30),
+            GetAllNeighborsWithinRadius(rm, grid, 30));
+
+  // Small displacements (below half of the skin distance minus the maximum
+  // displacement per iteration) must not trigger a rebuild
+  uint64_t cnt = 0;
+  rm->ApplyOnAllElements([&](SimObject* so) {
+    double d = static_cast<double>(cnt++ % 3) - 1.0;
+    so->SetPosition(so->GetPosition() + Double3{d, -d, 0.5 * d});
+  });
+  grid->UpdateGrid();
+  EXPECT_EQ(1u, grid->GetNumVerletListBuilds());
+  EXPECT_FALSE(grid->HasGrown());
+  EXPECT_EQ(GetAllNeighborsBruteForce(rm, 30),
+            GetAllNeighborsWithinRadius(rm, grid, 30));
+
+  // Large displacement
+  rm->GetSimObject(ref_uid + 21)->SetPosition({35, 35, 35});
+  grid->UpdateGrid();
+  EXPECT_EQ(2u, grid->GetNumVerletListBuilds());
+  EXPECT_EQ(GetAllNeighborsBruteForce(rm, 30),
+            GetAllNeighborsWithinRadius(rm, grid, 30));
+
+  // Added and removed simulation objects
+  auto* new_cell = new Cell({25, 25, 25});
+  new_cell->SetDiameter(30);
+  rm->push_back(new_cell);
+  rm->Remove(ref_uid + 5);
+  grid->UpdateGrid();
+  EXPECT_EQ(3u, grid->GetNumVerletListBuilds());
+  EXPECT_EQ(GetAllNeighborsBruteForce(rm, 30),
+            GetAllNeighborsWithinRadius(rm, grid, 30));
+
+  // Simulation object larger than the largest object at build time
+  rm->GetSimObject(ref_uid + 42)->SetDiameter(35);
+  grid->UpdateGrid();
+  EXPECT_EQ(4u, grid->GetNumVerletListBuilds());
+  EXPECT_EQ(35, grid->GetLargestObjectSize());
+  EXPECT_EQ(GetAllNeighborsBruteForce(rm, 35),
+            GetAllNeighborsWithinRadius(rm, grid, 35));
+
+  // Neighbors found without radius contain all neighbors within the largest
+  // object size
+  auto all = GetAllNeighbors(rm, grid);
+  for (auto& el : GetAllNeighborsBruteForce(rm, 35)) {
+    EXPECT_TRUE(std::includes(all[el.first].begin(), all[el.first].end(),
+                              el.second.begin(), el.second.end()));
+  }
+}
+
+TEST(GridTest, VerletListsNewSimObject) {
+  auto set_param = [](auto* param) {
+    param->verlet_lists_ = true;
+    param->verlet_skin_ = 10;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid = simulation.GetGrid();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+  CellFactory(rm, 4);
+  grid->Initialize();
+  auto brute_force = GetAllNeighborsBruteForce(rm, 30);
+
+  // A daughter cell that has been created during this iteration is not yet
+  // stored in the ResourceManager. Hence, it has no Verlet list.
+  auto* mother = rm->GetSimObject(ref_uid + 21);
+  Cell daughter(mother->GetPosition());
+  daughter.SetDiameter(30);
+  daughter.SetBoxIdx(mother->GetBoxIdx());
+  EXPECT_FALSE(rm->Contains(daughter.GetUid()));
+
+  auto expected = brute_force[mother->GetUid()];
+  expected.push_back(mother->GetUid());
+  std::sort(expected.begin(), expected.end());
+
+  std::vector<SoUid> neighbors;
+  grid->ForEachNeighborWithinRadius(
+      [&](const SimObject* neighbor) {
+        neighbors.push_back(neighbor->GetUid());
+      },
+      daughter, 900);
+  std::sort(neighbors.begin(), neighbors.end());
+  EXPECT_EQ(expected, neighbors);
+
+  neighbors.clear();
+  grid->ForEachNeighbor(
+      [&](const SimObject* neighbor, double squared_distance) {
+        if (squared_distance < 900) {
+          neighbors.push_back(neighbor->GetUid());
+        }
+      },
+      daughter);
+  std::sort(neighbors.begin(), neighbors.end());
+  EXPECT_EQ(expected, neighbors);
+
+  // a SoHandle provided by the caller gives the same result as the lookup
+  auto soh = rm->GetSoHandle(mother->GetUid());
+  std::vector<SoUid> with_soh;
+  std::vector<SoUid> without_soh;
+  grid->ForEachNeighbor(
+      [&](const SimObject* neighbor) {
+        with_soh.push_back(neighbor->GetUid());
+      },
+      *mother, soh);
+  grid->ForEachNeighbor(
+      [&](const SimObject* neighbor) {
+        without_soh.push_back(neighbor->GetUid());
+      },
+      *mother);
+  EXPECT_EQ(without_soh, with_soh);
+  EXPECT_LT(0u, with_soh.size());
+}
+
+TEST(GridTest, ForEachNeighborWithinLargeRadius) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid = simulation.GetGrid();
+  auto* param = const_cast<Param*>(simulation.GetParam());
+
+  CellFactory(rm, 5);
+
+  grid->Initialize();
+  EXPECT_EQ(30, grid->GetNeighborSearchRadius());
+  auto expected = GetAllNeighborsBruteForce(rm, 75);
+  EXPECT_EQ(expected, GetAllNeighborsWithinRadius(rm, grid, 75));
+  // radius larger than the grid
+  EXPECT_EQ(GetAllNeighborsBruteForce(rm, 500),
+            GetAllNeighborsWithinRadius(rm, grid, 500));
+
+  param->compact_grid_layout_ = true;
+  grid->UpdateGrid();
+  EXPECT_EQ(expected, GetAllNeighborsWithinRadius(rm, grid, 75));
+
+  param->verlet_lists_ = true;
+  grid->UpdateGrid();
+  rm->ApplyOnAllElements([&](SimObject* so) {
+    so->SetPosition(so->GetPosition() + Double3{1, 1, -1});
+  });
+  grid->UpdateGrid();
+  EXPECT_EQ(1u, grid->GetNumVerletListBuilds());
+  EXPECT_EQ(expected, GetAllNeighborsWithinRadius(rm, grid, 75));
+}
+
+// Returns the `k` nearest neighbors of `query` sorted by distance and uid.
+// Compares the query with all simulation objects.
+std::vector<SoUid> GetKNearestNeighborsBruteForce(ResourceManager* rm,
+                                                  const SimObject& query,
+                                                  uint64_t k) {
+  std::vector<std::pair<double, SoUid>> all;
+  rm->ApplyOnAllElements([&](SimObject* so) {
+    if (so != &query) {
+      auto diff = so->GetPosition() - query.GetPosition();
+      all.push_back({diff * diff, so->GetUid()});
+    }
+  });
+  std::sort(all.begin(), all.end());
+  std::vector<SoUid> neighbors;
+  for (uint64_t i = 0; i < std::min<uint64_t>(k, all.size()); i++) {
+    neighbors.push_back(all[i].second);
+  }
+  return neighbors;
+}
+
+void RunKNearestNeighborsTest(ResourceManager* rm, SpatialIndex* index) {
+  for (uint64_t k : {1, 6, 20, 124, 200}) {
+    rm->ApplyOnAllElements([&](SimObject* so) {
+      std::vector<SoUid> actual;
+      for (auto* neighbor : index->GetKNearestNeighbors(*so, k)) {
+        actual.push_back(neighbor->GetUid());
+      }
+      EXPECT_EQ(GetKNearestNeighborsBruteForce(rm, *so, k), actual);
+    });
+  }
+}
+
+TEST(GridTest, GetKNearestNeighbors) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid = simulation.GetGrid();
+  auto* param = const_cast<Param*>(simulation.GetParam());
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+  CellFactory(rm, 5);
+  rm->GetSimObject(ref_uid + 7)->SetPosition({3, 4, 5});
+  rm->GetSimObject(ref_uid + 31)->SetPosition({47, 61, 13});
+
+  grid->Initialize();
+  auto* query = rm->GetSimObject(ref_uid);
+  EXPECT_EQ(0u, grid->GetKNearestNeighbors(*query, 0).size());
+  RunKNearestNeighborsTest(rm, grid);
+
+  param->grid_box_length_factor_ = 0.25;
+  grid->UpdateGrid();
+  RunKNearestNeighborsTest(rm, grid);
+
+  param->verlet_lists_ = true;
+  grid->UpdateGrid();
+  rm->GetSimObject(ref_uid + 12)->SetPosition({41, 39, 1});
+  grid->UpdateGrid();
+  EXPECT_EQ(1u, grid->GetNumVerletListBuilds());
+  RunKNearestNeighborsTest(rm, grid);
+}
+
+TEST(GridTest, ApplyOnAllElementsColored) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid = simulation.GetGrid();
+  auto* param = const_cast<Param*>(simulation.GetParam());
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+  CellFactory(rm, 8);
+
+  for (double factor : {1.0, 0.5}) {
+    param->grid_box_length_factor_ = factor;
+    grid->UpdateGrid();
+
+    // Each simulation object marks all boxes within the stencil radius of its
+    // box as used while it is processed. A box must never be used by two
+    // simulation objects at the same time.
+    int64_t sr = grid->GetStencilRadius();
+    auto num_boxes_axis = grid->GetNumBoxesAxis();
+    std::vector<std::atomic<int>> used(grid->GetNumBoxes());
+    for (auto& el : used) {
+      el = 0;
+    }
+    std::atomic<uint64_t> conflicts(0);
+    std::vector<std::atomic<int>> visits(rm->GetNumSimObjects());
+    for (auto& el : visits) {
+      el = 0;
+    }
+
+    auto for_each_box = [&](const SimObject* so, const auto& lambda) {
+      auto center = grid->GetBoxCoordinates(so->GetBoxIdx());
+      for (int64_t z = -sr; z <= sr; z++) {
+        for (int64_t y = -sr; y <= sr; y++) {
+          for (int64_t x = -sr; x <= sr; x++) {
+            int64_t bx = center[0] + x, by = center[1] + y, bz = center[2] + z;
+            if (bx >= 0 && by >= 0 && bz >= 0 && bx < num_boxes_axis[0] &&
+                by < num_boxes_axis[1] && bz < num_boxes_axis[2]) {
+              lambda(bz * num_boxes_axis[0] * num_boxes_axis[1] +
+                     by * num_boxes_axis[0] + bx);
+            }
+          }
+        }
+      }
+    };
+
+    grid->ApplyOnAllElementsColored([&](SimObject* so, SoHandle) {
+      visits[so->GetUid() - ref_uid]++;
+      for_each_box(so, [&](uint64_t idx) {
+        if (used[idx]++ != 0) {
+          conflicts++;
+        }
+      });
+      std::this_thread::sleep_for(std::chrono::microseconds(10));
+      for_each_box(so, [&](uint64_t idx) { used[idx]--; });
+    });
+
+    EXPECT_EQ(0u, conflicts);
+    for (auto& el : visits) {
+      EXPECT_EQ(1, el);
+    }
+  }
+}
+
 TEST(GridTest, GetBoxIndex) {
   Simulation simulation(TEST_NAME);
   auto* rm = simulation.GetResourceManager();
@@ -320,4 +870,210 @@ TEST(GridTest, IterateZOrder) {
   }
 }
 
+// Returns the morton code of the box of each simulation object in the order
+// given by `Grid::IterateZOrder`
+std::vector<uint64_t> GetZOrderMortonCodes(ResourceManager* rm, Grid* grid) {
+  std::vector<uint64_t> codes;
+  grid->IterateZOrder([&](const SoHandle& soh) {
+    auto* so = rm->GetSimObjectWithSoHandle(soh);
+    auto coord = grid->GetBoxCoordinates(grid->GetBoxIndex(so->GetPosition()));
+    codes.push_back(libmorton::morton3D_64_encode(coord[0], coord[1],
+                                                  coord[2]));
+  });
+  return codes;
+}
+
+TEST(GridTest, IterateZOrderAfterGrowth) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid = simulation.GetGrid();
+
+  CellFactory(rm, 3);
+  grid->Initialize();
+  auto codes = GetZOrderMortonCodes(rm, grid);
+  EXPECT_EQ(27u, codes.size());
+  EXPECT_TRUE(std::is_sorted(codes.begin(), codes.end()));
+
+  // grid dimensions are not a power of two and differ along each axis
+  auto* cell = new Cell({145, 20, -50});
+  cell->SetDiameter(30);
+  rm->push_back(cell);
+  grid->UpdateGrid();
+  codes = GetZOrderMortonCodes(rm, grid);
+  EXPECT_EQ(28u, codes.size());
+  EXPECT_TRUE(std::is_sorted(codes.begin(), codes.end()));
+}
+
+// Tests that apply to all implementations of `SpatialIndex`. The parameter
+// is the value of `Param::spatial_index_`.
+class SpatialIndexTest : public ::testing::TestWithParam<std::string> {
+ protected:
+  std::function<void(Param*)> GetSetParam() const {
+    auto spatial_index = GetParam();
+    return [=](Param* param) { param->spatial_index_ = spatial_index; };
+  }
+};
+
+TEST_P(SpatialIndexTest, ForEachNeighbor) {
+  Simulation simulation(TEST_NAME, GetSetParam());
+  auto* rm = simulation.GetResourceManager();
+  auto* index = simulation.GetSpatialIndex();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+  CellFactory(rm, 5);
+  rm->GetSimObject(ref_uid + 7)->SetPosition({3, 4, 5});
+  rm->GetSimObject(ref_uid + 31)->SetPosition({47, 61, 13});
+  index->Update();
+
+  auto run_test = [&]() {
+    // neighbors found without radius contain all neighbors within the
+    // largest object size
+    auto all = GetAllNeighbors(rm, index);
+    for (auto& el : GetAllNeighborsBruteForce(rm, 30)) {
+      EXPECT_TRUE(std::includes(all[el.first].begin(), all[el.first].end(),
+                                el.second.begin(), el.second.end()));
+    }
+    for (double radius : {15, 30, 75, 500}) {
+      EXPECT_EQ(GetAllNeighborsBruteForce(rm, radius),
+                GetAllNeighborsWithinRadius(rm, index, radius));
+    }
+  };
+  run_test();
+
+  // squared distances
+  rm->ApplyOnAllElements([&](SimObject* so) {
+    index->ForEachNeighbor(
+        [&](const SimObject* neighbor, double squared_distance) {
+          auto diff = neighbor->GetPosition() - so->GetPosition();
+          EXPECT_NEAR(diff * diff, squared_distance, abs_error<double>::value);
+        },
+        *so);
+  });
+
+  // removed and moved simulation objects
+  rm->Remove(ref_uid + 42);
+  rm->GetSimObject(ref_uid + 12)->SetPosition({41, 39, 1});
+  index->Update();
+  run_test();
+}
+
+TEST_P(SpatialIndexTest, GetKNearestNeighbors) {
+  Simulation simulation(TEST_NAME, GetSetParam());
+  auto* rm = simulation.GetResourceManager();
+  auto* index = simulation.GetSpatialIndex();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+  CellFactory(rm, 5);
+  rm->GetSimObject(ref_uid + 7)->SetPosition({3, 4, 5});
+  rm->GetSimObject(ref_uid + 31)->SetPosition({47, 61, 13});
+  index->Update();
+
+  auto* query = rm->GetSimObject(ref_uid);
+  EXPECT_EQ(0u, index->GetKNearestNeighbors(*query, 0).size());
+  RunKNearestNeighborsTest(rm, index);
+}
+
+// Queries beyond the neighbor search radius must not read positions that
+// are modified while simulation objects are updated.
+TEST_P(SpatialIndexTest, LargeRadiusUsesPositionsOfLastUpdate) {
+  Simulation simulation(TEST_NAME, GetSetParam());
+  auto* rm = simulation.GetResourceManager();
+  auto* index = simulation.GetSpatialIndex();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+  CellFactory(rm, 4);
+  index->Update();
+  auto expected = GetAllNeighborsBruteForce(rm, 75);
+
+  // simulates the update of a simulation object by another thread
+  auto* moved = rm->GetSimObject(ref_uid + 63);
+  moved->SetPosition({0, 0, 0});
+  rm->UpdateSoAStore(moved, rm->GetSoHandle(ref_uid + 63));
+
+  auto* query = rm->GetSimObject(ref_uid);
+  std::vector<SoUid> actual;
+  index->ForEachNeighborWithinRadius(
+      [&](const SimObject* neighbor) { actual.push_back(neighbor->GetUid()); },
+      *query, 75 * 75);
+  std::sort(actual.begin(), actual.end());
+  EXPECT_EQ(expected[ref_uid], actual);
+
+  auto nearest = index->GetKNearestNeighbors(*query, 1);
+  ASSERT_EQ(1u, nearest.size());
+  EXPECT_NE(moved, nearest[0]);
+}
+
+TEST_P(SpatialIndexTest, GetBoxIndex) {
+  Simulation simulation(TEST_NAME, GetSetParam());
+  auto* rm = simulation.GetResourceManager();
+  auto* index = simulation.GetSpatialIndex();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+  CellFactory(rm, 4);
+  rm->GetSimObject(ref_uid + 9)->SetPosition({3, 4, 5});
+  index->Update();
+
+  std::set<uint64_t> box_indices;
+  rm->ApplyOnAllElements([&](SimObject* so) {
+    EXPECT_EQ(so->GetBoxIdx(), index->GetBoxIndex(so->GetPosition()));
+    box_indices.insert(so->GetBoxIdx());
+  });
+  EXPECT_LT(1u, box_indices.size());
+}
+
+TEST_P(SpatialIndexTest, IterateZOrder) {
+  Simulation simulation(TEST_NAME, GetSetParam());
+  auto* rm = simulation.GetResourceManager();
+  auto* index = simulation.GetSpatialIndex();
+
+  CellFactory(rm, 4);
+  index->Update();
+
+  std::multiset<SoUid> uids;
+  index->IterateZOrder([&](const SoHandle& soh) {
+    uids.insert(rm->GetSimObjectWithSoHandle(soh)->GetUid());
+  });
+  EXPECT_EQ(rm->GetNumSimObjects(), uids.size());
+  rm->ApplyOnAllElements(
+      [&](SimObject* so) { EXPECT_EQ(1u, uids.count(so->GetUid())); });
+}
+
+TEST_P(SpatialIndexTest, NeighborMutex) {
+  Simulation simulation(TEST_NAME, GetSetParam());
+  auto* rm = simulation.GetResourceManager();
+  auto* index = simulation.GetSpatialIndex();
+
+  CellFactory(rm, 4);
+  index->Update();
+
+  auto* builder = index->GetNeighborMutexBuilder();
+  ASSERT_TRUE(builder != nullptr);
+  builder->Update();
+  rm->ApplyOnAllElements([&](SimObject* so) {
+    auto mutex = builder->GetMutex(so->GetBoxIdx());
+    mutex.lock();
+    mutex.unlock();
+  });
+
+  index->DisableNeighborMutexes();
+  EXPECT_TRUE(index->GetNeighborMutexBuilder() == nullptr);
+}
+
+TEST_P(SpatialIndexTest, Simulate) {
+  Simulation simulation(TEST_NAME, GetSetParam());
+  auto* rm = simulation.GetResourceManager();
+
+  CellFactory(rm, 4);
+  simulation.GetScheduler()->Simulate(2);
+
+  auto* index = simulation.GetSpatialIndex();
+  index->Update();
+  EXPECT_EQ(GetAllNeighborsBruteForce(rm, index->GetLargestObjectSize()),
+            GetAllNeighborsWithinRadius(rm, index,
+                                        index->GetLargestObjectSize()));
+}
+
+INSTANTIATE_TEST_CASE_P(SpatialIndexes, SpatialIndexTest,
+                        ::testing::Values("uniform_grid", "kd_tree"));
+
 }  // namespace bdm
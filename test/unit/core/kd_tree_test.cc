@@ -0,0 +1,78 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/kd_tree.h"
+#include "core/grid.h"
+#include "core/sim_object/cell.h"
+#include "gtest/gtest.h"
+#include "unit/test_util/test_util.h"
+
+namespace bdm {
+namespace kd_tree_test_internal {
+
+void CreateCells(ResourceManager* rm, size_t cells_per_dim) {
+  const double space = 20;
+  for (size_t i = 0; i < cells_per_dim; i++) {
+    for (size_t j = 0; j < cells_per_dim; j++) {
+      for (size_t k = 0; k < cells_per_dim; k++) {
+        Cell* cell = new Cell({k * space, j * space, i * space});
+        cell->SetDiameter(30);
+        rm->push_back(cell);
+      }
+    }
+  }
+}
+
+auto set_kd_tree_param = [](auto* param) { param->spatial_index_ = "kd_tree"; };
+
+}  // namespace kd_tree_test_internal
+
+using namespace kd_tree_test_internal;  // NOLINT
+
+// Neighbor queries, box indices, neighbor mutexes and z-order iteration
+// are tested together with `Grid` in grid_test.cc (`SpatialIndexTest`).
+
+TEST(KdTreeTest, Setup) {
+  Simulation simulation(TEST_NAME, set_kd_tree_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* index = simulation.GetSpatialIndex();
+  EXPECT_NE(static_cast<SpatialIndex*>(simulation.GetGrid()), index);
+  auto* tree = dynamic_cast<KdTree*>(index);
+  ASSERT_TRUE(tree != nullptr);
+
+  CreateCells(rm, 4);
+  tree->Update();
+
+  // 64 simulation objects with 16 per leaf
+  EXPECT_EQ(7u, tree->GetNumNodes());
+  EXPECT_EQ(30, tree->GetLargestObjectSize());
+  EXPECT_EQ(30, tree->GetNeighborSearchRadius());
+  std::array<int32_t, 6> expected_dim = {{-30, 90, -30, 90, -30, 90}};
+  EXPECT_EQ(expected_dim, tree->GetDimensions());
+  EXPECT_TRUE(tree->HasGrown());
+
+  tree->Update();
+  EXPECT_FALSE(tree->HasGrown());
+
+  rm->ApplyOnAllElements([&](SimObject* so) {
+    if (so->GetPosition()[0] == 60) {
+      so->SetPosition(so->GetPosition() + Double3{40, 0, 0});
+    }
+  });
+  tree->Update();
+  EXPECT_TRUE(tree->HasGrown());
+  EXPECT_EQ(130, tree->GetDimensions()[1]);
+}
+
+}  // namespace bdm
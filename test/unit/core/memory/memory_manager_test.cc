@@ -0,0 +1,208 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/memory/memory_manager.h"
+#include <omp.h>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+#include "core/biology_module/grow_divide.h"
+#include "core/sim_object/cell.h"
+#include "gtest/gtest.h"
+
+namespace bdm {
+
+TEST(MemoryManagerTest, FreeList) {
+  uint64_t elements[4];
+  FreeList list;
+  EXPECT_TRUE(list.Empty());
+  for (auto& el : elements) {
+    list.Push(&el);
+  }
+  EXPECT_EQ(4u, list.Size());
+
+  FreeList other;
+  list.MoveTo(&other, 3);
+  EXPECT_EQ(1u, list.Size());
+  EXPECT_EQ(3u, other.Size());
+  EXPECT_EQ(&elements[0], list.Pop());
+  EXPECT_TRUE(list.Empty());
+  EXPECT_EQ(&elements[1], other.Pop());
+}
+
+TEST(MemoryManagerTest, NewDelete) {
+  auto* mm = MemoryManager::Get();
+  auto* p1 = mm->New(40);
+  auto* p2 = mm->New(40);
+  auto* owner = NumaPoolAllocator::GetOwner(p1);
+  EXPECT_EQ(owner, NumaPoolAllocator::GetOwner(p2));
+  EXPECT_EQ(48u, owner->GetElementSize());
+  EXPECT_EQ(0, owner->GetNumaNode());
+  EXPECT_EQ(owner, mm->GetAllocator(48, 0));
+
+  // freed elements are reused
+  mm->Delete(p2, 40);
+  EXPECT_EQ(p2, mm->New(40));
+  mm->Delete(p1, 40);
+  mm->Delete(p2, 40);
+  mm->Delete(nullptr, 40);
+}
+
+TEST(MemoryManagerTest, LargeAllocation) {
+  auto* mm = MemoryManager::Get();
+  auto size = MemoryManager::kMaxElementSize + 1;
+  auto* p = static_cast<char*>(mm->New(size));
+  p[size - 1] = 1;
+  mm->Delete(p, size);
+}
+
+TEST(MemoryManagerTest, ParallelNewDelete) {
+  auto* mm = MemoryManager::Get();
+  const uint64_t kSize = 24;
+  const uint64_t kNumElements = 20000;
+  auto slabs_before = mm->GetAllocator(kSize, 0)->GetNumSlabs();
+
+#pragma omp parallel
+  {
+    std::vector<uint64_t*> elements;
+    for (int r = 0; r < 3; r++) {
+      for (uint64_t i = 0; i < kNumElements; i++) {
+        auto* el = static_cast<uint64_t*>(mm->New(kSize));
+        el[0] = i;
+        el[2] = omp_get_thread_num();
+        elements.push_back(el);
+      }
+      for (uint64_t i = 0; i < kNumElements; i++) {
+        EXPECT_EQ(i, elements[i][0]);
+        EXPECT_EQ(static_cast<uint64_t>(omp_get_thread_num()), elements[i][2]);
+        // return half of the elements in a different order
+        if (i % 2 == 0) {
+          mm->Delete(elements[i], kSize);
+        }
+      }
+      for (uint64_t i = 1; i < kNumElements; i += 2) {
+        mm->Delete(elements[i], kSize);
+      }
+      elements.clear();
+    }
+  }
+
+  // memory of the first round must be reused in later rounds
+  auto slabs = mm->GetAllocator(kSize, 0)->GetNumSlabs() - slabs_before;
+  uint64_t max_elements = omp_get_max_threads() *
+                          (kNumElements + 3 * NumaPoolAllocator::kBatchSize);
+  uint64_t elements_per_slab = (NumaPoolAllocator::kSlabSize -
+                                NumaPoolAllocator::kSlabHeaderSize) /
+                               32;
+  EXPECT_GE(max_elements / elements_per_slab + 1, slabs);
+}
+
+TEST(MemoryManagerTest, ThreadCacheIndex) {
+  auto idx = ThreadCacheIndex::Get();
+  EXPECT_EQ(idx, ThreadCacheIndex::Get());
+
+  // threads that run at the same time have different indices
+  std::vector<uint64_t> indices(4);
+  std::atomic<uint64_t> started(0);
+  std::vector<std::thread> threads;
+  for (uint64_t i = 0; i < indices.size(); i++) {
+    threads.emplace_back([&, i]() {
+      indices[i] = ThreadCacheIndex::Get();
+      // keep the index until all threads have one
+      started++;
+      while (started != indices.size()) {
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::set<uint64_t> unique(indices.begin(), indices.end());
+  EXPECT_EQ(indices.size(), unique.size());
+  EXPECT_EQ(0u, unique.count(idx));
+
+  // terminated threads return their index; the smallest one is reused
+  uint64_t reused = 0;
+  std::thread([&]() { reused = ThreadCacheIndex::Get(); }).join();
+  EXPECT_LE(reused, *unique.begin());
+}
+
+/// Allocates and frees elements from nested parallel regions and from
+/// threads that have not been created by OpenMP. In these cases,
+/// `omp_get_thread_num()` is not unique.
+TEST(MemoryManagerTest, NestedAndNonOpenMPThreads) {
+  auto* mm = MemoryManager::Get();
+  const uint64_t kSize = 40;
+  const uint64_t kNumElements = 5000;
+  auto allocate = [&](uint64_t id) {
+    std::vector<uint64_t*> elements;
+    for (uint64_t i = 0; i < kNumElements; i++) {
+      auto* el = static_cast<uint64_t*>(mm->New(kSize));
+      el[0] = id;
+      el[1] = i;
+      elements.push_back(el);
+    }
+    for (uint64_t i = 0; i < kNumElements; i++) {
+      EXPECT_EQ(id, elements[i][0]);
+      EXPECT_EQ(i, elements[i][1]);
+      mm->Delete(elements[i], kSize);
+    }
+  };
+
+  int max_active_levels = omp_get_max_active_levels();
+  omp_set_max_active_levels(2);
+#pragma omp parallel num_threads(2)
+  {
+    int outer = omp_get_thread_num();
+#pragma omp parallel num_threads(2)
+    { allocate(2 * outer + omp_get_thread_num()); }
+  }
+  omp_set_max_active_levels(max_active_levels);
+
+  std::vector<std::thread> threads;
+  for (uint64_t i = 0; i < 4; i++) {
+    threads.emplace_back(allocate, 100 + i);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+TEST(MemoryManagerTest, SimObjectsAndBiologyModules) {
+  auto* cell = new Cell();
+  auto* owner = NumaPoolAllocator::GetOwner(cell);
+  EXPECT_LE(sizeof(Cell), owner->GetElementSize());
+  EXPECT_GT(sizeof(Cell) + MemoryManager::kGranularity,
+            owner->GetElementSize());
+
+  // objects of the same type are packed together
+  auto* cell2 = new Cell();
+  EXPECT_EQ(owner, NumaPoolAllocator::GetOwner(cell2));
+
+  BaseBiologyModule* bm = new GrowDivide();
+  owner = NumaPoolAllocator::GetOwner(bm);
+  EXPECT_LE(sizeof(GrowDivide), owner->GetElementSize());
+  // `operator delete` receives the size of the dynamic type
+  delete bm;
+  auto* bm2 = new GrowDivide();
+  EXPECT_EQ(bm, bm2);
+
+  delete bm2;
+
+  delete cell;
+  delete cell2;
+}
+
+}  // namespace bdm
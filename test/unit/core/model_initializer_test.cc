@@ -13,6 +13,8 @@
 // -----------------------------------------------------------------------------
 
 #include "core/model_initializer.h"
+#include <set>
+#include <vector>
 #include "core/biology_module/biology_module.h"
 #include "core/resource_manager.h"
 #include "core/sim_object/cell.h"
@@ -115,5 +117,103 @@ TEST(ModelInitializerTest, CreateCellsRandom) {
   EXPECT_TRUE((pos_2[2] >= -100) && (pos_2[2] <= 100));
 }
 
+TEST(ModelInitializerTest, Grid3DParallel) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+  std::array<size_t, 3> grid_dimensions = {5, 3, 4};
+  ModelInitializer::Grid3DParallel(grid_dimensions, 12, [](const Double3& pos) {
+    Cell* cell = new Cell(pos);
+    return cell;
+  });
+
+  // same uids and positions as the serial version
+  EXPECT_EQ(60u, rm->GetNumSimObjects());
+  EXPECT_EQ(ref_uid + 60, SoUidGenerator::Get()->GetLastId());
+  uint64_t idx = 0;
+  for (size_t x = 0; x < 5; x++) {
+    for (size_t y = 0; y < 3; y++) {
+      for (size_t z = 0; z < 4; z++) {
+        Double3 expected = {x * 12.0, y * 12.0, z * 12.0};
+        EXPECT_ARR_EQ(expected,
+                      rm->GetSimObject(ref_uid + idx++)->GetPosition());
+      }
+    }
+  }
+}
+
+TEST(ModelInitializerTest, CreateCellsParallel) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+  std::vector<Double3> positions;
+  for (int i = 0; i < 100; i++) {
+    positions.push_back({i * 1.0, i * 2.0, i * 3.0});
+  }
+  ModelInitializer::CreateCellsParallel(positions, [](const Double3& pos) {
+    Cell* cell = new Cell(pos);
+    return cell;
+  });
+
+  EXPECT_EQ(100u, rm->GetNumSimObjects());
+  for (uint64_t i = 0; i < 100; i++) {
+    EXPECT_ARR_EQ(positions[i], rm->GetSimObject(ref_uid + i)->GetPosition());
+  }
+}
+
+/// Calls `ModelInitializer::CreateCellsRandomParallel` on the active
+/// simulation and returns the positions of the new cells.
+std::vector<Double3> CreateCellsRandomParallel() {
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+  auto num_sim_objects = rm->GetNumSimObjects();
+
+  ModelInitializer::CreateCellsRandomParallel(-100, 100, 1000,
+                                              [](const Double3& pos) {
+                                                Cell* cell = new Cell(pos);
+                                                return cell;
+                                              });
+
+  std::vector<Double3> positions;
+  for (uint64_t i = 0; i < rm->GetNumSimObjects() - num_sim_objects; i++) {
+    positions.push_back(rm->GetSimObject(ref_uid + i)->GetPosition());
+  }
+  return positions;
+}
+
+TEST(ModelInitializerTest, CreateCellsRandomParallel) {
+  std::vector<Double3> positions;
+  {
+    Simulation simulation(TEST_NAME);
+    positions = CreateCellsRandomParallel();
+  }
+  EXPECT_EQ(1000u, positions.size());
+  std::set<double> y_values;
+  for (auto& pos : positions) {
+    for (int i = 0; i < 3; i++) {
+      EXPECT_TRUE(pos[i] >= -100 && pos[i] <= 100);
+    }
+    y_values.insert(pos[1]);
+  }
+  // each thread uses a different random number stream
+  EXPECT_EQ(1000u, y_values.size());
+
+  // deterministic
+  Simulation simulation(TEST_NAME);
+  EXPECT_EQ(positions, CreateCellsRandomParallel());
+}
+
+TEST(ModelInitializerTest, CreateCellsRandomParallelTwice) {
+  Simulation simulation(TEST_NAME);
+  auto first = CreateCellsRandomParallel();
+  auto second = CreateCellsRandomParallel();
+  EXPECT_EQ(1000u, first.size());
+  EXPECT_EQ(1000u, second.size());
+  // the seeds are drawn from the generator of the simulation
+  EXPECT_NE(first, second);
+}
+
 }  // namespace model_initializer_test_internal
 }  // namespace bdm
@@ -13,6 +13,9 @@
 // -----------------------------------------------------------------------------
 
 #include "unit/core/operation/displacement_op_test.h"
+#include <omp.h>
+#include <vector>
+#include "core/util/thread_info.h"
 #include "gtest/gtest.h"
 
 namespace bdm {
@@ -81,5 +84,152 @@ TEST(DisplacementOpTest, ComputeNew) {
   // clang-format on
 }
 
+TEST(DisplacementOpTest, HalfShell) {
+  auto set_param = [](auto* param) { param->half_shell_displacement_ = true; };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+  Cell* cell0 = new Cell();
+  cell0->SetAdherence(0.3);
+  cell0->SetDiameter(9);
+  cell0->SetMass(1.4);
+  cell0->SetPosition({0, 0, 0});
+  rm->push_back(cell0);
+
+  Cell* cell1 = new Cell();
+  cell1->SetAdherence(0.4);
+  cell1->SetDiameter(11);
+  cell1->SetMass(1.1);
+  cell1->SetPosition({0, 5, 0});
+  rm->push_back(cell1);
+
+  simulation.GetGrid()->Initialize();
+
+  DisplacementOp op;
+  EXPECT_TRUE(op.UseHalfShell());
+  op();
+
+  // all forces are calculated based on the initial positions
+  auto final_position = rm->GetSimObject(ref_uid)->GetPosition();
+  EXPECT_NEAR(0, final_position[0], abs_error<double>::value);
+  EXPECT_NEAR(-0.07797206232558615, final_position[1],
+              abs_error<double>::value);
+  EXPECT_NEAR(0, final_position[2], abs_error<double>::value);
+  final_position = rm->GetSimObject(ref_uid + 1)->GetPosition();
+  EXPECT_NEAR(0, final_position[0], abs_error<double>::value);
+  EXPECT_NEAR(5.0992371702325645, final_position[1], abs_error<double>::value);
+  EXPECT_NEAR(0, final_position[2], abs_error<double>::value);
+}
+
+TEST(DisplacementOpTest, HalfShellMultipleObjectsPerBox) {
+  auto set_param = [](auto* param) { param->half_shell_displacement_ = true; };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid = simulation.GetGrid();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+  double space = 20;
+  for (size_t i = 0; i < 3; i++) {
+    for (size_t j = 0; j < 3; j++) {
+      for (size_t k = 0; k < 3; k++) {
+        Cell* cell = new Cell({k * space, j * space, i * space});
+        cell->SetDiameter(30);
+        cell->SetAdherence(0.4);
+        cell->SetMass(1.0);
+        rm->push_back(cell);
+      }
+    }
+  }
+
+  grid->ClearGrid();
+  grid->Initialize();
+
+  DisplacementOp op;
+  op();
+
+  // clang-format off
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 0)->GetPosition(), {-0.20160966809506442, -0.20160966809506442, -0.20160966809506442});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 1)->GetPosition(), {20, -0.22419529008561653, -0.22419529008561653});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 2)->GetPosition(), {40.201609668095067, -0.20160966809506442, -0.20160966809506442});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 3)->GetPosition(), {-0.22419529008561653, 20, -0.22419529008561653});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 4)->GetPosition(), {20, 20, -0.24678091207616867});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 5)->GetPosition(), {40.224195290085618, 20, -0.22419529008561653});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 6)->GetPosition(), {-0.20160966809506442, 40.201609668095067, -0.20160966809506442});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 7)->GetPosition(), {20, 40.224195290085618, -0.22419529008561653});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 8)->GetPosition(), {40.201609668095067, 40.201609668095067, -0.20160966809506442});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 9)->GetPosition(), {-0.22419529008561653, -0.22419529008561653, 20});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 10)->GetPosition(), {20, -0.24678091207616867, 20});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 11)->GetPosition(), {40.224195290085618, -0.22419529008561653, 20});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 12)->GetPosition(), {-0.24678091207616867, 20, 20});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 13)->GetPosition(), {20, 20, 20});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 14)->GetPosition(), {40.246780912076169, 20, 20});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 15)->GetPosition(), {-0.22419529008561653, 40.224195290085618, 20});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 16)->GetPosition(), {20, 40.246780912076169, 20});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 17)->GetPosition(), {40.224195290085618, 40.224195290085618, 20});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 18)->GetPosition(), {-0.20160966809506442, -0.20160966809506442, 40.201609668095067});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 19)->GetPosition(), {20, -0.22419529008561653, 40.224195290085618});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 20)->GetPosition(), {40.201609668095067, -0.20160966809506442, 40.201609668095067});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 21)->GetPosition(), {-0.22419529008561653, 20, 40.224195290085618});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 22)->GetPosition(), {20, 20, 40.246780912076169});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 23)->GetPosition(), {40.224195290085618, 20, 40.224195290085618});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 24)->GetPosition(), {-0.20160966809506442, 40.201609668095067, 40.201609668095067});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 25)->GetPosition(), {20, 40.224195290085618, 40.224195290085618});
+  EXPECT_ARR_NEAR(rm->GetSimObject(ref_uid + 26)->GetPosition(), {40.201609668095067, 40.201609668095067, 40.201609668095067});
+  // clang-format on
+}
+
+TEST(DisplacementOpTest, HalfShellIsDeterministic) {
+  auto max_threads = omp_get_max_threads();
+  auto set_num_threads = [](int num_threads) {
+    omp_set_num_threads(num_threads);
+    ThreadInfo::GetInstance()->Renew();
+  };
+  auto run = [&, this](int num_threads) {
+    auto set_param = [](auto* param) {
+      param->half_shell_displacement_ = true;
+    };
+    Simulation simulation(TEST_NAME, set_param);
+    auto* rm = simulation.GetResourceManager();
+    auto ref_uid = SoUidGenerator::Get()->GetLastId();
+
+    // irregular lattice with many overlapping neighbors
+    for (size_t i = 0; i < 512; i++) {
+      Double3 position = {(i % 8) * 7.0 + (i % 3), ((i / 8) % 8) * 7.0,
+                          (i / 64) * 7.0 + (i % 5) * 0.3};
+      Cell* cell = new Cell(position);
+      cell->SetDiameter(10 + (i % 7) * 0.5);
+      cell->SetAdherence(0.4);
+      cell->SetMass(1.0);
+      rm->push_back(cell);
+    }
+    // the order of simulation objects inside a box depends on the thread
+    // schedule of the grid construction
+    set_num_threads(1);
+    simulation.GetGrid()->Initialize();
+
+    set_num_threads(num_threads);
+    DisplacementOp op;
+    op();
+    set_num_threads(max_threads);
+
+    std::vector<Double3> positions;
+    for (uint64_t i = 0; i < 512; i++) {
+      positions.push_back(rm->GetSimObject(ref_uid + i)->GetPosition());
+    }
+    return positions;
+  };
+
+  auto expected = run(1);
+  auto actual = run(max_threads);
+  for (size_t i = 0; i < expected.size(); i++) {
+    for (int j = 0; j < 3; j++) {
+      EXPECT_EQ(expected[i][j], actual[i][j]);
+    }
+  }
+}
+
 }  // namespace displacement_op_test_internal
 }  // namespace bdm
@@ -0,0 +1,74 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/operation/operation_statistics.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+namespace bdm {
+
+TEST(OperationStatisticsTest, Record) {
+  OperationStatistics stats;
+  auto op = stats.Instrument(Operation("op", [](SimObject*) {}));
+  stats.Instrument(Operation("other", [](SimObject*) {}));
+  EXPECT_EQ("op", op.name_);
+
+  // durations: 1 x 100 ns, 8 x 1000 ns, 1 x 100000 ns
+  stats.Record(0, 100);
+  for (int i = 0; i < 8; i++) {
+    stats.Record(0, 1000);
+  }
+  stats.Record(0, 100000);
+  // not merged yet
+  EXPECT_EQ(0u, stats.GetCount("op"));
+
+  stats.Merge();
+  EXPECT_EQ(10u, stats.GetCount("op"));
+  EXPECT_EQ(108100u, stats.GetTotalTime("op"));
+  EXPECT_EQ(0u, stats.GetCount("other"));
+  EXPECT_EQ(0u, stats.GetCount("does not exist"));
+  EXPECT_EQ(128u, stats.GetPercentile("op", 0.1));
+  EXPECT_EQ(1024u, stats.GetPercentile("op", 0.5));
+  EXPECT_EQ(1024u, stats.GetPercentile("op", 0.9));
+  EXPECT_EQ(131072u, stats.GetPercentile("op", 0.99));
+
+  stats.Merge();
+  EXPECT_EQ(10u, stats.GetCount("op"));
+
+  std::stringstream output;
+  output << stats;
+  EXPECT_NE(std::string::npos, output.str().find("op: 0.1081 ms / 10 calls"));
+}
+
+TEST(OperationStatisticsTest, Parallel) {
+  OperationStatistics stats;
+  auto op = stats.Instrument(Operation("sleep", [](SimObject*) {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }));
+
+#pragma omp parallel for schedule(static, 1)
+  for (int i = 0; i < 100; i++) {
+    op(nullptr);
+  }
+  stats.Merge();
+
+  EXPECT_EQ(100u, stats.GetCount("sleep"));
+  EXPECT_LE(10000000u, stats.GetTotalTime("sleep"));
+  EXPECT_LE(131072u, stats.GetPercentile("sleep", 0.5));
+  EXPECT_GT(50, stats.GetLoadImbalance("sleep"));
+}
+
+}  // namespace bdm
@@ -0,0 +1,69 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/operation/operation.h"
+#include <gtest/gtest.h>
+
+namespace bdm {
+
+TEST(OpResourceTest, Overlaps) {
+  OpResource so = OpResource::kSimObjects;
+  OpResource index = OpResource::kSpatialIndex;
+  OpResource all_dgrids = OpResource::kAllDiffusionGrids;
+  auto dgrid0 = OpResource::DiffusionGrid(0);
+  auto dgrid1 = OpResource::DiffusionGrid(1);
+
+  EXPECT_TRUE(so.Overlaps(so));
+  EXPECT_FALSE(so.Overlaps(index));
+  EXPECT_FALSE(so.Overlaps(dgrid0));
+  EXPECT_TRUE(dgrid0.Overlaps(dgrid0));
+  EXPECT_FALSE(dgrid0.Overlaps(dgrid1));
+  EXPECT_TRUE(dgrid0.Overlaps(all_dgrids));
+  EXPECT_TRUE(all_dgrids.Overlaps(dgrid1));
+  EXPECT_FALSE(all_dgrids.Overlaps(index));
+}
+
+TEST(OpAccessTest, ConflictsWith) {
+  OpAccess diffusion = {{OpResource::kSpatialIndex},
+                        {OpResource::DiffusionGrid(0)}};
+  OpAccess mechanics = {{OpResource::kSimObjects, OpResource::kSpatialIndex},
+                        {OpResource::kSimObjects}};
+  OpAccess chemotaxis = {{OpResource::DiffusionGrid(0)},
+                         {OpResource::kSimObjects}};
+  OpAccess secretion = {{}, {OpResource::DiffusionGrid(1)}};
+
+  // concurrent reads do not conflict
+  EXPECT_FALSE(diffusion.ConflictsWith(mechanics));
+  EXPECT_FALSE(mechanics.ConflictsWith(diffusion));
+  // read after write and write after read
+  EXPECT_TRUE(diffusion.ConflictsWith(chemotaxis));
+  EXPECT_TRUE(chemotaxis.ConflictsWith(diffusion));
+  // write after write
+  EXPECT_TRUE(mechanics.ConflictsWith(chemotaxis));
+  EXPECT_FALSE(secretion.ConflictsWith(diffusion));
+
+  mechanics.Merge(secretion);
+  EXPECT_EQ(2u, mechanics.reads_.size());
+  EXPECT_EQ(2u, mechanics.writes_.size());
+  EXPECT_FALSE(mechanics.ConflictsWith(diffusion));
+  mechanics.Merge(chemotaxis);
+  EXPECT_TRUE(mechanics.ConflictsWith(diffusion));
+
+  // by default, operations may access all diffusion grids
+  Operation op;
+  EXPECT_TRUE(op.access_.ConflictsWith(diffusion));
+  EXPECT_TRUE(op.access_.ConflictsWith(secretion));
+}
+
+}  // namespace bdm
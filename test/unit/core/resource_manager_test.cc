@@ -14,6 +14,13 @@
 
 // I/O related code must be in header file
 #include "unit/core/resource_manager_test.h"
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <thread>
+#include <vector>
+#include "core/biology_module/grow_divide.h"
+#include "core/sim_object/cell.h"
 #include "unit/test_util/io_test.h"
 
 namespace bdm {
@@ -46,6 +53,235 @@ TEST(ResourceManagerTest, SortAndApplyOnAllElementsParallelDynamic) {
   RunSortAndApplyOnAllElementsParallelDynamic();
 }
 
+TEST(ResourceManagerTest, ApplyOnAllElementsParallelDynamicWorkStealing) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  int num_threads = omp_get_max_threads();
+
+  uint64_t num_so = 100 * num_threads;
+  for (uint64_t i = 0; i < num_so; i++) {
+    rm->push_back(new Cell());
+  }
+
+  // all work is in the initial range of the first thread
+  std::vector<std::atomic<int>> counts(num_so);
+  std::vector<int> processed_by(num_so);
+  for (auto& count : counts) {
+    count = 0;
+  }
+  ParallelLoopStatistics statistics;
+  rm->ApplyOnAllElementsParallelDynamic(
+      1,
+      [&](SimObject* so, SoHandle soh) {
+        auto idx = soh.GetElementIdx();
+        counts[idx]++;
+        processed_by[idx] = omp_get_thread_num();
+        if (idx < 100) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      },
+      &statistics);
+
+  for (auto& count : counts) {
+    EXPECT_EQ(1, count);
+  }
+  EXPECT_EQ(num_so, statistics.num_sim_objects_);
+  EXPECT_EQ(1u, statistics.chunk_);
+  EXPECT_EQ(num_so, statistics.num_chunks_);
+  EXPECT_EQ(static_cast<uint64_t>(num_threads), statistics.busy_time_.size());
+  uint64_t total_busy_time = 0;
+  for (auto time : statistics.busy_time_) {
+    total_busy_time += time;
+  }
+  EXPECT_LT(100000000u, total_busy_time);
+  if (num_threads > 1) {
+    std::set<int> threads(processed_by.begin(), processed_by.begin() + 100);
+    EXPECT_LT(1u, threads.size());
+    EXPECT_LT(0u, statistics.num_steals_);
+  }
+}
+
+TEST(ResourceManagerTest, SoAStore) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+
+  for (uint64_t i = 0; i < 10; i++) {
+    auto* cell = new Cell({i * 1.0, i * 2.0, i * 3.0});
+    cell->SetDiameter(i + 1);
+    cell->SetBoxIdx(i + 5);
+    rm->push_back(cell);
+  }
+  rm->UpdateSoAStore();
+
+  rm->ApplyOnAllElements([&](SimObject* so, SoHandle soh) {
+    EXPECT_EQ(so->GetPosition(), rm->GetSoAPosition(soh));
+    EXPECT_EQ(so->GetDiameter(), rm->GetSoADiameter(soh));
+    EXPECT_EQ(so->GetBoxIdx(), rm->GetSoABoxIdx(soh));
+  });
+  EXPECT_EQ(9, rm->GetSoADiameters(0)[8]);
+  EXPECT_EQ(Double3({8, 16, 24}), rm->GetSoAPositions(0)[8]);
+
+  // single simulation object
+  auto soh = SoHandle(0, 3);
+  auto* so = rm->GetSimObjectWithSoHandle(soh);
+  so->SetPosition({-1, -2, -3});
+  so->SetDiameter(42);
+  EXPECT_EQ(Double3({3, 6, 9}), rm->GetSoAPosition(soh));
+  rm->UpdateSoAStore(so, soh);
+  EXPECT_EQ(Double3({-1, -2, -3}), rm->GetSoAPosition(soh));
+  EXPECT_EQ(42, rm->GetSoADiameter(soh));
+
+  rm->SetSoABoxIdx(soh, 123);
+  EXPECT_EQ(123u, rm->GetSoABoxIdx(soh));
+
+  // removed simulation objects
+  rm->Remove(so->GetUid());
+  rm->UpdateSoAStore();
+  rm->ApplyOnAllElements([&](SimObject* so, SoHandle soh) {
+    EXPECT_EQ(so->GetPosition(), rm->GetSoAPosition(soh));
+  });
+}
+
+TEST(ResourceManagerTest, IncrementalSoAStoreUpdate) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* ctxt = simulation.GetExecutionContext();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+  for (uint64_t i = 0; i < 10; i++) {
+    rm->push_back(new Cell({i * 1.0, 0, 0}));
+  }
+  rm->UpdateSoAStore();
+  auto get_soa_position = [&](SoUid uid) {
+    return rm->GetSoAPosition(rm->GetSoHandle(uid));
+  };
+
+  // only added, marked and neighbor-modified simulation objects are copied
+  rm->SetSoAStoreInSync();
+  rm->GetSimObject(ref_uid)->SetPosition({-1, 0, 0});
+  rm->GetSimObject(ref_uid + 1)->SetPosition({-2, 0, 0});
+  // each handle is only returned once per `UpdateSoAStore()`
+  EXPECT_TRUE(rm->MarkSoAEntryOutdated(rm->GetSoHandle(ref_uid + 1)));
+  EXPECT_FALSE(rm->MarkSoAEntryOutdated(rm->GetSoHandle(ref_uid + 1)));
+  rm->AddOutdatedSoAEntries({rm->GetSoHandle(ref_uid + 1)});
+  ctxt->GetSimObject(ref_uid + 2)->SetPosition({-3, 0, 0});
+  ctxt->GetSimObject(ref_uid + 2)->SetDiameter(3);
+  ctxt->TearDownIterationAll(simulation.GetAllExecCtxts());
+  rm->push_back(new Cell({-4, 0, 0}));
+  rm->UpdateSoAStore();
+  EXPECT_EQ(Double3({0, 0, 0}), get_soa_position(ref_uid));
+  EXPECT_EQ(Double3({-2, 0, 0}), get_soa_position(ref_uid + 1));
+  EXPECT_EQ(Double3({-3, 0, 0}), get_soa_position(ref_uid + 2));
+  EXPECT_EQ(Double3({-4, 0, 0}), get_soa_position(ref_uid + 10));
+  EXPECT_EQ(Double3({3, 0, 0}), get_soa_position(ref_uid + 3));
+
+  // without `SetSoAStoreInSync` all simulation objects are copied
+  rm->UpdateSoAStore();
+  EXPECT_EQ(Double3({-1, 0, 0}), get_soa_position(ref_uid));
+  EXPECT_FALSE(rm->MarkSoAEntryOutdated(rm->GetSoHandle(ref_uid)));
+
+  // removing simulation objects revokes `SetSoAStoreInSync`
+  rm->SetSoAStoreInSync();
+  rm->GetSimObject(ref_uid + 5)->SetPosition({-5, 0, 0});
+  rm->Remove(ref_uid + 9);
+  rm->UpdateSoAStore();
+  rm->ApplyOnAllElements([&](SimObject* so, SoHandle soh) {
+    EXPECT_EQ(so->GetPosition(), rm->GetSoAPosition(soh));
+  });
+}
+
+TEST(ResourceManagerTest, RemoveSimObjects) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+
+  auto ref_uid = SoUidGenerator::Get()->GetLastId();
+  for (uint64_t i = 0; i < 1000; i++) {
+    rm->push_back(new Cell(i));
+  }
+
+  // remove every third simulation object, one twice and an unknown uid
+  std::vector<SoUid> remove;
+  for (uint64_t i = 2; i < 1000; i += 3) {
+    remove.push_back(ref_uid + i);
+  }
+  remove.push_back(ref_uid + 5);
+  remove.push_back(ref_uid + 1000);
+  rm->RemoveSimObjects(remove);
+
+  EXPECT_EQ(667u, rm->GetNumSimObjects());
+  // remaining simulation objects keep their order
+  double last_diameter = -1;
+  rm->ApplyOnAllElements([&](SimObject* so, SoHandle soh) {
+    EXPECT_NE(2u, (so->GetUid() - ref_uid) % 3);
+    EXPECT_LT(last_diameter, so->GetDiameter());
+    EXPECT_EQ(soh, rm->GetSoHandle(so->GetUid()));
+    last_diameter = so->GetDiameter();
+  });
+  for (uint64_t i = 0; i < 1000; i++) {
+    EXPECT_EQ(i % 3 != 2, rm->Contains(ref_uid + i));
+  }
+
+  rm->RemoveSimObjects({});
+  EXPECT_EQ(667u, rm->GetNumSimObjects());
+}
+
+TEST(ResourceManagerTest, SortAndBalanceNumaNodesReordersPointers) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  for (int64_t i = 26; i >= 0; i--) {
+    auto* cell = new Cell({(i % 3) * 20.0, (i / 3 % 3) * 20.0, i / 9 * 20.0});
+    cell->SetDiameter(10);
+    cell->AddBiologyModule(new GrowDivide());
+    rm->push_back(cell);
+  }
+  std::unordered_map<SoUid, std::pair<SimObject*, BaseBiologyModule*>>
+      before;
+  rm->ApplyOnAllElements([&](SimObject* so) {
+    before[so->GetUid()] = {so, so->GetAllBiologyModules()[0]};
+  });
+
+  simulation.GetSpatialIndex()->Update();
+  rm->SortAndBalanceNumaNodes();
+
+  EXPECT_EQ(27u, rm->GetNumSimObjects());
+  if (ThreadInfo::GetInstance()->GetNumaNodes() == 1) {
+    // simulation objects have not been copied
+    rm->ApplyOnAllElements([&](SimObject* so) {
+      EXPECT_EQ(before[so->GetUid()].first, so);
+      EXPECT_EQ(before[so->GetUid()].second, so->GetAllBiologyModules()[0]);
+    });
+  }
+  rm->ApplyOnAllElements([&](SimObject* so, SoHandle soh) {
+    EXPECT_EQ(soh, rm->GetSoHandle(so->GetUid()));
+  });
+}
+
+TEST(SoHandleTest, Encoding) {
+  uint64_t large_idx = (1ull << 40) + 7;
+  SoHandle soh(3, large_idx);
+  EXPECT_EQ(3u, soh.GetNumaNode());
+  EXPECT_EQ(large_idx, soh.GetElementIdx());
+
+  soh.SetElementIdx(42);
+  EXPECT_EQ(3u, soh.GetNumaNode());
+  EXPECT_EQ(42u, soh.GetElementIdx());
+
+  auto max_numa = SoHandle::GetMaxNumaNodes() - 1;
+  SoHandle last(max_numa, SoHandle::kElementIdxMask - 1);
+  EXPECT_EQ(max_numa, last.GetNumaNode());
+  EXPECT_EQ(SoHandle::kElementIdxMask - 1, last.GetElementIdx());
+  EXPECT_NE(SoHandle(), last);
+
+  // ordered by numa node first
+  EXPECT_TRUE(SoHandle(0, large_idx) < SoHandle(1, 0));
+  EXPECT_TRUE(SoHandle(1, 0) < SoHandle(1, 1));
+  EXPECT_FALSE(SoHandle(1, 1) < SoHandle(1, 1));
+
+  EXPECT_EQ(8u, sizeof(SoHandle));
+  std::atomic<SoHandle> atomic_soh(soh);
+  EXPECT_TRUE(atomic_soh.is_lock_free());
+}
+
 TEST(ResourceManagerTest, DiffusionGrid) {
   ResourceManager rm;
 
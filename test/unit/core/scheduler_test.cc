@@ -13,6 +13,8 @@
 // -----------------------------------------------------------------------------
 
 #include "unit/core/scheduler_test.h"
+#include "core/model_initializer.h"
+#include "core/substance_initializers.h"
 
 namespace bdm {
 namespace scheduler_test_internal {
@@ -47,6 +49,10 @@ TEST(SchedulerTest, NoRestoreFile) {
 TEST(SchedulerTest, Restore) { RunRestoreTest(); }
 
 TEST(SchedulerTest, Backup) { RunBackupTest(); }
+
+TEST(SchedulerTest, BackupSteps) { RunBackupStepsTest(false); }
+
+TEST(SchedulerTest, BackupStepsAsync) { RunBackupStepsTest(true); }
 #endif  // USE_DICT
 
 TEST(SchedulerTest, EmptySimulationFromBeginning) {
@@ -132,5 +138,201 @@ TEST(SchedulerTest, OperationManagement) {
   EXPECT_EQ(20u, op2_cnt);
 }
 
+TEST(SchedulerTest, BoxColoring) {
+  auto set_param = [](auto* param) { param->box_coloring_ = true; };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  for (uint64_t i = 0; i < 100; i++) {
+    auto* cell = new Cell({(i % 5) * 20.0, (i / 5 % 5) * 20.0, i / 25 * 20.0});
+    cell->SetDiameter(30);
+    rm->push_back(cell);
+  }
+
+  std::atomic<uint64_t> op_cnt(0);
+  Operation op = Operation("op", [&](SimObject* so) { op_cnt++; });
+
+  auto* scheduler = simulation.GetScheduler();
+  scheduler->AddOperation(op);
+  scheduler->Simulate(3);
+  EXPECT_EQ(300u, op_cnt);
+  EXPECT_EQ(100u, rm->GetNumSimObjects());
+}
+
+void AddCell(ResourceManager* rm, const Double3& position) {
+  auto* cell = new Cell(position);
+  cell->SetDiameter(10);
+  rm->push_back(cell);
+}
+
+void CheckZOrder(ResourceManager* rm, SpatialIndex* index) {
+  index->Update();
+  std::vector<SoHandle> zorder;
+  index->IterateZOrder([&](const SoHandle& soh) { zorder.push_back(soh); });
+  ASSERT_EQ(rm->GetNumSimObjects(), zorder.size());
+  std::vector<SoHandle> storage_order;
+  rm->ApplyOnAllElements(
+      [&](SimObject* so, SoHandle soh) { storage_order.push_back(soh); });
+  EXPECT_EQ(storage_order, zorder);
+}
+
+TEST(SchedulerTest, NumaRebalancingFrequency) {
+  auto set_param = [](auto* param) { param->numa_rebalancing_frequency_ = 2; };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  // cells do not overlap and therefore do not move
+  for (int64_t i = 63; i >= 0; i--) {
+    AddCell(rm, {(i % 4) * 20.0, (i / 4 % 4) * 20.0, i / 16 * 20.0});
+  }
+  EXPECT_NEAR(1, rm->GetUnsortedFraction(), abs_error<double>::value);
+
+  auto* scheduler = simulation.GetScheduler();
+  scheduler->Simulate(1);
+  EXPECT_NEAR(0, rm->GetUnsortedFraction(), abs_error<double>::value);
+  EXPECT_NEAR(0, rm->GetNumaImbalance(), abs_error<double>::value);
+  CheckZOrder(rm, simulation.GetSpatialIndex());
+
+  // no rebalancing in the second iteration
+  AddCell(rm, {100, 100, 100});
+  scheduler->Simulate(1);
+  EXPECT_NEAR(1.0 / 65, rm->GetUnsortedFraction(), abs_error<double>::value);
+  scheduler->Simulate(1);
+  EXPECT_NEAR(0, rm->GetUnsortedFraction(), abs_error<double>::value);
+  EXPECT_EQ(65u, rm->GetNumSimObjects());
+}
+
+TEST(SchedulerTest, NumaRebalancingThreshold) {
+  auto set_param = [](auto* param) {
+    param->numa_rebalancing_threshold_ = 0.5;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  for (int64_t i = 0; i < 10; i++) {
+    AddCell(rm, {i * 20.0, 0, 0});
+  }
+
+  auto* scheduler = simulation.GetScheduler();
+  scheduler->Simulate(1);
+  EXPECT_NEAR(0, rm->GetUnsortedFraction(), abs_error<double>::value);
+
+  // below the threshold
+  for (int64_t i = 0; i < 5; i++) {
+    AddCell(rm, {i * 20.0, 100, 0});
+  }
+  scheduler->Simulate(1);
+  EXPECT_NEAR(5.0 / 15, rm->GetUnsortedFraction(), abs_error<double>::value);
+
+  for (int64_t i = 0; i < 10; i++) {
+    AddCell(rm, {i * 20.0, 200, 0});
+  }
+  scheduler->Simulate(1);
+  EXPECT_NEAR(0, rm->GetUnsortedFraction(), abs_error<double>::value);
+  CheckZOrder(rm, simulation.GetSpatialIndex());
+}
+
+TEST(SchedulerTest, AdaptiveSchedulingBatchSize) {
+  auto set_param = [](auto* param) {
+    param->adaptive_scheduling_batch_size_ = true;
+    param->scheduling_batch_size_ = 1;
+    param->statistics_ = true;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  for (int64_t i = 0; i < 100; i++) {
+    AddCell(rm, {(i % 5) * 20.0, (i / 5 % 5) * 20.0, i / 25 * 20.0});
+  }
+
+  std::atomic<uint64_t> op_cnt(0);
+  Operation op = Operation("op", [&](SimObject* so) { op_cnt++; });
+
+  auto* scheduler = simulation.GetScheduler();
+  scheduler->AddOperation(op);
+  scheduler->Simulate(10);
+  EXPECT_EQ(1000u, op_cnt);
+  EXPECT_EQ(100u, rm->GetNumSimObjects());
+}
+
+struct FilterTestCell : public Cell {};
+
+TEST(SchedulerTest, OperationFilter) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  for (int64_t i = 0; i < 10; i++) {
+    auto* cell = i < 4 ? new FilterTestCell() : new Cell();
+    cell->SetPosition({i * 20.0, 0, 0});
+    cell->SetDiameter(10);
+    rm->push_back(cell);
+  }
+
+  std::atomic<uint64_t> type_cnt(0);
+  Operation type_op("type", [&](SimObject* so) { type_cnt++; });
+  type_op.SetTypeFilter<FilterTestCell>();
+  std::atomic<uint64_t> predicate_cnt(0);
+  Operation predicate_op("predicate", [&](SimObject* so) { predicate_cnt++; });
+  predicate_op.filter_ = [](const SimObject* so) {
+    return so->GetPosition()[0] >= 100;
+  };
+
+  auto* scheduler = simulation.GetScheduler();
+  scheduler->AddOperation(type_op);
+  scheduler->AddOperation(predicate_op);
+  scheduler->Simulate(2);
+  EXPECT_EQ(8u, type_cnt);
+  EXPECT_EQ(10u, predicate_cnt);
+
+  // protected operations can be restricted as well
+  std::atomic<uint64_t> discretization_cnt(0);
+  EXPECT_TRUE(scheduler->SetOperationFilter(
+      "discretization", [&](const SimObject* so) {
+        discretization_cnt++;
+        return false;
+      }));
+  EXPECT_FALSE(scheduler->SetOperationFilter("does not exist", nullptr));
+  EXPECT_TRUE(scheduler->SetOperationFilter("predicate", nullptr));
+  scheduler->Simulate(1);
+  EXPECT_EQ(12u, type_cnt);
+  EXPECT_EQ(20u, predicate_cnt);
+  EXPECT_EQ(10u, discretization_cnt);
+}
+
+std::vector<double> RunDiffusion(const std::string& name, bool overlap) {
+  auto set_param = [](auto* param) {
+    param->bound_space_ = true;
+    param->min_bound_ = 0;
+    param->max_bound_ = 100;
+  };
+  Simulation simulation(name, set_param);
+  auto* rm = simulation.GetResourceManager();
+  for (int64_t i = 0; i < 100; i++) {
+    AddCell(rm, {(i % 5) * 20.0, (i / 5 % 5) * 20.0, i / 25 * 20.0});
+  }
+  ModelInitializer::DefineSubstance(0, "Substance", 0.5, 0.1, 10);
+  ModelInitializer::InitializeSubstance(0, GaussianBand(50, 20, Axis::kXAxis));
+
+  auto* scheduler = simulation.GetScheduler();
+  if (overlap) {
+    // biology modules are the only operation that might access diffusion
+    // grids
+    *scheduler->GetOperationAccess("biology modules") = {
+        {OpResource::kSimObjects}, {OpResource::kSimObjects}};
+  }
+  EXPECT_NE(nullptr, scheduler->GetOperationAccess("biology modules"));
+  EXPECT_EQ(nullptr, scheduler->GetOperationAccess("does not exist"));
+  scheduler->Simulate(3);
+
+  auto* dgrid = rm->GetDiffusionGrid(0);
+  auto* concentrations = dgrid->GetAllConcentrations();
+  return std::vector<double>(concentrations,
+                             concentrations + dgrid->GetNumBoxes());
+}
+
+TEST(SchedulerTest, DiffusionOverlapsWithOperations) {
+  auto expected = RunDiffusion(TEST_NAME, false);
+  auto actual = RunDiffusion(TEST_NAME, true);
+  ASSERT_EQ(expected.size(), actual.size());
+  for (uint64_t i = 0; i < expected.size(); i++) {
+    EXPECT_NEAR(expected[i], actual[i], abs_error<double>::value);
+  }
+}
+
 }  // namespace scheduler_test_internal
 }  // namespace bdm
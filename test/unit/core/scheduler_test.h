@@ -56,6 +56,24 @@ class TestSchedulerBackup : public Scheduler {
   unsigned execute_calls_ = 0;
 };
 
+class TestSchedulerBackupSteps : public Scheduler {
+ public:
+  explicit TestSchedulerBackupSteps(bool async) : async_(async) {}
+
+  void Execute(bool last_iteration) override {
+    // Backup is created after every second step. Asynchronous backups might
+    // not have been finished yet.
+    if (!async_) {
+      EXPECT_EQ(execute_calls_ > 0 && execute_calls_ % 2 == 0,
+                FileExists(ROOTFILE));
+      remove(ROOTFILE);
+    }
+    execute_calls_++;
+  }
+  bool async_;
+  unsigned execute_calls_ = 0;
+};
+
 inline void RunRestoreTest() {
   {
     Simulation simulation("SchedulerTest_RunRestoreTest");
@@ -123,6 +141,33 @@ inline void RunBackupTest() {
   remove(ROOTFILE);
 }
 
+inline void RunBackupStepsTest(bool async) {
+  auto set_param = [&](auto* param) {
+    param->backup_file_ = ROOTFILE;
+    param->backup_interval_steps_ = 2;
+    param->async_backup_ = async;
+  };
+
+  Simulation simulation("SchedulerTest_RunBackupStepsTest", set_param);
+  auto* rm = simulation.GetResourceManager();
+
+  remove(ROOTFILE);
+
+  Cell* cell = new Cell();
+  cell->SetDiameter(10);  // important for grid to determine box size
+  rm->push_back(cell);
+
+  {
+    TestSchedulerBackupSteps scheduler(async);
+    scheduler.Simulate(4);
+    // the destructor waits for a running asynchronous backup
+  }
+  ASSERT_TRUE(FileExists(ROOTFILE));
+  SimulationBackup restore("", ROOTFILE);
+  EXPECT_EQ(4u, restore.GetSimulationStepsFromBackup());
+  remove(ROOTFILE);
+}
+
 }  // namespace scheduler_test_internal
 }  // namespace bdm
 
@@ -37,6 +37,36 @@ TEST(SimObjectTest, CopyCtor) {
   EXPECT_EQ(321, copy_gm->growth_rate_);
 }
 
+TEST(SimObjectTest, Relocate) {
+  auto* cell = new TestSimObject();
+  cell->SetBoxIdx(123);
+  GrowthModule* gm = new GrowthModule();
+  gm->growth_rate_ = 321;
+  cell->AddBiologyModule(gm);
+  cell->AddBiologyModule(new MovementModule({1, 2, 3}));
+  auto uid = cell->GetUid();
+
+  cell->RelocateBiologyModule(0);
+  ASSERT_EQ(2u, cell->GetAllBiologyModules().size());
+  auto* relocated_gm =
+      dynamic_cast<GrowthModule*>(cell->GetAllBiologyModules()[0]);
+  ASSERT_TRUE(relocated_gm != nullptr);
+  EXPECT_EQ(321, relocated_gm->growth_rate_);
+  auto* mm = cell->GetAllBiologyModules()[1];
+
+  // biology modules are moved, not copied
+  auto* relocated = cell->Relocate();
+  EXPECT_TRUE(cell != relocated);
+  EXPECT_EQ(0u, cell->GetAllBiologyModules().size());
+  delete cell;
+  EXPECT_EQ(uid, relocated->GetUid());
+  EXPECT_EQ(123u, relocated->GetBoxIdx());
+  ASSERT_EQ(2u, relocated->GetAllBiologyModules().size());
+  EXPECT_EQ(relocated_gm, relocated->GetAllBiologyModules()[0]);
+  EXPECT_EQ(mm, relocated->GetAllBiologyModules()[1]);
+  delete relocated;
+}
+
 TEST(SimObjectTest, BiologyModule) {
   Simulation simulation(TEST_NAME);
 
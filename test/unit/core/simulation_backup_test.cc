@@ -101,6 +101,35 @@ TEST(SimulationBackupTest, Backup) {
   remove(ROOTFILE);
 }
 
+TEST(SimulationBackupTest, BackupAsync) {
+  remove(ROOTFILE);
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+
+  rm->push_back(new Cell());
+
+  SimulationBackup backup(ROOTFILE, "");
+  backup.BackupAsync(26);
+  // the backup contains the state at the time of the call
+  rm->push_back(new Cell());
+  backup.WaitForAsyncBackup();
+
+  ASSERT_TRUE(FileExists(ROOTFILE));
+  TFileRaii file(TFile::Open(ROOTFILE));
+  IntegralTypeWrapper<size_t>* wrapper = nullptr;
+  file.Get()->GetObject(SimulationBackup::kSimulationStepName.c_str(), wrapper);
+  EXPECT_EQ(26u, wrapper->Get());
+  Simulation* restored_simulation = nullptr;
+  file.Get()->GetObject(SimulationBackup::kSimulationName.c_str(),
+                        restored_simulation);
+  EXPECT_EQ(1u, restored_simulation->GetResourceManager()->GetNumSimObjects());
+
+  // waiting without a running backup returns immediately
+  backup.WaitForAsyncBackup();
+
+  remove(ROOTFILE);
+}
+
 TEST(SimulationBackupDeathTest, RestoreNoRestoreFileSpecified) {
   ASSERT_DEATH(
       {
@@ -33,6 +33,9 @@ class SimulationTest : public ::testing::Test {
       "backup_file = \"backup.root\"\n"
       "restore_file = \"restore.root\"\n"
       "backup_interval = 3600\n"
+      "backup_interval_steps = 20\n"
+      "async_backup = true\n"
+      "native_backup = true\n"
       "time_step = 0.0125\n"
       "max_displacement = 2.0\n"
       "run_mechanical_interactions = false\n"
@@ -64,8 +67,19 @@ class SimulationTest : public ::testing::Test {
       "\n"
       "[performance]\n"
       "scheduling_batch_size = 123\n"
+      "adaptive_scheduling_batch_size = true\n"
       "detect_static_sim_objects = true\n"
       "cache_neighbors = true\n"
+      "incremental_grid_update = true\n"
+      "compact_grid_layout = true\n"
+      "grid_box_length_factor = 0.5\n"
+      "half_shell_displacement = true\n"
+      "verlet_lists = true\n"
+      "verlet_skin = 7.5\n"
+      "spatial_index = \"kd_tree\"\n"
+      "box_coloring = true\n"
+      "numa_rebalancing_frequency = 20\n"
+      "numa_rebalancing_threshold = 0.25\n"
       "\n"
       "[development]\n"
       "# this is a comment\n"
@@ -98,6 +112,9 @@ class SimulationTest : public ::testing::Test {
   void ValidateNonCLIParameter(const Param* param) {
     EXPECT_EQ("result-dir", param->output_dir_);
     EXPECT_EQ(3600u, param->backup_interval_);
+    EXPECT_EQ(20u, param->backup_interval_steps_);
+    EXPECT_TRUE(param->async_backup_);
+    EXPECT_TRUE(param->native_backup_);
     EXPECT_EQ(0.0125, param->simulation_time_step_);
     EXPECT_EQ(2.0, param->simulation_max_displacement_);
     EXPECT_FALSE(param->run_mechanical_interactions_);
@@ -145,8 +162,20 @@ class SimulationTest : public ::testing::Test {
 
     // performance group
     EXPECT_EQ(123u, param->scheduling_batch_size_);
+    EXPECT_TRUE(param->adaptive_scheduling_batch_size_);
     EXPECT_TRUE(param->detect_static_sim_objects_);
     EXPECT_TRUE(param->cache_neighbors_);
+    EXPECT_TRUE(param->incremental_grid_update_);
+    EXPECT_TRUE(param->compact_grid_layout_);
+    EXPECT_NEAR(0.5, param->grid_box_length_factor_, abs_error<double>::value);
+    EXPECT_TRUE(param->half_shell_displacement_);
+    EXPECT_TRUE(param->verlet_lists_);
+    EXPECT_NEAR(7.5, param->verlet_skin_, abs_error<double>::value);
+    EXPECT_EQ("kd_tree", param->spatial_index_);
+    EXPECT_TRUE(param->box_coloring_);
+    EXPECT_EQ(20u, param->numa_rebalancing_frequency_);
+    EXPECT_NEAR(0.25, param->numa_rebalancing_threshold_,
+                abs_error<double>::value);
 
     // development group
     EXPECT_TRUE(param->statistics_);
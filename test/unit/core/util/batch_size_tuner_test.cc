@@ -0,0 +1,75 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/util/batch_size_tuner.h"
+#include <gtest/gtest.h>
+
+namespace bdm {
+
+ParallelLoopStatistics CreateStatistics(uint64_t num_so, uint64_t chunk,
+                                        std::vector<uint64_t> busy_time) {
+  ParallelLoopStatistics statistics;
+  statistics.num_sim_objects_ = num_so;
+  statistics.chunk_ = chunk;
+  statistics.num_chunks_ = num_so / chunk;
+  statistics.busy_time_ = busy_time;
+  return statistics;
+}
+
+TEST(ParallelLoopStatisticsTest, LoadImbalance) {
+  auto statistics = CreateStatistics(300, 10, {100, 100, 100});
+  EXPECT_NEAR(0, statistics.GetLoadImbalance(), 1e-9);
+  EXPECT_NEAR(10, statistics.GetMeanChunkTime(), 1e-9);
+
+  statistics = CreateStatistics(300, 10, {400, 100, 100, 200});
+  EXPECT_NEAR(50, statistics.GetLoadImbalance(), 1e-9);
+}
+
+TEST(BatchSizeTunerTest, CheapSimObjects) {
+  // 3 ns per simulation object
+  BatchSizeTuner tuner(1000);
+  for (int i = 0; i < 50; i++) {
+    auto chunk = tuner.GetBatchSize();
+    tuner.Update(CreateStatistics(1000000, chunk, {1000000, 1000000, 1000000}));
+    EXPECT_GE(std::max<uint64_t>(1.5 * chunk, 1), tuner.GetBatchSize());
+  }
+  // kTargetChunkTime / 3 ns
+  EXPECT_NEAR(16667, tuner.GetBatchSize(), 100);
+}
+
+TEST(BatchSizeTunerTest, ExpensiveSimObjects) {
+  // each thread must get at least `kMinChunksPerThread` chunks
+  BatchSizeTuner tuner(1000);
+  for (int i = 0; i < 50; i++) {
+    tuner.Update(
+        CreateStatistics(6400, tuner.GetBatchSize(), {1000, 1000, 1000}));
+  }
+  EXPECT_NEAR(6400 / (3 * BatchSizeTuner::kMinChunksPerThread),
+              tuner.GetBatchSize(), 1);
+}
+
+TEST(BatchSizeTunerTest, LoadImbalance) {
+  BatchSizeTuner tuner(1000);
+  tuner.Update(CreateStatistics(1000000, 1000, {300000, 100000, 100000}));
+  EXPECT_EQ(750u, tuner.GetBatchSize());
+
+  // the batch size never drops below one
+  for (int i = 0; i < 50; i++) {
+    tuner.Update(CreateStatistics(1000000, tuner.GetBatchSize(),
+                                  {300000, 100000, 100000}));
+  }
+  EXPECT_EQ(1u, tuner.GetBatchSize());
+}
+
+}  // namespace bdm